@@ -18,11 +18,14 @@ int		sum_cmd(), product_cmd(), for_cmd(), integrate_cmd(), nintegrate_cmd(), lap
 /* various functions that don't return int */
 char		*dirname_win();
 char		*skip_space(), *skip_comma_space(), *skip_param();
-char		*get_string();
+char		*get_string(), *counters_json(), *command_stats_json(), *pass_profile_json();
 char		*parse_equation(), *parse_section(), *parse_var(), *parse_var2(), *parse_expr();
-char		*list_expression(), *list_equation(), *flist_equation_string();
-double		gcd(), gcd_verified(), my_round(), multiply_out_unique();
+char		*list_expression(), *list_equation(), *list_equation_reuse(), *flist_equation_string();
+char		*func_name();
+token_type	*func_expansion(), *func_derivative(), *func_inverse(), *parse_template();
+double		gcd(), gcd_verified(), my_round(), multiply_out_unique(), get_time(), fast_strtod();
 long		decstrtol(), max_memory_usage();
+void		*mem_alloc(), *mem_calloc(), *mem_realloc();
 
 void fphandler(int sig);
 void inthandler(int sig);
@@ -26,7 +26,11 @@ George Gesslein II, P.O. Box 224, Lansing, NY  14882-0224  USA.
 #if	UNIX || CYGWIN
 #include <sys/ioctl.h>
 #include <termios.h>
+#include <sys/time.h>
 #endif
+#include <time.h>
+
+static int return_result_sub(int en);
 
 /*
  * Display the main Mathomatic startup message.
@@ -122,6 +126,9 @@ const char	*str;		/* constant string to display */
 void
 error_huge(void)
 {
+	counters.error_huge_aborts++;
+	command_peak_tokens = n_tokens;
+	sample_peak_tokens();
 	longjmp(jmp_save, 14);
 }
 
@@ -173,6 +180,33 @@ check_err(void)
 	}
 }
 
+/*
+ * Called periodically by long running loops, to report progress to
+ * the symbolic math library caller's progress callback, if any,
+ * and to check if the current operation should be aborted.
+ * "where" names the loop and "count" is how far along it is.
+ *
+ * Return true if the current operation should be aborted,
+ * because of Control-C, the library caller's cancel flag,
+ * or the progress callback returning non-zero.
+ * abort_flag is cleared when returning true.
+ */
+int
+aborted(where, count)
+const char	*where;	/* constant string naming the loop */
+long		count;	/* loop iteration count or other measure of progress */
+{
+	if (progress_callback && (*progress_callback)(where, count, progress_data)) {
+		abort_flag = false;
+		return true;
+	}
+	if (abort_requested()) {
+		abort_flag = false;
+		return true;
+	}
+	return false;
+}
+
 /*
  * Get the current screen (window) width and height from the operating system.
  *
@@ -207,37 +241,303 @@ get_screen_size(void)
 }
 
 /*
- * Allocate the display lines in the vscreen[] array.
- * Call this before using vscreen[].
- *
- * Return true with vscreen[] allocated to TEXT_ROWS*current_columns characters if successful.
+ * Return the current wall clock time in seconds,
+ * with microsecond resolution if the operating system allows.
+ * Only used for measuring elapsed times.
  */
-int
-malloc_vscreen(void)
+double
+get_time(void)
 {
-	int	i;
+#if	UNIX || CYGWIN
+	struct timeval	tv;
+
+	if (gettimeofday(&tv, NULL) == 0) {
+		return((double) tv.tv_sec + ((double) tv.tv_usec / 1000000.0));
+	}
+#elif	defined(CLOCK_REALTIME)	/* POSIX, like when compiled as the library */
+	struct timespec	ts;
+
+	if (clock_gettime(CLOCK_REALTIME, &ts) == 0) {
+		return((double) ts.tv_sec + ((double) ts.tv_nsec / 1000000000.0));
+	}
+#endif
+	return((double) time(NULL));
+}
+
+#define	TRACE_MAX_DEPTH	100		/* maximum nesting of traced phases */
+
+static const char	*trace_stack[TRACE_MAX_DEPTH];	/* names of the traced phases now begun and not ended */
+static int		trace_depth;		/* number of phases in trace_stack[] */
+static int		trace_overflow;		/* number of begun phases not traced because trace_stack[] was full */
+static double		trace_start_time;	/* get_time() when the trace file was opened */
+static const char	*trace_sep = "";	/* separator to output before the next trace event */
 
-	if (current_columns == 0 || ((screen_columns > 0) ? (current_columns != screen_columns) : (current_columns != TEXT_COLUMNS))) {
-		if (screen_columns > 0) {
-			current_columns = screen_columns;
+/*
+ * Output a JSON string, quoted and escaped, to "fp".
+ */
+static void
+json_string(fp, cp)
+FILE		*fp;
+const char	*cp;
+{
+	putc('"', fp);
+	for (; *cp; cp++) {
+		if (*cp == '"' || *cp == '\\') {
+			fprintf(fp, "\\%c", *cp);
+		} else if ((unsigned char) *cp < ' ') {
+			fprintf(fp, "\\u%04x", (unsigned char) *cp);
 		} else {
-			current_columns = TEXT_COLUMNS;
+			putc(*cp, fp);
 		}
-		for (i = 0; i < TEXT_ROWS; i++) {
-			if (vscreen[i]) {
-				free(vscreen[i]);
-			}
-			vscreen[i] = malloc(current_columns + 1);
-			if (vscreen[i] == NULL) {
-				error(_("Out of memory (can't malloc(3))."));
-				current_columns = 0;
-				return false;
-			}
+	}
+	putc('"', fp);
+}
+
+/*
+ * Write one Chrome trace-event to the trace file.
+ */
+static void
+trace_write(ph, name, detail, tokens)
+int		ph;
+const char	*name;
+const char	*detail;
+int		tokens;
+{
+	fprintf(trace_fp, "%s{\"name\": \"%s\", \"cat\": \"mathomatic\", \"ph\": \"%c\", \"ts\": %.3f, \"pid\": %d, \"tid\": 1",
+	    trace_sep, name, ph, (get_time() - trace_start_time) * 1000000.0, (int) getpid());
+	if (detail || tokens >= 0) {
+		fprintf(trace_fp, ", \"args\": {");
+		if (detail) {
+			fprintf(trace_fp, "\"input\": ");
+			json_string(trace_fp, detail);
+		}
+		if (tokens >= 0) {
+			fprintf(trace_fp, "%s\"tokens\": %d", (detail ? ", " : ""), tokens);
+		}
+		putc('}', trace_fp);
+	}
+	putc('}', trace_fp);
+	trace_sep = ",\n";
+}
+
+/*
+ * Record the beginning ('B') or end ('E') of a phase in the trace file, if "set trace" is on.
+ * Usually called through the trace_begin() and trace_end() macros.
+ * Ending a phase also ends any phases begun inside it that were left
+ * by a longjmp(3) out of them.
+ */
+void
+trace_event(ph, name, detail, tokens)
+int		ph;		/* 'B' to begin or 'E' to end the phase */
+const char	*name;		/* phase name */
+const char	*detail;	/* text for the "input" argument, or NULL for none */
+int		tokens;		/* expression size for the "tokens" argument, or -1 for none */
+{
+	int	i;
+
+	if (trace_fp == NULL)
+		return;
+	if (ph == 'B') {
+		if (trace_depth >= TRACE_MAX_DEPTH) {
+			trace_overflow++;
+			return;
+		}
+		trace_stack[trace_depth++] = name;
+	} else {
+		if (trace_overflow > 0) {
+			trace_overflow--;
+			return;
+		}
+		for (i = trace_depth - 1; i >= 0; i--) {
+			if (strcmp(trace_stack[i], name) == 0)
+				break;
+		}
+		if (i < 0)
+			return;		/* already ended by trace_unwind() */
+		while (--trace_depth > i) {
+			trace_write('E', trace_stack[trace_depth], NULL, -1);
 		}
 	}
+	trace_write(ph, name, detail, tokens);
+}
+
+/*
+ * End all traced phases, after an error aborted the current command.
+ */
+void
+trace_unwind(void)
+{
+	if (trace_fp == NULL)
+		return;
+	trace_overflow = 0;
+	while (trace_depth > 0) {
+		trace_depth--;
+		trace_write('E', trace_stack[trace_depth], NULL, -1);
+	}
+	fflush(trace_fp);
+}
+
+#if	!SECURE
+/*
+ * Start writing Chrome trace-event JSON to the file "filename",
+ * ending any trace file already open.
+ *
+ * Return true if successful.
+ */
+int
+trace_open(filename)
+char	*filename;
+{
+	trace_close();
+	if ((trace_fp = fopen(filename, "w")) == NULL) {
+		perror(filename);
+		return false;
+	}
+	fprintf(trace_fp, "[\n");
+	trace_sep = "";
+	trace_depth = 0;
+	trace_overflow = 0;
+	trace_start_time = get_time();
+	return true;
+}
+#endif
+
+/*
+ * End all traced phases and close the trace file, if open.
+ */
+void
+trace_close(void)
+{
+	if (trace_fp == NULL)
+		return;
+	trace_unwind();
+	fprintf(trace_fp, "\n]\n");
+	fclose(trace_fp);
+	trace_fp = NULL;
+}
+
+/*
+ * Count "size" bytes more in memory "category", updating the peaks.
+ */
+static void
+mem_count(size, category)
+long	size;
+int	category;
+{
+	mem_stats.live[category] += size;
+	if (mem_stats.live[category] > mem_stats.peak[category])
+		mem_stats.peak[category] = mem_stats.live[category];
+	mem_stats.total_live += size;
+	if (mem_stats.total_live > mem_stats.total_peak)
+		mem_stats.total_peak = mem_stats.total_live;
+	if (mem_stats.total_live > mem_stats.command_peak)
+		mem_stats.command_peak = mem_stats.total_live;
+}
+
+/*
+ * Return true if "size" more bytes fit in the memory quota,
+ * otherwise display an error and return false.
+ */
+static int
+mem_quota_ok(size)
+long	size;
+{
+	if (mem_stats.quota > 0 && size > 0 && mem_stats.total_live + size > mem_stats.quota) {
+		mem_stats.quota_failures++;
+		error(_("Memory quota exceeded."));
+		return false;
+	}
 	return true;
 }
 
+/*
+ * malloc(3) that counts the bytes allocated in memory "category"
+ * and enforces the memory quota.
+ * Free the result with mem_free(), giving the same size and category.
+ *
+ * Return NULL if out of memory or the quota would be exceeded.
+ */
+void *
+mem_alloc(size, category)
+size_t	size;
+int	category;
+{
+	void	*p;
+
+	if (!mem_quota_ok((long) size))
+		return NULL;
+	if ((p = malloc(size)) != NULL)
+		mem_count((long) size, category);
+	return p;
+}
+
+/*
+ * calloc(3) that counts the bytes allocated, like mem_alloc().
+ */
+void *
+mem_calloc(nmemb, size, category)
+size_t	nmemb, size;
+int	category;
+{
+	void	*p;
+
+	if (!mem_quota_ok((long) (nmemb * size)))
+		return NULL;
+	if ((p = calloc(nmemb, size)) != NULL)
+		mem_count((long) (nmemb * size), category);
+	return p;
+}
+
+/*
+ * realloc(3) for memory from mem_alloc(), changing its size from "old_size" to "new_size".
+ *
+ * Return NULL, leaving the old memory allocated, if out of memory or the quota would be exceeded.
+ */
+void *
+mem_realloc(p, old_size, new_size, category)
+void	*p;
+size_t	old_size, new_size;
+int	category;
+{
+	void	*p1;
+
+	if (p == NULL)
+		old_size = 0;
+	if (!mem_quota_ok((long) new_size - (long) old_size))
+		return NULL;
+	if ((p1 = realloc(p, new_size)) != NULL)
+		mem_count((long) new_size - (long) old_size, category);
+	return p1;
+}
+
+/*
+ * free(3) for memory from mem_alloc(), which was "size" bytes in memory "category".
+ */
+void
+mem_free(p, size, category)
+void	*p;
+size_t	size;
+int	category;
+{
+	if (p == NULL)
+		return;
+	free(p);
+	mem_disown(size, category);
+}
+
+/*
+ * Stop counting memory from mem_alloc() that is being handed to code that will free(3) it,
+ * like a result string returned to the library caller.
+ */
+void
+mem_disown(size, category)
+size_t	size;
+int	category;
+{
+	mem_stats.live[category] -= (long) size;
+	mem_stats.total_live -= (long) size;
+}
+
 /*
  * Allocate the needed global expression storage arrays.
  * Each is static and can hold n_tokens elements.
@@ -254,10 +554,10 @@ init_mem(void)
 {
 	if (n_tokens <= 0)
 		return false;
-	if ((scratch = (token_type *) malloc(((n_tokens * 3) / 2) * sizeof(token_type))) == NULL
-	    || (tes = (token_type *) malloc(n_tokens * sizeof(token_type))) == NULL
-	    || (tlhs = (token_type *) malloc(n_tokens * sizeof(token_type))) == NULL
-	    || (trhs = (token_type *) malloc(n_tokens * sizeof(token_type))) == NULL) {
+	if ((scratch = (token_type *) mem_alloc(((n_tokens * 3) / 2) * sizeof(token_type), MEM_TEMP)) == NULL
+	    || (tes = (token_type *) mem_alloc(n_tokens * sizeof(token_type), MEM_TEMP)) == NULL
+	    || (tlhs = (token_type *) mem_alloc(n_tokens * sizeof(token_type), MEM_TEMP)) == NULL
+	    || (trhs = (token_type *) mem_alloc(n_tokens * sizeof(token_type), MEM_TEMP)) == NULL) {
 		return false;
 	}
 	if (alloc_next_espace() < 0) {	/* make sure there is at least 1 equation space */
@@ -282,32 +582,26 @@ free_mem(void)
 {
 	int	i;
 
+	trace_close();
+	pass_profile_off();
 	clear_all();
 
-	free(scratch);
-	free(tes);
-	free(tlhs);
-	free(trhs);
+	mem_free(scratch, ((n_tokens * 3) / 2) * sizeof(token_type), MEM_TEMP);
+	mem_free(tes, n_tokens * sizeof(token_type), MEM_TEMP);
+	mem_free(tlhs, n_tokens * sizeof(token_type), MEM_TEMP);
+	mem_free(trhs, n_tokens * sizeof(token_type), MEM_TEMP);
 
 	for (i = 0; i < N_EQUATIONS; i++) {
 		if (lhs[i]) {
-			free(lhs[i]);
+			mem_free(lhs[i], n_tokens * sizeof(token_type), MEM_EQUATIONS);
 			lhs[i] = NULL;
 		}
 		if (rhs[i]) {
-			free(rhs[i]);
+			mem_free(rhs[i], n_tokens * sizeof(token_type), MEM_EQUATIONS);
 			rhs[i] = NULL;
 		}
 	}
 	n_equations = 0;
-
-	for (i = 0; i < TEXT_ROWS; i++) {
-		if (vscreen[i]) {
-			free(vscreen[i]);
-			vscreen[i] = NULL;
-		}
-	}
-	current_columns = 0;
 }
 #endif
 
@@ -377,6 +671,7 @@ clean_up(void)
 	int	i;
 
 	init_gvars();		/* reset the global variables to the default */
+	pass_unwind();
 	if (gfp != default_out) {	/* reset the output file to default */
 #if	!SECURE
 		if (gfp != stdout && gfp != stderr)
@@ -460,9 +755,11 @@ clear_all(void)
 	CLEAR_ARRAY(n_rhs);
 /* forget all variables names */
 	for (i = 0; var_names[i]; i++) {
-		free(var_names[i]);
+		mem_free(var_names[i], strlen(var_names[i]) + 1, MEM_VARIABLES);
 		var_names[i] = NULL;
 	}
+/* forget all user-defined functions */
+	clear_functions();
 /* reset everything to a known state */
 	CLEAR_ARRAY(sign_array);
 	init_gvars();
@@ -484,12 +781,12 @@ int	i;	/* equation space number */
 		return true;	/* already allocated */
 	if (lhs[i] || rhs[i])
 		return false;	/* something is wrong */
-	lhs[i] = (token_type *) malloc(n_tokens * sizeof(token_type));
+	lhs[i] = (token_type *) mem_alloc(n_tokens * sizeof(token_type), MEM_EQUATIONS);
 	if (lhs[i] == NULL)
 		return false;
-	rhs[i] = (token_type *) malloc(n_tokens * sizeof(token_type));
+	rhs[i] = (token_type *) mem_alloc(n_tokens * sizeof(token_type), MEM_EQUATIONS);
 	if (rhs[i] == NULL) {
-		free(lhs[i]);
+		mem_free(lhs[i], n_tokens * sizeof(token_type), MEM_EQUATIONS);
 		lhs[i] = NULL;
 		return false;
 	}
@@ -1067,20 +1364,38 @@ int
 return_result(en)
 int	en;	/* equation space number the result is in */
 {
+	int	rv;
+
 	if (empty_equation_space(en)) {
 		return false;
 	}
+	trace_begin("output", n_lhs[en] + n_rhs[en]);
+	rv = return_result_sub(en);
+	trace_end("output", -1);
+	return rv;
+}
+
+static int
+return_result_sub(en)
+int	en;
+{
 #if	LIBRARY
 	make_fractions_and_group(en);
 	if (factor_int_flag) {
 		factor_int_equation(en);
 	}
 	free_result_str();
+	if (!result_wanted && gfp == stdout) {
+		result_en = en;
+		return true;
+	}
 #if	1	/* Set this to 1 to allow display2d to decide library output mode. */
 	if (display2d) {
 		result_str = flist_equation_string(en);
 		if (result_str == NULL)
 			result_str = list_equation(en, false);
+	} else if (result_reuse) {
+		result_str = list_equation_reuse(en, false);
 	} else {
 		result_str = list_equation(en, false);
 	}
@@ -1098,12 +1413,14 @@ int	en;	/* equation space number the result is in */
 /*
  * Free any malloc()ed result_str, so there won't be a memory leak
  * in the symbolic math library.
+ * A reused result_str from list_equation_reuse() is just forgotten.
  */
 void
 free_result_str(void)
 {
 	if (result_str) {
-		free(result_str);
+		if (!reused_string(result_str))
+			free(result_str);
 		result_str = NULL;
 	}
 	result_en = -1;
@@ -101,8 +101,24 @@ typedef union {
 #define IDIVIDE		7	/* a // b */
 #define	POWER		8	/* a ^ b */
 #define	FACTORIAL	9	/* a! */
+#define	FUNCTION	10	/* f(a, ...), the low bits of every function call operator */
 } storage_type;
 
+/*
+ * A call of a named function, like "sin(x)" or "f(a, b)", is stored as a group of tokens
+ * on one level of parentheses: the dummy constant 1, then each argument preceded by
+ * the function call operator of the function, like "1 F a F b".
+ * An argument that is a single operand is on the level of the call,
+ * otherwise it is parenthesized.  The function call operators are the only operators on that level,
+ * so a call is a single operand to everything around it.
+ * See "function.c".
+ */
+#define	FUNC_SHIFT	8					/* bits below the function number in a function call operator */
+#define	FUNC_OP(fn)	(FUNCTION + ((fn) << FUNC_SHIFT))		/* function call operator of function number "fn" */
+#define	IS_FUNC_OP(op)	(((op) & ((1 << FUNC_SHIFT) - 1)) == FUNCTION)	/* true if "op" is a function call operator */
+#define	FUNC_NUMBER(op)	((op) >> FUNC_SHIFT)				/* function number of function call operator "op" */
+#define	FIRST_USER_FUNC	64	/* function number of the first user-defined function, the built-in functions are below this */
+
 typedef	struct {		/* storage structure for each token in an expression */
 	enum kind_list	kind;	/* kind of token */
 	int		level;	/* level of parentheses, origin 1 */
@@ -154,6 +170,13 @@ typedef	struct {		/* storage structure for each token in an expression */
 #define	SUBSCRIPT_MASK	63			/* mask for variable subscript after shifting VAR_SHIFT */
 #define	MAX_SUBSCRIPT	(SUBSCRIPT_MASK - 1)	/* maximum variable subscript, currently only used for "sign" variables */
 
+#define	MAX_FUNC_ARGS	9	/* maximum number of arguments of a function call */
+/*
+ * Parameters of function bodies and templates are parsed as the special variable MATCH_ANY with subscript 1 to MAX_FUNC_ARGS,
+ * which can't be entered, so they are easily found and replaced with the arguments of each call.
+ */
+#define	PARAM_VAR(k)	(MATCH_ANY + (((long) (k) + 1) << VAR_SHIFT))	/* parameter "k" (origin 0) in a parsed function body */
+
 typedef	char	sign_array_type[MAX_SUBSCRIPT+2];	/* boolean array for generating unique "sign" variables */
 
 typedef struct {		/* qsort(3) data structure for sorting Mathomatic variables */
@@ -161,6 +184,109 @@ typedef struct {		/* qsort(3) data structure for sorting Mathomatic variables */
 	int	count;		/* number of times the variable occurs */
 } sort_type;
 
+typedef struct {		/* one instruction of a numerical expression compiled by compile_numeric() in "eval.c" */
+	int	operatr;	/* operator to apply to the top two stack values, or 0 to push an operand */
+	int	slot;		/* for operands, index of the variable value to push, or -1 to push "constant"; */
+				/* for function calls, the number of arguments on the top of the stack */
+	double	constant;	/* constant operand */
+} code_type;
+
+/* Indexes of the expression transformation rules counted in counters.rule_calls[] and rule_hits[]: */
+enum rule_list {
+	R_FPLUS,	/* fplus_sub() in "factor.c" */
+	R_FTIMES,	/* ftimes_sub() in "factor.c" */
+	R_FPOWER,	/* fpower_sub() in "factor.c" */
+	R_SF,		/* sf_sub() in "super.c" */
+	R_UNF,		/* unf_sub() in "unfactor.c" */
+	R_USP,		/* usp_sub() in "unfactor.c" */
+	R_PF,		/* pf_sub() in "poly.c" */
+	R_FUNC,		/* func_sub() in "function.c" */
+	N_RULES		/* number of rules counted */
+};
+
+typedef struct {		/* hot-path instrumentation counters, always compiled in; see "version counters" */
+	long	se_compare_calls;	/* number of se_compare() calls */
+	long	se_compare_early_outs;	/* number of se_compare() calls that returned early because the sizes differ too much */
+	double	blt_bytes;		/* total bytes moved by blt() */
+	long	simp_loop_iterations;	/* number of elim_loop() passes made by simp_loop() */
+	long	rule_calls[N_RULES];	/* number of times each transformation rule was tried */
+	long	rule_hits[N_RULES];	/* number of times each transformation rule modified the expression */
+	long	error_huge_aborts;	/* number of times error_huge() aborted an operation */
+	int	peak_tokens[N_EQUATIONS];	/* peak number of tokens in each equation space, including growth during commands */
+} counters_type;
+
+/* Categories of memory counted by mem_alloc() and friends in "am.c": */
+enum mem_list {
+	MEM_TEMP,	/* scratch[], tes[], tlhs[], and trhs[] expression arrays, and compiled numerical code */
+	MEM_EQUATIONS,	/* equation spaces lhs[] and rhs[] */
+	MEM_VARIABLES,	/* variable names */
+	MEM_FUNCTIONS,	/* user-defined function bodies, built-in function templates, memos, and argument expression arrays */
+	MEM_STRINGS,	/* output strings while being built, and the reused library result buffer */
+	MEM_DISPLAY,	/* 2D expression display line arrays, size caches, and fraction tables */
+	MEM_INPUT,	/* script file line buffers and snapshot file data being read */
+	N_MEM		/* number of memory categories */
+};
+
+typedef struct {		/* real memory accounting, see mem_alloc() */
+	long	live[N_MEM];	/* bytes allocated now in each category */
+	long	peak[N_MEM];	/* most bytes allocated at once in each category */
+	long	total_live;	/* bytes allocated now in all categories */
+	long	total_peak;	/* most bytes allocated at once in all categories */
+	long	command_peak;	/* most bytes allocated at once in all categories during the innermost measured command */
+	long	quota;		/* maximum total bytes allowed, set by "set memory_quota", 0 for no limit */
+	long	quota_failures;	/* number of allocations refused because of the quota */
+} mem_stats_type;
+
+/* Passes of the full simplify in simpa_side(), profiled by "set pass_profile" and skipped by "set pass_schedule": */
+enum pass_list {
+	P_SIMP_LOOP,		/* simp_loop() */
+	P_SIMP_SSUB,		/* simp_ssub() */
+	P_SIMPB_SIDE,		/* simpb_side() */
+	P_ELIM_LOOP,		/* elim_loop() */
+	P_UF_POWER,		/* uf_power() */
+	P_UF_TSIMP,		/* uf_tsimp() */
+	P_UF_PPLUS,		/* uf_pplus() */
+	P_UF_REPEAT,		/* uf_repeat() */
+	P_UF_TIMES,		/* uf_times() */
+	P_UF_NEG_HELP,		/* uf_neg_help() */
+	P_UNSIMP_POWER,		/* unsimp_power() */
+	P_FACTOR_POWER,		/* factor_power() */
+	P_RATIONALIZE,		/* rationalize() */
+	P_MOD_SIMP,		/* mod_simp() */
+	P_SIMP_I,		/* simp_i() */
+	P_SUPER_FACTOR,		/* super_factor() */
+	P_POLY_GCD_SIMP,	/* poly_gcd_simp() */
+	P_FACTORV,		/* factorv() */
+	P_FACTOR_IMAGINARY,	/* factor_imaginary() */
+	P_POLY_FACTOR,		/* poly_factor() */
+	P_DIV_REMAINDER,	/* div_remainder() */
+	P_SIMP_CONSTANT_POWER,	/* simp_constant_power() */
+	P_MAKE_SIMPLE_FRACTIONS,	/* make_simple_fractions() */
+	P_INTEGER_ROOT_SIMP,	/* integer_root_simp() */
+	N_PASSES		/* number of passes */
+};
+
+typedef struct {		/* profile of one simpa_side() pass, see "version passes" */
+	long	calls;		/* number of times the pass was run */
+	long	changes;	/* number of runs that changed the expression */
+	double	seconds;	/* total time taken by the pass */
+} pass_stats_type;
+
+/*
+ * Run the simpa_side() pass "call" on expression "equation" with length "*np", returning its int result,
+ * unless "set pass_schedule" skips pass "p", in which case it returns false.
+ * With "set pass_profile", also records whether it changed the expression and the time it took.
+ */
+#define	run_pass(p, equation, np, call)	(pass_skip[(p)] ? false : (pass_profile_flag \
+	? (pass_begin((equation), *(np)), pass_end((p), (equation), (np), (call))) : (call)))
+
+/* Record the beginning and end of a phase of work in the "set trace" file, with the expression size: */
+#define	trace_begin(name, tokens)	{ if (trace_fp) trace_event('B', (name), NULL, (tokens)); }
+#define	trace_end(name, tokens)		{ if (trace_fp) trace_event('E', (name), NULL, (tokens)); }
+
+/* Count a try of transformation rule r, and a hit if the rule's boolean result is true. */
+#define	count_rule(r, result)	(counters.rule_calls[(r)]++, ((result) ? (counters.rule_hits[(r)]++, true) : false))
+
 /* A list of supported output languages for the code command: */
 enum language_list {
 	C = 1,      /* or C++ */
@@ -185,6 +311,9 @@ enum language_list {
 #define empty_equation_space(en)	((en) < 0 || (en) >= n_equations || n_lhs[(en)] <= 0)
 #define	equation_space_is_equation(en)	((en) >= 0 && (en) < n_equations && n_lhs[(en)] > 0 && n_rhs[(en)] > 0)
 
+/* True if the current operation should be aborted, by Control-C or the library caller's cancel flag. */
+#define	abort_requested()	(abort_flag || (cancel_flagp && *cancel_flagp))
+
 /*
  * The following are macros for displaying help text.
  * When used properly, they will allow nicer looking wrap-around on all help text.
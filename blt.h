@@ -23,7 +23,7 @@ George Gesslein II, P.O. Box 224, Lansing, NY  14882-0224  USA.
  */
 
 #if	1
-#define	blt(dest, src, cnt)	memmove((dest), (src), (cnt))	/* memory copy function; must allow overlapping of src and dest */
+#define	blt(dest, src, cnt)	(counters.blt_bytes += (cnt), memmove((dest), (src), (cnt)))	/* memory copy function; must allow overlapping of src and dest */
 #else
 /* If no fast or working memmove(3) routine exists use this one. */
 static inline char *
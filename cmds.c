@@ -23,6 +23,11 @@ George Gesslein II, P.O. Box 224, Lansing, NY  14882-0224  USA.
  */
 
 #include "includes.h"
+#if	UNIX && !SECURE
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
 
 #define	OPT_MIN_SIZE	7	/* Minimum size (in tokens) of repeated expressions to find in optimize command. */
 
@@ -33,6 +38,7 @@ enum spf_function {
 };
 
 static int sum_product(char *cp, enum spf_function current_function);
+static void numeric_sum_product(token_type *source, int ns, long v, double *startp, double end, double step, int count_down, int product_flag, double *accp);
 static int complex_func(char *cp, int imag_flag);
 static int elim_sub(int i, long v);
 
@@ -210,13 +216,79 @@ char	*cp;	/* the command-line argument */
 {
 	int	rv = true;		/* return value */
 	int	status_flag = false;
+	int	counters_flag = false, stats_flag = false, passes_flag = false, reset_flag = false;
 
-	if (strncasecmp(cp, "status", 4) == 0) {
+	if (strncasecmp(cp, "statistics", 5) != 0 && strncasecmp(cp, "status", 4) == 0) {
 		status_flag = true;
 		cp = skip_param(cp);
+	} else if (strncasecmp(cp, "counters", 4) == 0 || strncasecmp(cp, "statistics", 5) == 0
+	    || strncasecmp(cp, "passes", 4) == 0) {
+		if (strncasecmp(cp, "counters", 4) == 0)
+			counters_flag = true;
+		else if (strncasecmp(cp, "passes", 4) == 0)
+			passes_flag = true;
+		else
+			stats_flag = true;
+		cp = skip_param(cp);
+		if (strcmp_tospace(cp, "reset") == 0) {
+			reset_flag = true;
+			cp = skip_param(cp);
+		}
 	}
 	if (extra_characters(cp))	/* Make sure nothing else is on the command-line. */
 		return false;
+	if (stats_flag) {
+#if	LIBRARY
+		free_result_str();
+		result_str = strdup(command_stats_json());
+#endif
+#if	!SILENT || !LIBRARY
+		command_stats_report(gfp);
+#endif
+		if (reset_flag) {
+			reset_command_stats();
+		}
+#if	LIBRARY
+		return(result_str != NULL);
+#else
+		return true;
+#endif
+	}
+	if (passes_flag) {
+#if	LIBRARY
+		free_result_str();
+		result_str = strdup(pass_profile_json());
+#endif
+#if	!SILENT || !LIBRARY
+		pass_profile_report(gfp);
+#endif
+		if (reset_flag) {
+			reset_pass_profile();
+		}
+#if	LIBRARY
+		return(result_str != NULL);
+#else
+		return true;
+#endif
+	}
+	if (counters_flag) {
+		sample_peak_tokens();
+#if	LIBRARY
+		free_result_str();
+		result_str = strdup(counters_json());
+#endif
+#if	!SILENT || !LIBRARY
+		counters_report(gfp);
+#endif
+		if (reset_flag) {
+			reset_counters();
+		}
+#if	LIBRARY
+		return(result_str != NULL);
+#else
+		return true;
+#endif
+	}
 #if	LIBRARY
 	free_result_str();
 	result_str = strdup(VERSION);
@@ -243,6 +315,159 @@ char	*cp;	/* the command-line argument */
 #endif
 }
 
+static const char *rule_names[N_RULES] = {	/* function names of the counted transformation rules, in enum rule_list order */
+	"fplus_sub",
+	"ftimes_sub",
+	"fpower_sub",
+	"sf_sub",
+	"unf_sub",
+	"usp_sub",
+	"pf_sub",
+	"func_sub"
+};
+
+static const char *mem_names[N_MEM] = {	/* memory category names, in enum mem_list order */
+	"temporary",
+	"equations",
+	"variables",
+	"functions",
+	"strings",
+	"display",
+	"input"
+};
+
+/*
+ * Record the number of tokens in each equation space, if it is a new peak.
+ * Called after every command and by error_huge(); growth during a command is seen by note_tokens().
+ */
+void
+sample_peak_tokens(void)
+{
+	int	i, n;
+
+	for (i = 0; i < n_equations; i++) {
+		n = n_lhs[i] + n_rhs[i];
+		if (n > counters.peak_tokens[i])
+			counters.peak_tokens[i] = n;
+	}
+}
+
+/*
+ * Record the size of an expression being worked on, which may have grown,
+ * in the high-water mark of the current command.
+ * If it is an equation space side, also update that equation space's peak number of tokens.
+ * Called by organize(), which every pass that grows an expression calls.
+ */
+void
+note_tokens(np)
+int	*np;	/* pointer to the length of the expression */
+{
+	int	i;
+
+	if (*np > command_peak_tokens)
+		command_peak_tokens = *np;
+	if (np >= &n_lhs[0] && np < &n_lhs[N_EQUATIONS]) {
+		i = np - &n_lhs[0];
+	} else if (np >= &n_rhs[0] && np < &n_rhs[N_EQUATIONS]) {
+		i = np - &n_rhs[0];
+	} else {
+		return;
+	}
+	if (n_lhs[i] + n_rhs[i] > counters.peak_tokens[i])
+		counters.peak_tokens[i] = n_lhs[i] + n_rhs[i];
+}
+
+/*
+ * Zero all hot-path instrumentation counters,
+ * and start the memory peaks over from the memory in use now.
+ */
+void
+reset_counters(void)
+{
+	int	i;
+
+	memset(&counters, 0, sizeof(counters));
+	for (i = 0; i < N_MEM; i++) {
+		mem_stats.peak[i] = mem_stats.live[i];
+	}
+	mem_stats.total_peak = mem_stats.total_live;
+	mem_stats.quota_failures = 0;
+}
+
+/*
+ * Display the hot-path instrumentation counters to "ofp".
+ */
+void
+counters_report(ofp)
+FILE	*ofp;
+{
+	int	i, any = false;
+
+	fprintf(ofp, _("Hot-path instrumentation counters:\n"));
+	fprintf(ofp, _("se_compare() calls: %ld, early-outs because of size: %ld.\n"),
+	    counters.se_compare_calls, counters.se_compare_early_outs);
+	fprintf(ofp, _("blt() bytes moved: %.0f.\n"), counters.blt_bytes);
+	fprintf(ofp, _("simp_loop() iterations: %ld.\n"), counters.simp_loop_iterations);
+	fprintf(ofp, _("error_huge() aborts: %ld.\n"), counters.error_huge_aborts);
+	fprintf(ofp, _("Transformation rule hits/tries:"));
+	for (i = 0; i < N_RULES; i++) {
+		fprintf(ofp, "%s %s %ld/%ld", (i ? "," : ""), rule_names[i], counters.rule_hits[i], counters.rule_calls[i]);
+	}
+	fprintf(ofp, ".\n");
+	fprintf(ofp, _("Peak tokens per equation space:"));
+	for (i = 0; i < N_EQUATIONS; i++) {
+		if (counters.peak_tokens[i]) {
+			fprintf(ofp, "%s #%d %d", (any ? "," : ""), i + 1, counters.peak_tokens[i]);
+			any = true;
+		}
+	}
+	fprintf(ofp, "%s\n", (any ? "." : _(" none.")));
+	fprintf(ofp, _("Memory in use/peak bytes:"));
+	for (i = 0; i < N_MEM; i++) {
+		fprintf(ofp, "%s %s %ld/%ld", (i ? "," : ""), mem_names[i], mem_stats.live[i], mem_stats.peak[i]);
+	}
+	fprintf(ofp, _(", total %ld/%ld.\n"), mem_stats.total_live, mem_stats.total_peak);
+	if (mem_stats.quota > 0) {
+		fprintf(ofp, _("Memory quota: %ld bytes, exceeded %ld times.\n"), mem_stats.quota, mem_stats.quota_failures);
+	}
+}
+
+/*
+ * Return the hot-path instrumentation counters as a JSON object string,
+ * in a static buffer that is overwritten by the next call.
+ */
+char *
+counters_json(void)
+{
+	static char	buf[(N_RULES + N_EQUATIONS + N_MEM) * 48 + 768];
+	int		i, len, any = false;
+
+	len = snprintf(buf, sizeof(buf), "{\"se_compare_calls\": %ld, \"se_compare_early_outs\": %ld, "
+	    "\"blt_bytes\": %.0f, \"simp_loop_iterations\": %ld, \"error_huge_aborts\": %ld, \"rules\": {",
+	    counters.se_compare_calls, counters.se_compare_early_outs, counters.blt_bytes,
+	    counters.simp_loop_iterations, counters.error_huge_aborts);
+	for (i = 0; i < N_RULES; i++) {
+		len += snprintf(&buf[len], sizeof(buf) - len, "%s\"%s\": {\"calls\": %ld, \"hits\": %ld}",
+		    (i ? ", " : ""), rule_names[i], counters.rule_calls[i], counters.rule_hits[i]);
+	}
+	len += snprintf(&buf[len], sizeof(buf) - len, "}, \"peak_tokens\": {");
+	for (i = 0; i < N_EQUATIONS; i++) {
+		if (counters.peak_tokens[i]) {
+			len += snprintf(&buf[len], sizeof(buf) - len, "%s\"%d\": %d", (any ? ", " : ""), i + 1, counters.peak_tokens[i]);
+			any = true;
+		}
+	}
+	len += snprintf(&buf[len], sizeof(buf) - len, "}, \"memory\": {");
+	for (i = 0; i < N_MEM; i++) {
+		len += snprintf(&buf[len], sizeof(buf) - len, "\"%s\": {\"live\": %ld, \"peak\": %ld}, ",
+		    mem_names[i], mem_stats.live[i], mem_stats.peak[i]);
+	}
+	snprintf(&buf[len], sizeof(buf) - len, "\"total\": {\"live\": %ld, \"peak\": %ld}, "
+	    "\"quota\": %ld, \"quota_failures\": %ld}}",
+	    mem_stats.total_live, mem_stats.total_peak, mem_stats.quota, mem_stats.quota_failures);
+	return buf;
+}
+
 /*
  * Return the maximum amount of memory (in bytes) that this program will use.
  */
@@ -301,6 +526,9 @@ version_report(void)
 		break;
 	}
 	show_status(gfp);
+	sample_peak_tokens();
+	fprintf(gfp, "\n");
+	counters_report(gfp);
 	fprintf(gfp, _("\nCompile-time defines used: "));
 #if	linux
 	fprintf(gfp, "linux ");
@@ -383,6 +611,8 @@ version_report(void)
 	} else {
 		fprintf(gfp, _("making the maximum memory usage approximately %ld kilobytes.\n"), l);
 	}
+	fprintf(gfp, _("Memory actually allocated is %ld kilobytes, with a peak of %ld kilobytes.\n"),
+	    mem_stats.total_live / 1000L, mem_stats.total_peak / 1000L);
 #if	SECURE
 	fprintf(gfp, _("Compiled for maximum security.\n"));
 #else
@@ -678,6 +908,7 @@ enum spf_function	current_function;
 	int		n, ns;
 	token_type	*dest, *source;
 	int		count_down;		/* if true, count down, otherwise count up */
+	long		count;			/* loop iteration count */
 	char		*cp1, buf[MAX_CMD_LEN];
 
 	if (current_not_defined()) {
@@ -776,7 +1007,15 @@ enum spf_function	current_function;
 		dest[0] = zero_token;
 	}
 	n = 1;
-	for (; count_down ? (start >= end) : (start <= end); count_down ? (start -= step) : (start += step)) {
+	if (current_function != FOR_COMMAND) {
+		numeric_sum_product(source, ns, v, &start, end, step, count_down,
+		    current_function == PRODUCT_COMMAND, &dest[0].token.constant);
+	}
+	for (count = 1; count_down ? (start >= end) : (start <= end); count_down ? (start -= step) : (start += step), count++) {
+		if (aborted((current_function == PRODUCT_COMMAND) ? "product" : ((current_function == SUM_COMMAND) ? "sum" : "for"), count)) {
+			/* Control-C pressed or canceled, gracefully return to main prompt */
+			longjmp(jmp_save, 13);
+		}
 		if (n + 1 + ns > n_tokens) {
 			error_huge();
 		}
@@ -837,6 +1076,61 @@ enum spf_function	current_function;
 	}
 }
 
+/*
+ * Quickly sum or multiply a numerical expression for the sum and product commands,
+ * by compiling it once and evaluating it for each value of "v",
+ * with no expression building and simplification.
+ *
+ * Starts at "*startp" and accumulates the result into "*accp".
+ * Stops early if the expression contains other variables or something
+ * can't be calculated with real numbers, leaving "*startp" at the first value not done,
+ * so the symbolic loop can continue from there.
+ */
+static void
+numeric_sum_product(source, ns, v, startp, end, step, count_down, product_flag, accp)
+token_type	*source;	/* expression to sum or multiply */
+int		ns;		/* length of source */
+long		v;		/* the variable to plug in values for */
+double		*startp;	/* pointer to the current value of "v" */
+double		end, step;
+int		count_down;	/* if true, count down, otherwise count up */
+int		product_flag;	/* true for the product command, false for the sum command */
+double		*accp;		/* pointer to the accumulated result */
+{
+	code_type	*code;
+	double		*stack;
+	int		ncode;
+	long		count;
+	double		start, d, acc;
+
+	code = (code_type *) mem_alloc(ns * sizeof(code_type), MEM_TEMP);
+	stack = (double *) mem_alloc(ns * sizeof(double), MEM_TEMP);
+	if (code == NULL || stack == NULL || (ncode = compile_numeric(source, ns, &v, 1, code)) <= 0) {
+		mem_free(code, ns * sizeof(code_type), MEM_TEMP);
+		mem_free(stack, ns * sizeof(double), MEM_TEMP);
+		return;
+	}
+	start = *startp;
+	acc = *accp;
+	approximate_roots = true;
+	for (count = 1; count_down ? (start >= end) : (start <= end); count_down ? (start -= step) : (start += step), count++) {
+		if ((count & 0xffffL) == 0 && aborted(product_flag ? "product" : "sum", count)) {
+			/* Control-C pressed or canceled, gracefully return to main prompt */
+			mem_free(code, ns * sizeof(code_type), MEM_TEMP);
+			mem_free(stack, ns * sizeof(double), MEM_TEMP);
+			longjmp(jmp_save, 13);
+		}
+		if (!eval_numeric(code, ncode, &start, stack, &d))
+			break;
+		calc(NULL, &acc, product_flag ? TIMES : PLUS, d);
+	}
+	approximate_roots = false;
+	*startp = start;
+	*accp = acc;
+	mem_free(code, ns * sizeof(code_type), MEM_TEMP);
+	mem_free(stack, ns * sizeof(double), MEM_TEMP);
+}
+
 /*
  * This function is for the "optimize" command.
  * It finds and substitutes all occurrences of the RHS of "en" in "equation".
@@ -1371,6 +1665,18 @@ int	all_set_options;
 		fprintf(ofp, "right_associative_power\n");
 	}
 
+	if (command_stats_flag) {
+		fprintf(ofp, "command_statistics\n");
+	}
+
+	if (mem_stats.quota > 0) {
+		fprintf(ofp, "memory_quota = %ld\n", mem_stats.quota / 1048576L);
+	}
+
+	if (pass_profile_flag) {
+		fprintf(ofp, "pass_profile\n");
+	}
+
 #if	SHELL_OUT
 	fprintf(ofp, "plot_prefix = ");
 	fprintf_escaped(ofp, plot_prefix);
@@ -1511,6 +1817,80 @@ try_next_param:
 		goto try_next_param;
 	}
 #endif
+	if (strncasecmp(option_string, "command_statistics", 7) == 0) {
+		command_stats_flag = !negate;
+		goto try_next_param;
+	}
+	if (strncasecmp(option_string, "memory_quota", 6) == 0) {
+		if (negate) {
+			i = 0;
+		} else {
+			i = decstrtol(cp, &cp1);
+			if (i < 0 || cp1 == NULL || cp == cp1) {
+				error(_("Please specify the memory quota in megabytes; 0 = no quota."));
+				return false;
+			}
+			cp = cp1;
+		}
+		if (security_level >= 2 && mem_stats.quota > 0 && (i == 0 || i * 1048576L > mem_stats.quota)) {
+			error(_("The memory quota can only be lowered at this security level."));
+			return false;
+		}
+		mem_stats.quota = i * 1048576L;
+		goto try_next_param;
+	}
+	if (strncasecmp(option_string, "pass_profile", 6) == 0) {
+		if (negate) {
+			pass_profile_off();
+		} else {
+			pass_profile_flag = true;
+		}
+		goto try_next_param;
+	}
+	if (strncasecmp(option_string, "pass_schedule", 6) == 0) {
+		if (negate) {
+			memset(pass_skip, 0, sizeof(pass_skip));
+			return true;
+		}
+#if	!SECURE
+		if (security_level < 3) {
+			if (*cp == '\0') {
+				error(_("Please specify the pass profile file name."));
+				return false;
+			}
+			if ((i = load_pass_schedule(cp)) < 0) {
+				return false;
+			}
+			if (!quiet_mode) {
+				printf(_("%d simplify passes will be skipped.\n"), i);
+			}
+			return true;
+		}
+#endif
+		error(_("Option disabled by security level."));
+		return false;
+	}
+	if (strncasecmp(option_string, "trace", 5) == 0) {
+		if (negate) {
+			trace_close();
+			return true;
+		}
+#if	!SECURE
+		if (security_level < 2) {
+			if (*cp == '\0') {
+				error(_("Please specify the trace file name."));
+				return false;
+			}
+			if (!trace_open(cp)) {
+				error(_("Can't open trace file for writing."));
+				return false;
+			}
+			return true;
+		}
+#endif
+		error(_("Option disabled by security level."));
+		return false;
+	}
 	if (strncasecmp(option_string, "special", 7) == 0) {
 		if (negate) {
 			special_variable_characters[0] = '\0';
@@ -2635,6 +3015,11 @@ char	*cp;
 	}
 	show_usage = false;
 	fprintf(gfp, _("Comparing #%d with #%d...\n"), i + 1, j + 1);
+/* user-defined function calls are compared by their bodies */
+	expand_user_calls(lhs[i], &n_lhs[i], 0L);
+	expand_user_calls(rhs[i], &n_rhs[i], 0L);
+	expand_user_calls(lhs[j], &n_lhs[j], 0L);
+	expand_user_calls(rhs[j], &n_rhs[j], 0L);
 	simp_equation(i);
 	simp_equation(j);
 	if (n_rhs[i] == 0 || n_rhs[j] == 0) {
@@ -3422,6 +3807,8 @@ char	*cp;
 			} else if (!solved_equation(k)) {
 				warning(_("Equation is not solved for a normal variable."));
 			}
+			expand_code_calls(lhs[k], &n_lhs[k], language);
+			expand_code_calls(rhs[k], &n_rhs[k], language);
 			simp_i(lhs[k], &n_lhs[k]);
 			if (int_flag) {
 				/* factor_constants() for more accurate integer results. */
@@ -4439,6 +4826,366 @@ char	*cp;
 #endif
 
 #if	!SECURE
+/*
+ * Binary snapshot files.
+ * A snapshot holds every non-empty equation space exactly as it is stored in memory,
+ * along with the variable names table and the options that affect how expressions are handled.
+ * Restoring one requires no parsing, so it is very fast, and all constants are restored to the bit.
+ * Snapshots are only readable on machines with the same byte order and token size.
+ * User-defined functions are not in snapshots, so their calls are stored expanded.
+ *
+ * The layout is a snapshot_header, followed by n_options ints, then n_vars null-terminated
+ * variable names, then n_spaces records, each a snapshot_record followed by its LHS and RHS tokens.
+ */
+#define	SNAPSHOT_MAGIC		"\177Mathomatic snapshot\n"	/* starts every snapshot file, first character can't start a script */
+#define	SNAPSHOT_VERSION	1				/* increment when the layout changes */
+#define	SNAPSHOT_BYTE_ORDER	0x01020304
+
+typedef struct {
+	char	magic[24];	/* SNAPSHOT_MAGIC */
+	int	version;	/* SNAPSHOT_VERSION */
+	int	byte_order;	/* SNAPSHOT_BYTE_ORDER, as stored on this machine */
+	int	token_size;	/* sizeof(token_type) */
+	int	n_options;	/* number of saved options */
+	int	n_vars;		/* number of saved variable names */
+	int	n_spaces;	/* number of saved equation spaces */
+	int	cur_equation;	/* current equation space number */
+	int	reserved;
+} snapshot_header;
+
+typedef struct {
+	int	en;		/* equation space number */
+	int	n_lhs;		/* number of LHS tokens following */
+	int	n_rhs;		/* number of RHS tokens following */
+	int	reserved;
+} snapshot_record;
+
+/* Options saved in snapshots.  Only add to the end of this list, so older snapshots can still be read. */
+static int	*snapshot_options[] = {
+	&precision,
+	&case_sensitive_flag,
+	&factor_int_flag,
+	&display2d,
+	&fractions_display,
+	&preserve_surds,
+	&rationalize_denominators,
+	&modulus_mode,
+	&finance_option,
+	&autosolve,
+	&autocalc,
+	&autodelete,
+	&autoselect,
+	&right_associative_power
+};
+
+/*
+ * Write all equation spaces, variable names, and options to "fp" as a binary snapshot.
+ *
+ * Return true if successful.
+ */
+static int
+write_snapshot(fp)
+FILE	*fp;
+{
+	snapshot_header	header;
+	snapshot_record	record;
+	int		i;
+
+	memset(&header, 0, sizeof(header));
+	my_strlcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+	header.version = SNAPSHOT_VERSION;
+	header.byte_order = SNAPSHOT_BYTE_ORDER;
+	header.token_size = sizeof(token_type);
+	header.n_options = ARR_CNT(snapshot_options);
+	for (i = 0; var_names[i]; i++)
+		;
+	header.n_vars = i;
+	for (i = 0; i < n_equations; i++) {
+		if (n_lhs[i] > 0)
+			header.n_spaces++;
+	}
+	header.cur_equation = cur_equation;
+	if (fwrite(&header, sizeof(header), 1, fp) != 1)
+		return false;
+	for (i = 0; i < ARR_CNT(snapshot_options); i++) {
+		if (fwrite(snapshot_options[i], sizeof(int), 1, fp) != 1)
+			return false;
+	}
+	for (i = 0; var_names[i]; i++) {
+		if (fwrite(var_names[i], strlen(var_names[i]) + 1, 1, fp) != 1)
+			return false;
+	}
+	memset(&record, 0, sizeof(record));
+	for (i = 0; i < n_equations; i++) {
+		if (n_lhs[i] <= 0)
+			continue;
+		blt(tlhs, lhs[i], n_lhs[i] * sizeof(token_type));
+		n_tlhs = n_lhs[i];
+		blt(trhs, rhs[i], n_rhs[i] * sizeof(token_type));
+		n_trhs = n_rhs[i];
+		expand_user_calls(tlhs, &n_tlhs, 0L);
+		expand_user_calls(trhs, &n_trhs, 0L);
+		record.en = i;
+		record.n_lhs = n_tlhs;
+		record.n_rhs = n_trhs;
+		if (fwrite(&record, sizeof(record), 1, fp) != 1
+		    || fwrite(tlhs, sizeof(token_type), n_tlhs, fp) != n_tlhs
+		    || fwrite(trhs, sizeof(token_type), n_trhs, fp) != n_trhs)
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Check that a snapshot expression is valid and uses only saved variable names.
+ *
+ * Return true if it is.
+ */
+static int
+snapshot_side_ok(cp, n, n_vars)
+char		*cp;	/* expression tokens in the snapshot, possibly unaligned */
+int		n;	/* expression length */
+int		n_vars;	/* number of variable names in the snapshot */
+{
+	token_type	token;
+	long		l;
+	int		i;
+
+	if (n < 0 || n > n_tokens || (n & 1) == 0)
+		return(n == 0);
+	for (i = 0; i < n; i++) {
+		blt(&token, cp + i * sizeof(token_type), sizeof(token));
+		if (token.level <= 0)
+			return false;
+		scratch[i] = token;
+		if ((i & 1) == 0) {
+			switch (token.kind) {
+			case CONSTANT:
+				break;
+			case VARIABLE:
+				l = (token.token.variable & VAR_MASK) - VAR_OFFSET;
+				if (token.token.variable <= 0 || l >= n_vars)
+					return false;
+				break;
+			default:
+				return false;
+			}
+		} else if (token.kind != OPERATOR || token.token.operatr < PLUS
+		    || (token.token.operatr > FACTORIAL && !IS_FUNC_OP(token.token.operatr))) {
+			return false;
+		}
+	}
+	return check_calls(scratch, n);
+}
+
+/*
+ * Change the saved variable name indexes in expression "p1" to those of this session.
+ */
+static void
+snapshot_remap_vars(p1, n, var_map)
+token_type	*p1;
+int		n;
+long		*var_map;	/* new variable name index for each saved one */
+{
+	int	i;
+	long	l;
+
+	for (i = 0; i < n; i += 2) {
+		if (p1[i].kind == VARIABLE) {
+			l = (p1[i].token.variable & VAR_MASK) - VAR_OFFSET;
+			if (l >= 0) {
+				p1[i].token.variable = (p1[i].token.variable & ~VAR_MASK) + var_map[l] + VAR_OFFSET;
+			}
+		}
+	}
+}
+
+/*
+ * Restore a binary snapshot from "data".
+ * The saved equation spaces replace the same numbered equation spaces,
+ * saved variable names are matched with existing ones by name,
+ * and the saved options are set.
+ *
+ * Return true if successful.
+ */
+static int
+load_snapshot(data, size)
+char	*data;	/* snapshot file contents */
+size_t	size;	/* size of data in bytes */
+{
+	snapshot_header	header;
+	snapshot_record	record;
+	size_t		pos, len, opt_pos, name_pos;
+	char		*cp;
+	int		i, k;
+	int		identity = true;
+	long		*var_map = NULL;
+	int		(*strcmpfunc)();
+
+	if (size < sizeof(header)) {
+		error(_("Not a Mathomatic snapshot file."));
+		return false;
+	}
+	blt(&header, data, sizeof(header));
+	if (memcmp(header.magic, SNAPSHOT_MAGIC, strlen(SNAPSHOT_MAGIC)) != 0) {
+		error(_("Not a Mathomatic snapshot file."));
+		return false;
+	}
+	if (header.version != SNAPSHOT_VERSION) {
+		error(_("Snapshot file was made by an incompatible version of Mathomatic."));
+		return false;
+	}
+	if (header.byte_order != SNAPSHOT_BYTE_ORDER || header.token_size != sizeof(token_type)) {
+		error(_("Snapshot file was made on an incompatible computer."));
+		return false;
+	}
+	if (header.n_options < 0 || header.n_vars < 0 || header.n_vars >= MAX_VAR_NAMES
+	    || header.n_spaces < 0 || header.n_spaces > N_EQUATIONS
+	    || header.cur_equation < 0 || header.cur_equation >= N_EQUATIONS)
+		goto corrupt;
+	pos = sizeof(header);
+	if ((size - pos) / sizeof(int) < (size_t) header.n_options)
+		goto corrupt;
+	opt_pos = pos;
+	pos += header.n_options * sizeof(int);
+	name_pos = pos;
+	for (i = 0; i < header.n_vars; i++) {
+		if (pos >= size || (cp = memchr(&data[pos], '\0', size - pos)) == NULL)
+			goto corrupt;
+		len = cp - &data[pos];
+		if (len == 0 || len > MAX_VAR_LEN)
+			goto corrupt;
+		pos += len + 1;
+	}
+/* check everything before changing anything */
+	for (i = 0, len = pos; i < header.n_spaces; i++) {
+		if (size - len < sizeof(record))
+			goto corrupt;
+		blt(&record, &data[len], sizeof(record));
+		len += sizeof(record);
+		if (record.en < 0 || record.en >= N_EQUATIONS || record.n_lhs <= 0
+		    || (size - len) / sizeof(token_type) < (size_t) record.n_lhs + (size_t) record.n_rhs
+		    || !snapshot_side_ok(&data[len], record.n_lhs, header.n_vars)
+		    || !snapshot_side_ok(&data[len + record.n_lhs * sizeof(token_type)], record.n_rhs, header.n_vars))
+			goto corrupt;
+		len += (record.n_lhs + record.n_rhs) * sizeof(token_type);
+	}
+	for (i = 0; i < header.n_options && i < ARR_CNT(snapshot_options); i++) {
+		blt(snapshot_options[i], &data[opt_pos + i * sizeof(int)], sizeof(int));
+	}
+	if (case_sensitive_flag) {
+		strcmpfunc = strcmp;
+	} else {
+		strcmpfunc = strcasecmp;
+	}
+	if (header.n_vars > 0) {
+		var_map = (long *) mem_alloc(header.n_vars * sizeof(long), MEM_INPUT);
+		if (var_map == NULL) {
+			error(_("Out of memory (can't malloc(3))."));
+			return false;
+		}
+	}
+	for (i = 0; i < header.n_vars; i++, name_pos += len + 1) {
+		len = strlen(&data[name_pos]);
+		for (k = 0; var_names[k]; k++) {
+			if ((*strcmpfunc)(&data[name_pos], var_names[k]) == 0)
+				break;
+		}
+		if (var_names[k] == NULL) {
+			if (k >= (MAX_VAR_NAMES - 1)) {
+				error(_("Maximum number of variable names reached."));
+				mem_free(var_map, header.n_vars * sizeof(long), MEM_INPUT);
+				return false;
+			}
+			if ((var_names[k] = (char *) mem_alloc(len + 1, MEM_VARIABLES)) == NULL) {
+				error(_("Out of memory (can't malloc(3) variable name)."));
+				mem_free(var_map, header.n_vars * sizeof(long), MEM_INPUT);
+				return false;
+			}
+			blt(var_names[k], &data[name_pos], len + 1);
+			var_names[k+1] = NULL;
+		}
+		var_map[i] = k;
+		if (k != i)
+			identity = false;
+	}
+	for (i = 0; i < header.n_spaces; i++) {
+		blt(&record, &data[pos], sizeof(record));
+		pos += sizeof(record);
+		if (!alloc_to_espace(record.en) || !alloc_espace(record.en)) {
+			mem_free(var_map, header.n_vars * sizeof(long), MEM_INPUT);
+			error(_("Out of free equation spaces."));
+			return false;
+		}
+		blt(lhs[record.en], &data[pos], record.n_lhs * sizeof(token_type));
+		pos += record.n_lhs * sizeof(token_type);
+		blt(rhs[record.en], &data[pos], record.n_rhs * sizeof(token_type));
+		pos += record.n_rhs * sizeof(token_type);
+		if (!identity) {
+			snapshot_remap_vars(lhs[record.en], record.n_lhs, var_map);
+			snapshot_remap_vars(rhs[record.en], record.n_rhs, var_map);
+		}
+		n_lhs[record.en] = record.n_lhs;
+		n_rhs[record.en] = record.n_rhs;
+	}
+	mem_free(var_map, header.n_vars * sizeof(long), MEM_INPUT);
+	if (alloc_to_espace(header.cur_equation))
+		cur_equation = header.cur_equation;
+	set_sign_array();
+	return true;
+
+corrupt:
+	error(_("Snapshot file is corrupt."));
+	return false;
+}
+
+/*
+ * Restore the binary snapshot file open on "fp", which is positioned after its first character.
+ * On Unix it is memory-mapped, otherwise it is read into memory.
+ *
+ * Return zero if successful, non-zero on error, like read_sub().
+ */
+static int
+read_snapshot(fp, filename)
+FILE	*fp;		/* open snapshot file */
+char	*filename;	/* filename of fp */
+{
+	char	*data = NULL;
+	size_t	size = 0;
+	int	rv;
+#if	UNIX
+	struct stat	st;
+
+	if (fstat(fileno(fp), &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 && (off_t) (size_t) st.st_size == st.st_size) {
+		data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+		if (data == MAP_FAILED) {
+			data = NULL;
+		} else {
+			size = st.st_size;
+		}
+	}
+	if (data) {
+		rv = !load_snapshot(data, size);
+		munmap(data, size);
+		return rv;
+	}
+#endif
+	if (fseek(fp, 0L, SEEK_END) == 0 && ftell(fp) > 0) {
+		size = ftell(fp);
+		rewind(fp);
+		data = (char *) mem_alloc(size, MEM_INPUT);
+	}
+	if (data == NULL || fread(data, 1, size, fp) != size) {
+		perror(filename);
+		error(_("Error reading snapshot file."));
+		mem_free(data, size, MEM_INPUT);
+		return 1;
+	}
+	rv = !load_snapshot(data, size);
+	mem_free(data, size, MEM_INPUT);
+	return rv;
+}
+
 /*
  * The read command.
  */
@@ -4471,7 +5218,7 @@ int
 read_file(cp)
 char	*cp;
 {
-	int	rv;
+	int	rv, ch;
 	FILE	*fp;
 	char	buf[MAX_CMD_LEN];
 #if	SHELL_OUT
@@ -4533,7 +5280,13 @@ char	*cp;
 			}
 		}
 	}
-	rv = read_sub(fp, buf);
+	if ((ch = getc(fp)) == SNAPSHOT_MAGIC[0]) {
+		rv = read_snapshot(fp, buf);
+	} else {
+		if (ch != EOF)
+			ungetc(ch, fp);
+		rv = read_sub(fp, buf);
+	}
 	show_usage = false;
 	if (fclose(fp)) {
 		perror(buf);
@@ -4556,8 +5309,94 @@ char	*cp;
 	return(!rv);
 }
 
+/*
+ * Script file input state for read_sub().
+ * Regular files are memory-mapped when possible and split into lines in place,
+ * otherwise lines are read from the file pointer.
+ * Lines of any length are copied into a line buffer that grows as needed.
+ */
+typedef struct {
+	FILE	*fp;		/* open Mathomatic input file */
+	char	*map;		/* memory-mapped file contents, or NULL if reading from fp */
+	size_t	map_size;	/* size of map in bytes */
+	size_t	pos;		/* offset of the next line in map */
+	char	*buf;		/* line buffer */
+	size_t	buf_size;	/* size of buf in bytes */
+} script_type;
+
+static int	read_depth;	/* nesting level of script files being read by read_sub() */
+
+/*
+ * Make sure the line buffer in "sp" can hold "size" bytes.
+ *
+ * Return true if successful.
+ */
+static int
+script_buf_grow(sp, size)
+script_type	*sp;
+size_t		size;
+{
+	char	*cp;
+	size_t	new_size;
+
+	if (size <= sp->buf_size)
+		return true;
+	for (new_size = max(sp->buf_size, MAX_CMD_LEN); new_size < size; new_size *= 2)
+		;
+	if ((cp = (char *) mem_realloc(sp->buf, sp->buf_size, new_size, MEM_INPUT)) == NULL) {
+		error(_("Out of memory (can't malloc(3))."));
+		return false;
+	}
+	sp->buf = cp;
+	sp->buf_size = new_size;
+	return true;
+}
+
+/*
+ * Get the next line of a script file, including any newline character, into the line buffer.
+ *
+ * Return a pointer to the line, or NULL on end of file or error.
+ */
+static char *
+script_line(sp)
+script_type	*sp;
+{
+	char	*cp;
+	size_t	len;
+
+	if (sp->map) {
+		if (sp->pos >= sp->map_size)
+			return NULL;
+		cp = memchr(&sp->map[sp->pos], '\n', sp->map_size - sp->pos);
+		if (cp) {
+			len = (cp + 1) - &sp->map[sp->pos];
+		} else {
+			len = sp->map_size - sp->pos;
+		}
+		if (!script_buf_grow(sp, len + 1))
+			return NULL;
+		blt(sp->buf, &sp->map[sp->pos], len);
+		sp->buf[len] = '\0';
+		sp->pos += len;
+		return sp->buf;
+	}
+	if (!script_buf_grow(sp, MAX_CMD_LEN))
+		return NULL;
+	if (fgets(sp->buf, (int) sp->buf_size, sp->fp) == NULL)
+		return NULL;
+	for (len = strlen(sp->buf); len > 0 && sp->buf[len-1] != '\n'; len += strlen(&sp->buf[len])) {
+		if (!script_buf_grow(sp, sp->buf_size * 2))
+			return NULL;
+		if (fgets(&sp->buf[len], (int) (sp->buf_size - len), sp->fp) == NULL)
+			break;
+	}
+	return sp->buf;
+}
+
 /*
  * Read and process Mathomatic input from a file pointer.
+ * Lines may be any length.
+ * Shows the number of lines processed per second after long scripts.
  *
  * Return zero if no error, non-zero if read aborted.
  */
@@ -4566,14 +5405,35 @@ read_sub(fp, filename)
 FILE	*fp;		/* open Mathomatic input file */
 char	*filename;	/* filename of fp */
 {
-	int	rv;
-	jmp_buf	save_save;
-	char	*cp;
-	int	something_there = false;
+	int		rv;
+	jmp_buf		save_save;
+	char		*cp;
+	int		something_there = false;
+	script_type	script;
+	long		line_count = 0;
+	double		start_time, elapsed;
+#if	UNIX
+	struct stat	st;
+#endif
 
 	if (fp == NULL) {
 		return -1;
 	}
+	memset(&script, 0, sizeof(script));
+	script.fp = fp;
+#if	UNIX
+	if (fstat(fileno(fp), &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 && (off_t) (size_t) st.st_size == st.st_size) {
+		script.map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+		if (script.map == MAP_FAILED) {
+			script.map = NULL;
+		} else {
+			script.map_size = st.st_size;
+			madvise(script.map, script.map_size, MADV_SEQUENTIAL);	/* ask for read-ahead */
+		}
+	}
+#endif
+	start_time = get_time();
+	read_depth++;
 	blt(save_save, jmp_save, sizeof(jmp_save));
 	if ((rv = setjmp(jmp_save)) != 0) {	/* trap errors */
 		clean_up();
@@ -4582,7 +5442,8 @@ char	*filename;	/* filename of fp */
 		}
 		previous_return_value = 0;
 	} else {
-		while ((cp = fgets((char *) tlhs, n_tokens * sizeof(token_type), fp)) != NULL) {
+		while ((cp = script_line(&script)) != NULL) {
+			line_count++;
 			if (*cp) {
 				something_there = true;
 			}
@@ -4602,6 +5463,17 @@ char	*filename;	/* filename of fp */
 		}
 	}
 	blt(jmp_save, save_save, sizeof(jmp_save));
+#if	UNIX
+	if (script.map) {
+		munmap(script.map, script.map_size);
+	}
+#endif
+	mem_free(script.buf, script.buf_size, MEM_INPUT);
+	elapsed = get_time() - start_time;
+	read_depth--;
+	if (rv == 0 && !test_mode && !quiet_mode && read_depth == 0 && elapsed >= 1.0) {
+		fprintf(stderr, _("Processed %ld lines in %.2f seconds (%.0f lines per second).\n"), line_count, elapsed, line_count / elapsed);
+	}
 	return rv;
 }
 #endif
@@ -4687,6 +5559,7 @@ char	*cp;
 #endif
 		gfp = fp;
 		high_prec = true;
+		list_functions();
 		list_cmd("all");
 		high_prec = false;
 		gfp = default_out;
@@ -4724,6 +5597,7 @@ char	*cp;
 {
 	FILE	*fp;
 	int	rv, space_flag = false, error_flag;
+	int	binary_flag = false;
 	char	*cp1;
 
 	if (security_level >= 2) {
@@ -4732,6 +5606,10 @@ char	*cp;
 		return false;
 	}
 	clean_up();	/* end any redirection */
+	if (strcmp_tospace(cp, "binary") == 0) {
+		binary_flag = true;
+		cp = skip_param(cp);
+	}
 	if (*cp == '\0') {
 		error(_("No file name specified; nothing was saved."));
 		return false;
@@ -4749,7 +5627,7 @@ char	*cp;
 			return false;
 		}
 		snprintf(prompt_str, sizeof(prompt_str), _("File \"%s\" exists, overwrite (y/n)? "), cp);
-		if (!get_yes_no()) {
+		if (!test_mode && !get_yes_no()) {	/* test scripts may be run repeatedly */
 			error(_("File not overwritten; nothing was saved."));
 			return false;
 		}
@@ -4761,17 +5639,21 @@ char	*cp;
 		}
 	}
 #endif
-	fp = fopen(cp, "w");
+	fp = fopen(cp, binary_flag ? "wb" : "w");
 	if (fp == NULL) {
 		perror(cp);
 		error(_("Cannot create specified save file; nothing was saved."));
 		return false;
 	}
-	gfp = fp;
-	high_prec = true;
-	rv = list_cmd("all");
-	high_prec = false;
-	gfp = default_out;
+	if (binary_flag) {
+		rv = write_snapshot(fp);
+	} else {
+		gfp = fp;
+		high_prec = true;
+		rv = list_functions() && list_cmd("all");
+		high_prec = false;
+		gfp = default_out;
+	}
 	error_flag = ferror(fp);
 	if (fclose(fp) || error_flag) {
 		rv = false;
@@ -4779,7 +5661,11 @@ char	*cp;
 	}
 	if (rv) {
 #if	!SILENT
-		printf(_("All expressions saved in file \"%s\".\n"), cp);
+		if (binary_flag) {
+			printf(_("All equation spaces saved in binary snapshot file \"%s\".\n"), cp);
+		} else {
+			printf(_("All expressions saved in file \"%s\".\n"), cp);
+		}
 #endif
 	} else {
 		error(_("Error encountered while saving expressions."));
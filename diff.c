@@ -76,6 +76,8 @@ long		v;
 	int		n;
 	int		op;
 	int		oploc, endloc;
+	int		arg_start[MAX_FUNC_ARGS], arg_len[MAX_FUNC_ARGS];
+	token_type	*tp;
 	complexs	c;
 
 	if (equation[loc].level < level) {
@@ -101,6 +103,8 @@ long		v;
 			case MINUS:
 				break;
 			default:
+				if (IS_FUNC_OP(op) && equation[endloc].token.operatr == op)
+					break;	/* a function call of more than one argument */
 /* Oops.  More than one operator on the same level in this expression. */
 				error_bug("Internal error in d_recurse(): differentiating with unparenthesized operators is not allowed.");
 				return false;
@@ -128,6 +132,8 @@ long		v;
 			if (equation[i].kind == VARIABLE
 			    && ((v == MATCH_ANY && (equation[i].token.variable & VAR_MASK) > SIGN)
 			    || equation[i].token.variable == v)) {
+				if (IS_FUNC_OP(op))
+					goto d_function;
 				return false;
 			}
 		}
@@ -298,6 +304,34 @@ d_power:
 	*np += loc + n - endloc;
 	blt(&equation[loc], scratch, n * sizeof(token_type));
 	return(d_recurse(equation, np, loc + j, level + 1, v));
+d_function:
+	if (FUNC_NUMBER(op) >= FIRST_USER_FUNC) {
+/* Differentiate the body of a user-defined function, in place of the call. */
+		if (!expand_call(equation, np, loc))
+			return false;
+		return(d_recurse(equation, np, loc, level, v));
+	}
+/* Differentiate a function call of one argument. */
+/* Use the chain rule: d(f(u)) = f'(u)*d(u), where f'() is the derivative of f() from "function.c". */
+	if ((tp = func_derivative(op, &n)) == NULL || call_args(equation, *np, loc, arg_start, arg_len) != 1)
+		return false;
+	j = subst_template(scratch, n_tokens, tp, n, equation, arg_start, arg_len, level);
+	if (j + 1 + arg_len[0] > n_tokens) {
+		error_huge();
+	}
+	scratch[j].level = level;
+	scratch[j].kind = OPERATOR;
+	scratch[j].token.operatr = TIMES;
+	j++;
+	blt(&scratch[j], &equation[arg_start[0]], arg_len[0] * sizeof(token_type));
+	n = j + arg_len[0];
+	if (*np - (endloc - loc) + n > n_tokens) {
+		error_huge();
+	}
+	blt(&equation[loc+n], &equation[endloc], (*np - endloc) * sizeof(token_type));
+	*np += loc + n - endloc;
+	blt(&equation[loc], scratch, n * sizeof(token_type));
+	return(d_recurse(equation, np, loc + j, level + 1, v));
 }
 
 /*
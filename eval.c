@@ -0,0 +1,275 @@
+/*
+ * Mathomatic compiled numerical expression evaluation routines.
+ *
+ * Copyright (C) 1987-2012 George Gesslein II.
+ 
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+The chief copyright holder can be contacted at gesslein@mathomatic.org, or
+George Gesslein II, P.O. Box 224, Lansing, NY  14882-0224  USA.
+ 
+ */
+
+/*
+ * Simplifying a numerical expression in Mathomatic requires many memory moves
+ * for each and every operator in it.  When the same expression must be evaluated
+ * over and over with different values plugged in for its variables,
+ * it is much faster to convert it once into a list of postfix stack machine instructions
+ * (code_type, defined in "am.h"), and run that.
+ *
+ * Each expression token becomes at most one instruction, so the code array
+ * and the evaluation stack need only be as large as the expression.
+ * A function call becomes its arguments, followed by one instruction that calls the function.
+ * All arithmetic is done with calc(), so the results are the same as
+ * those of the approximating simplifiers.
+ */
+
+#include "includes.h"
+
+static int compile_recurse(token_type *p1, int n, int level, long *vars, int nvars, code_type *code, int *ip);
+
+/*
+ * Compile expression "p1" into "code", which must have room for "n" instructions.
+ * "vars" is the list of the "nvars" variables that will have values supplied at evaluation time,
+ * their position in this list is the index into the values array passed to eval_numeric().
+ * The constants e and pi are compiled in as their numerical value.
+ *
+ * Return the number of instructions stored in "code",
+ * or -1 if the expression contains any other variables.
+ */
+int
+compile_numeric(p1, n, vars, nvars, code)
+token_type	*p1;	/* expression pointer */
+int		n;	/* expression length */
+long		*vars;	/* variables to be supplied, may be NULL if nvars is 0 */
+int		nvars;	/* number of variables in vars[] */
+code_type	*code;	/* where to store the compiled instructions */
+{
+	int	i = 0;
+
+	if (n <= 0 || (n & 1) == 0)
+		return -1;
+	if (!compile_recurse(p1, n, min_level(p1, n), vars, nvars, code, &i))
+		return -1;
+	return i;
+}
+
+/*
+ * Compile each operand at the current level of parentheses,
+ * each followed by the operator that precedes it.
+ * Operators on the same level are evaluated left to right.
+ *
+ * Return true if successful.
+ */
+static int
+compile_recurse(p1, n, level, vars, nvars, code, ip)
+token_type	*p1;
+int		n, level;
+long		*vars;
+int		nvars;
+code_type	*code;
+int		*ip;
+{
+	int	i, j, k;
+	int	call, nargs = 0;
+	double	d;
+
+	call = (n > 1 && p1[1].level == level && IS_FUNC_OP(p1[1].token.operatr));
+	for (i = (call ? 2 : 0);; i = j + 1) {
+		for (j = i + 1; j < n && p1[j].level > level; j += 2)
+			;
+		if (j - i == 1) {
+			code[*ip].operatr = 0;
+			code[*ip].slot = -1;
+			switch (p1[i].kind) {
+			case CONSTANT:
+				code[*ip].constant = p1[i].token.constant;
+				break;
+			case VARIABLE:
+				if (var_is_const(p1[i].token.variable, &d)) {
+					code[*ip].constant = d;
+					break;
+				}
+				for (k = 0; k < nvars; k++) {
+					if (vars[k] == p1[i].token.variable)
+						break;
+				}
+				if (k >= nvars)
+					return false;
+				code[*ip].slot = k;
+				break;
+			default:
+				return false;
+			}
+			(*ip)++;
+		} else if (!compile_recurse(&p1[i], j - i, level + 1, vars, nvars, code, ip)) {
+			return false;
+		}
+		if (call) {
+			nargs++;
+		} else if (i > 0) {
+			code[*ip].operatr = p1[i-1].token.operatr;
+			(*ip)++;
+		}
+		if (j >= n)
+			break;
+	}
+	if (call) {
+		code[*ip].operatr = p1[1].token.operatr;
+		code[*ip].slot = nargs;
+		(*ip)++;
+	}
+	return true;
+}
+
+/*
+ * Evaluate the compiled expression in "code",
+ * using "values" for the variables listed when it was compiled.
+ * "stack" is caller supplied temporary storage for "ncode" doubles;
+ * nothing is allocated here.
+ *
+ * Return true with the result in "*dp" if successful,
+ * or false if something could not be calculated with real numbers,
+ * like an imaginary root.
+ */
+int
+eval_numeric(code, ncode, values, stack, dp)
+code_type	*code;	/* compiled instructions */
+int		ncode;	/* number of instructions */
+double		*values;	/* variable values, indexed by slot */
+double		*stack;	/* evaluation stack */
+double		*dp;	/* where to store the result */
+{
+	int	i, sp = 0;
+	int	rv;
+	double	d;
+
+	for (i = 0; i < ncode; i++) {
+		if (code[i].operatr == 0) {
+			if (code[i].slot >= 0) {
+				stack[sp++] = values[code[i].slot];
+			} else {
+				stack[sp++] = code[i].constant;
+			}
+		} else if (IS_FUNC_OP(code[i].operatr)) {
+			sp -= code[i].slot;
+			if (!func_value(code[i].operatr, &stack[sp], code[i].slot, &d))
+				return false;
+			stack[sp++] = d;
+		} else {
+			sp--;
+			rv = calc(NULL, &stack[sp-1], code[i].operatr, stack[sp]);
+			if (code[i].operatr == POWER && !domain_check)
+				rv = false;	/* power was not calculated, probably imaginary */
+			domain_check = false;
+			if (!rv)
+				return false;
+		}
+	}
+	*dp = stack[0];
+	return(sp == 1);
+}
+
+/*
+ * Evaluate the compiled expression in "code" with complex number arithmetic,
+ * using "values" for the variables listed when it was compiled.
+ * "stack" is caller supplied temporary storage for "ncode" complex numbers;
+ * nothing is allocated here.
+ *
+ * Operations on real numbers are done with calc(), like eval_numeric(),
+ * so real results are the same.  Modulus, integer divide, factorial,
+ * and function calls can only be done on real numbers.
+ *
+ * Return true with the result in "*cp" if successful.
+ */
+int
+eval_complex(code, ncode, values, stack, cp)
+code_type	*code;	/* compiled instructions */
+int		ncode;	/* number of instructions */
+complexs	*values;	/* variable values, indexed by slot */
+complexs	*stack;	/* evaluation stack */
+complexs	*cp;	/* where to store the result */
+{
+	int		i, j, sp = 0;
+	int		rv;
+	complexs	a, b;
+	double		args[MAX_FUNC_ARGS];
+
+	for (i = 0; i < ncode; i++) {
+		if (code[i].operatr == 0) {
+			if (code[i].slot >= 0) {
+				stack[sp++] = values[code[i].slot];
+			} else {
+				stack[sp].re = code[i].constant;
+				stack[sp++].im = 0.0;
+			}
+			continue;
+		}
+		if (IS_FUNC_OP(code[i].operatr)) {
+			/* functions are only calculated with real number arguments */
+			sp -= code[i].slot;
+			for (j = 0; j < code[i].slot; j++) {
+				if (j >= MAX_FUNC_ARGS || stack[sp+j].im != 0.0)
+					return false;
+				args[j] = stack[sp+j].re;
+			}
+			if (!func_value(code[i].operatr, args, code[i].slot, &stack[sp].re))
+				return false;
+			stack[sp++].im = 0.0;
+			continue;
+		}
+		sp--;
+		a = stack[sp-1];
+		b = stack[sp];
+		if (a.im == 0.0 && b.im == 0.0) {
+			rv = calc(NULL, &stack[sp-1].re, code[i].operatr, b.re);
+			if (code[i].operatr == POWER && !domain_check)
+				rv = false;	/* power was not calculated, probably imaginary */
+			domain_check = false;
+			if (rv)
+				continue;
+			stack[sp-1] = a;
+			if (code[i].operatr != POWER)
+				return false;
+		}
+		switch (code[i].operatr) {
+		case PLUS:
+			a = complex_add(a, b);
+			break;
+		case MINUS:
+			a = complex_add(a, complex_negate(b));
+			break;
+		case TIMES:
+			a = complex_mult(a, b);
+			break;
+		case DIVIDE:
+			if (b.re == 0.0 && b.im == 0.0)
+				return false;
+			a = complex_div(a, b);
+			break;
+		case POWER:
+			if (a.re == 0.0 && a.im == 0.0)
+				return false;
+			a = complex_pow(a, b);
+			break;
+		default:
+			return false;
+		}
+		complex_fixup(&a);
+		stack[sp-1] = a;
+	}
+	*cp = stack[0];
+	return(sp == 1);
+}
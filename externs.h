@@ -126,11 +126,21 @@ extern int		security_level;
 extern int		repeat_flag;
 extern int		show_usage;
 extern int		point_flag;
+extern int		command_stats_flag;
+extern FILE		*trace_fp;
+extern counters_type	counters;
+extern mem_stats_type	mem_stats;
+extern int		command_peak_tokens;
+extern int		pass_profile_flag;
+extern pass_stats_type	pass_stats[N_PASSES];
+extern char		pass_skip[N_PASSES];
 
 extern char		*result_str;
 extern int		result_en;
+extern int		result_wanted;
+extern int		result_reuse;
+extern volatile int	*cancel_flagp;
+extern int		(*progress_callback)(const char *where, long count, void *data);
+extern void		*progress_data;
 extern const char	*error_str;
 extern const char	*warning_str;
-
-extern char		*vscreen[TEXT_ROWS];
-extern int		current_columns;
@@ -137,7 +137,7 @@ f_again:
 						break;
 				}
 				len2 = k - j;
-				if (fplus_sub(equation, np, loc, i, len1, j, len2, level + 1, v, d, whole_flag, div_only)) {
+				if (count_rule(R_FPLUS, fplus_sub(equation, np, loc, i, len1, j, len2, level + 1, v, d, whole_flag, div_only))) {
 					modified = true;
 					goto f_again;
 				}
@@ -734,7 +734,7 @@ f_again:
 						break;
 				}
 				len2 = k - j;
-				if (ftimes_sub(equation, np, loc, i, len1, j, len2, level + 1)) {
+				if (count_rule(R_FTIMES, ftimes_sub(equation, np, loc, i, len1, j, len2, level + 1))) {
 					modified = true;
 					goto f_again;
 				}
@@ -942,7 +942,7 @@ f_again:
 						break;
 				}
 				len2 = k - j;
-				if (fpower_sub(equation, np, loc, i, len1, j, len2, level + 1)) {
+				if (count_rule(R_FPOWER, fpower_sub(equation, np, loc, i, len1, j, len2, level + 1))) {
 					modified = true;
 					goto f_again;
 				}
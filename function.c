@@ -0,0 +1,1354 @@
+/*
+ * Mathomatic named function call routines.
+ *
+ * Copyright (C) 1987-2012 George Gesslein II.
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+The chief copyright holder can be contacted at gesslein@mathomatic.org, or
+George Gesslein II, P.O. Box 224, Lansing, NY  14882-0224  USA.
+
+ */
+
+/*
+ * A function call like "sin(x)" is kept in the expression as a group of tokens
+ * with the function call operator, as described in "am.h".
+ * To the rest of Mathomatic the group is just a parenthesized operand,
+ * which it can compare, move around, and factor out, but not look into.
+ * Calls with real number arguments are calculated by calc(), like any other operator,
+ * and the function identities are applied by simp_functions(), called from elim_loop().
+ */
+
+#include "includes.h"
+
+enum template_list {	/* the Mathomatic expressions of each built-in function, see builtins[] */
+	T_EXPANSION,
+	T_DERIVATIVE,
+	T_INVERSE,
+	N_TEMPLATES
+};
+
+enum builtin_list {	/* function numbers of the built-in functions, the index into builtins[]; also in lib/mathomatic.h */
+	F_SQRT, F_CBRT, F_EXP, F_ABS,
+	F_LOG, F_LOG10,
+	F_SIN, F_COS, F_TAN, F_ASIN, F_ACOS, F_ATAN,
+	F_SINH, F_COSH, F_TANH, F_ASINH, F_ACOSH, F_ATANH
+};
+
+/*
+ * The built-in functions of one argument, in function number order.
+ * Function numbers are stored in saved binary snapshots, so only add to the end.
+ *
+ * The templates are Mathomatic expressions of "x", the argument, parsed when first needed:
+ * "expansion" is the function written without named functions, the same as in "m4/functions.m4";
+ * "derivative" is the derivative with respect to "x";
+ * "inverse" is the solution of "f(y) = x" for "y", where "n" stands for any integer and "s" for any sign.
+ * A NULL template means there is none.
+ * If "func" is NULL, calls are always replaced with their expansion when parsed, so results stay exact.
+ */
+static const struct {
+	char	*name;
+	double	(*func)(double);
+	char	*templates[N_TEMPLATES];
+} builtins[] = {
+	{ "sqrt",	NULL,	{ "x^.5", NULL, NULL } },
+	{ "cbrt",	NULL,	{ "x^(1/3)", NULL, NULL } },
+	{ "exp",	NULL,	{ "e^x", NULL, NULL } },
+	{ "abs",	NULL,	{ "|x|", NULL, NULL } },
+	{ "log",	log,	{ NULL, "1/x", "e^x" } },
+	{ "log10",	log10,	{ "log(x)/log(10)", "1/(x*log(10))", "10^x" } },
+	{ "sin",	sin,	{ "(e^(i*x)-e^(-i*x))/(2i)", "cos(x)", "(-1)^n*asin(x)+n*pi" } },
+	{ "cos",	cos,	{ "(e^(i*x)+e^(-i*x))/2", "-sin(x)", "s*acos(x)+2*n*pi" } },
+	{ "tan",	tan,	{ "(e^(i*x)-e^(-i*x))/(i*(e^(i*x)+e^(-i*x)))", "1/cos(x)^2", "atan(x)+n*pi" } },
+	{ "asin",	asin,	{ "-i*log(i*x+(1-x^2)^.5)", "1/(1-x^2)^.5", "sin(x)" } },
+	{ "acos",	acos,	{ "-i*log(x+i*(1-x^2)^.5)", "-1/(1-x^2)^.5", "cos(x)" } },
+	{ "atan",	atan,	{ "i/2*log((1-i*x)/(1+i*x))", "1/(1+x^2)", "tan(x)" } },
+	{ "sinh",	sinh,	{ "(e^x-e^-x)/2", "cosh(x)", "asinh(x)" } },
+	{ "cosh",	cosh,	{ "(e^x+e^-x)/2", "sinh(x)", "s*acosh(x)" } },
+	{ "tanh",	tanh,	{ "(e^x-e^-x)/(e^x+e^-x)", "1-tanh(x)^2", "atanh(x)" } },
+	{ "asinh",	asinh,	{ "log(x+(x^2+1)^.5)", "1/(x^2+1)^.5", "sinh(x)" } },
+	{ "acosh",	acosh,	{ "log(x+(x^2-1)^.5)", "1/(x^2-1)^.5", "cosh(x)" } },
+	{ "atanh",	atanh,	{ "log((1+x)/(1-x))/2", "1/(1-x^2)", "tanh(x)" } }
+};
+
+/*
+ * Pairs of functions where outer(inner(u)) = u for all u.
+ * inner(outer(u)) = u only for the principal values of "u",
+ * so that is only done by "simplify symbolic".
+ */
+static const struct {
+	int	outer, inner;
+} inverse_pairs[] = {
+	{ F_SIN, F_ASIN },
+	{ F_COS, F_ACOS },
+	{ F_TAN, F_ATAN },
+	{ F_SINH, F_ASINH },
+	{ F_COSH, F_ACOSH },
+	{ F_TANH, F_ATANH }
+};
+
+static struct {			/* the parsed templates of each built-in function, or NULL if not parsed yet */
+	token_type	*tokens;
+	int		n;
+} templates[ARR_CNT(builtins)][N_TEMPLATES];
+
+#define	MAX_USER_FUNCS	100	/* maximum number of user-defined functions */
+#define	MEMO_SIZE	256	/* number of remembered results for each user-defined function, a power of 2 */
+
+typedef struct {		/* one remembered result of a user-defined function */
+	int	valid;		/* true if this entry is in use */
+	double	args[MAX_FUNC_ARGS];	/* argument values */
+	double	result;		/* function value */
+} memo_type;
+
+/*
+ * User-defined functions, entered like "f(x, y) = x^2 + y", with function numbers from FIRST_USER_FUNC.
+ * The body is parsed once and stored with the parameters as PARAM_VAR(0), PARAM_VAR(1), etc.
+ * Calls are kept as calls, like the built-in functions, and only replaced with the body
+ * by the commands that need to look into it, like derivative, solve, and integrate.
+ * The numerical value of a call is calculated with the compiled body,
+ * and remembered in "memo", so the same call is only calculated once.
+ * If the body has variables other than the parameters, calls are expanded when parsed instead,
+ * so those variables can be seen.
+ */
+static struct {
+	char		name[MAX_VAR_LEN+1];	/* function name */
+	char		params[MAX_FUNC_ARGS][MAX_VAR_LEN+1];	/* parameter names, for listing the definition */
+	int		nargs;			/* number of parameters */
+	int		native;			/* true if calls are expanded when parsed */
+	token_type	*body;			/* parsed function body */
+	int		body_len;		/* length of body in tokens */
+	code_type	*code;			/* compiled body, body_len long, or NULL if not compiled yet */
+	double		*stack;			/* evaluation stack for the compiled body, body_len long */
+	int		ncode;			/* number of instructions in code, -1 if the body can't be compiled */
+	memo_type	*memo;			/* remembered results, MEMO_SIZE long, or NULL */
+} user_funcs[MAX_USER_FUNCS];
+static int	n_user_funcs;		/* number of user-defined functions */
+
+enum expand_list {	/* which function calls expand_matching() expands, besides a function number */
+	EXPAND_ALL = -1,	/* all calls */
+	EXPAND_USER = -2,	/* calls of user-defined functions */
+	EXPAND_JAVA = -3	/* calls of the functions that the Java code can't call */
+};
+
+static token_type	*func_buf;	/* work space for building replacements, n_tokens long */
+
+/*
+ * Return the function number of the built-in or user-defined function named by the "len" characters at "cp",
+ * or -1 if there is none.
+ */
+int
+lookup_function(cp, len)
+char	*cp;
+int	len;
+{
+	int	fn;
+
+	if (len == 2 && strncmp(cp, "ln", 2) == 0)
+		return F_LOG;
+	for (fn = 0; fn < ARR_CNT(builtins); fn++) {
+		if (strncmp(cp, builtins[fn].name, len) == 0 && builtins[fn].name[len] == '\0')
+			return fn;
+	}
+	for (fn = 0; fn < n_user_funcs; fn++) {
+		if (strncmp(cp, user_funcs[fn].name, len) == 0 && user_funcs[fn].name[len] == '\0')
+			return FIRST_USER_FUNC + fn;
+	}
+	return -1;
+}
+
+/*
+ * Return the name of the function called by function call operator "op".
+ */
+char *
+func_name(op)
+int	op;
+{
+	int	fn;
+
+	fn = FUNC_NUMBER(op);
+	if (fn >= FIRST_USER_FUNC && fn < FIRST_USER_FUNC + n_user_funcs)
+		return user_funcs[fn - FIRST_USER_FUNC].name;
+	if (fn < 0 || fn >= ARR_CNT(builtins))
+		return _("(unknown function)");
+	return builtins[fn].name;
+}
+
+/*
+ * Return true if calls of function "fn" are always replaced with its expansion when parsed.
+ */
+int
+func_native(fn)
+int	fn;
+{
+	if (fn >= FIRST_USER_FUNC)
+		return user_funcs[fn - FIRST_USER_FUNC].native;
+	return(builtins[fn].func == NULL);
+}
+
+/*
+ * Return the number of arguments of function "fn".
+ */
+int
+func_nargs(fn)
+int	fn;
+{
+	if (fn >= FIRST_USER_FUNC)
+		return user_funcs[fn - FIRST_USER_FUNC].nargs;
+	return 1;
+}
+
+/*
+ * Return template "which" of built-in function "fn", parsing it if this is its first use,
+ * with its length in "*np".
+ * Return NULL if there is none.
+ */
+static token_type *
+get_template(fn, which, np)
+int	fn, which;
+int	*np;
+{
+	static char	*params[] = { "x", "n", "s" };	/* PARAM_VAR(0), PARAM_VAR(1), and PARAM_VAR(2) */
+	static int	param_len[] = { 1, 1, 1 };
+
+	if (fn < 0 || fn >= ARR_CNT(builtins))
+		return NULL;
+	if (templates[fn][which].tokens == NULL) {
+		if (builtins[fn].templates[which] == NULL)
+			return NULL;
+		templates[fn][which].tokens = parse_template(builtins[fn].templates[which], params, param_len,
+		    ARR_CNT(params), &templates[fn][which].n);
+		if (templates[fn][which].tokens == NULL)
+			return NULL;
+	}
+	*np = templates[fn][which].n;
+	return templates[fn][which].tokens;
+}
+
+/*
+ * Return the parsed expansion of function "fn", with its length in "*np",
+ * or NULL if it has none.  The expansion of a user-defined function is its body.
+ */
+token_type *
+func_expansion(fn, np)
+int	fn;
+int	*np;
+{
+	if (fn >= FIRST_USER_FUNC) {
+		*np = user_funcs[fn - FIRST_USER_FUNC].body_len;
+		return user_funcs[fn - FIRST_USER_FUNC].body;
+	}
+	return get_template(fn, T_EXPANSION, np);
+}
+
+/*
+ * Return the parsed derivative of the function called by function call operator "op",
+ * with its length in "*np", or NULL if it has none.
+ */
+token_type *
+func_derivative(op, np)
+int	op;
+int	*np;
+{
+	return get_template(FUNC_NUMBER(op), T_DERIVATIVE, np);
+}
+
+/*
+ * Return the parsed inverse of the function called by function call operator "op",
+ * with its length in "*np", or NULL if it has none.
+ */
+token_type *
+func_inverse(op, np)
+int	op;
+int	*np;
+{
+	return get_template(FUNC_NUMBER(op), T_INVERSE, np);
+}
+
+/*
+ * Free the compiled body and evaluation stack of user-defined function "uf".
+ */
+static void
+free_user_code(uf)
+int	uf;
+{
+	mem_free(user_funcs[uf].code, user_funcs[uf].body_len * sizeof(code_type), MEM_FUNCTIONS);
+	mem_free(user_funcs[uf].stack, user_funcs[uf].body_len * sizeof(double), MEM_FUNCTIONS);
+	user_funcs[uf].code = NULL;
+	user_funcs[uf].stack = NULL;
+	user_funcs[uf].ncode = 0;
+}
+
+/*
+ * Forget all user-defined functions, and free the parsed built-in function templates.
+ */
+void
+clear_functions(void)
+{
+	int	i, j;
+
+	for (i = 0; i < n_user_funcs; i++) {
+		free_user_code(i);
+		mem_free(user_funcs[i].body, user_funcs[i].body_len * sizeof(token_type), MEM_FUNCTIONS);
+		mem_free(user_funcs[i].memo, MEMO_SIZE * sizeof(memo_type), MEM_FUNCTIONS);
+		user_funcs[i].body = NULL;
+		user_funcs[i].memo = NULL;
+	}
+	n_user_funcs = 0;
+	for (i = 0; i < ARR_CNT(builtins); i++) {
+		for (j = 0; j < N_TEMPLATES; j++) {
+			mem_free(templates[i][j].tokens, templates[i][j].n * sizeof(token_type), MEM_FUNCTIONS);
+			templates[i][j].tokens = NULL;
+		}
+	}
+}
+
+/*
+ * Copy the "n" tokens of template or function body "tp" to "dest", which has room for "room" tokens,
+ * adding "level" to each level of parentheses, and substituting argument "k" for each PARAM_VAR(k).
+ * Argument "k" is the expression at &args[arg_start[k]], "arg_len[k]" tokens long, at any level.
+ *
+ * Return the length of the result.
+ */
+int
+subst_template(dest, room, tp, n, args, arg_start, arg_len, level)
+token_type	*dest;
+int		room;
+token_type	*tp;
+int		n;
+token_type	*args;
+int		*arg_start;
+int		*arg_len;
+int		level;
+{
+	int	i, j, k, len, extra;
+
+	for (i = 0, len = 0; i < n; i++) {
+		if (tp[i].kind == VARIABLE && (tp[i].token.variable & VAR_MASK) == MATCH_ANY) {
+			len += arg_len[(tp[i].token.variable >> VAR_SHIFT) - 1];
+		} else {
+			len++;
+		}
+	}
+	if (len > room) {
+		error_huge();
+	}
+	for (i = 0, len = 0; i < n; i++) {
+		if (tp[i].kind == VARIABLE && (tp[i].token.variable & VAR_MASK) == MATCH_ANY) {
+			k = (tp[i].token.variable >> VAR_SHIFT) - 1;
+/* an argument that is a single operand goes at the level of the parameter, otherwise it is parenthesized */
+			extra = tp[i].level + level - min_level(&args[arg_start[k]], arg_len[k]) + ((arg_len[k] == 1) ? 0 : 1);
+			for (j = arg_start[k]; j < arg_start[k] + arg_len[k]; j++) {
+				dest[len] = args[j];
+				dest[len].level += extra;
+				len++;
+			}
+		} else {
+			dest[len] = tp[i];
+			dest[len].level += level;
+			len++;
+		}
+	}
+	return len;
+}
+
+/*
+ * Return true if a function call starts at p1[i].
+ */
+int
+is_call(p1, n, i)
+token_type	*p1;	/* expression pointer */
+int		n;	/* expression length */
+int		i;	/* location of an operand */
+{
+	return((i + 1) < n && p1[i].kind == CONSTANT
+	    && p1[i+1].level == p1[i].level && IS_FUNC_OP(p1[i+1].token.operatr)
+	    && (i == 0 || p1[i-1].level < p1[i].level));
+}
+
+/*
+ * Return the location just past the end of the function call that starts at p1[i].
+ */
+int
+call_end(p1, n, i)
+token_type	*p1;
+int		n;
+int		i;
+{
+	int	level;
+
+	level = p1[i].level;
+	for (i++; i < n && p1[i].level >= level; i += 2)
+		;
+	return i;
+}
+
+/*
+ * Find the arguments of the function call that starts at p1[i].
+ * The location of each argument is stored in "arg_start" and its length in "arg_len",
+ * which must have room for MAX_FUNC_ARGS entries; arguments past that are not stored.
+ *
+ * Return the number of arguments.
+ */
+int
+call_args(p1, n, i, arg_start, arg_len)
+token_type	*p1;
+int		n;
+int		i;
+int		*arg_start, *arg_len;
+{
+	int	j, k, end, level;
+	int	nargs = 0;
+
+	level = p1[i].level;
+	end = call_end(p1, n, i);
+	for (j = i + 1; j < end; j = k) {
+		for (k = j + 2; k < end && p1[k].level > level; k += 2)
+			;
+		if (nargs < MAX_FUNC_ARGS) {
+			arg_start[nargs] = j + 1;
+			arg_len[nargs] = k - (j + 1);
+		}
+		nargs++;
+	}
+	return nargs;
+}
+
+/*
+ * Check that the function calls in expression "p1" of length "n" are valid,
+ * for expressions that come from outside, like snapshot files and library callers.
+ * Every function call operator must call a function that is kept as a call,
+ * and start a group of tokens laid out as described in "am.h".
+ *
+ * Return true if valid.
+ */
+int
+check_calls(p1, n)
+token_type	*p1;
+int		n;
+{
+	int	i, j, op, fn, level;
+	int	arg_start[MAX_FUNC_ARGS], arg_len[MAX_FUNC_ARGS];
+
+	for (i = 1; i < n; i += 2) {
+		if (p1[i].kind != OPERATOR || !IS_FUNC_OP(p1[i].token.operatr))
+			continue;
+		op = p1[i].token.operatr;
+		fn = FUNC_NUMBER(op);
+		if (fn >= FIRST_USER_FUNC) {
+			if (fn >= FIRST_USER_FUNC + n_user_funcs || func_native(fn))
+				return false;
+		} else if (fn < 0 || fn >= ARR_CNT(builtins) || func_native(fn)) {
+			return false;
+		}
+		level = p1[i].level;
+		for (j = i - 1; j > 0 && p1[j-1].level >= level; j--)
+			;
+		if (p1[j].level != level || !is_call(p1, n, j) || p1[j+1].token.operatr != op || p1[j].token.constant != 1.0)
+			return false;
+		if (call_args(p1, n, j, arg_start, arg_len) != func_nargs(fn))
+			return false;
+	}
+	return true;
+}
+
+/*
+ * Return the user-defined function memo table entry for the argument values in "args".
+ */
+static memo_type *
+memo_entry(memo, args, nargs)
+memo_type	*memo;
+double		*args;
+int		nargs;
+{
+	unsigned long	hash = 0;
+	unsigned char	*cp;
+	int		i;
+
+	for (cp = (unsigned char *) args, i = 0; i < nargs * sizeof(double); i++) {
+		hash = hash * 31 + cp[i];
+	}
+	return &memo[hash & (MEMO_SIZE - 1)];
+}
+
+/*
+ * Compile the body of user-defined function "uf", if not already compiled.
+ *
+ * Return true if it is compiled.
+ */
+static int
+compile_user(uf)
+int	uf;
+{
+	long	vars[MAX_FUNC_ARGS];
+	int	k, n;
+
+	if (user_funcs[uf].ncode > 0)
+		return true;
+	if (user_funcs[uf].ncode < 0)
+		return false;
+	n = user_funcs[uf].body_len;
+	user_funcs[uf].code = (code_type *) mem_alloc(n * sizeof(code_type), MEM_FUNCTIONS);
+	user_funcs[uf].stack = (double *) mem_alloc(n * sizeof(double), MEM_FUNCTIONS);
+	if (user_funcs[uf].code == NULL || user_funcs[uf].stack == NULL) {
+		free_user_code(uf);
+		return false;
+	}
+	for (k = 0; k < user_funcs[uf].nargs; k++) {
+		vars[k] = PARAM_VAR(k);
+	}
+	user_funcs[uf].ncode = compile_numeric(user_funcs[uf].body, n, vars, user_funcs[uf].nargs, user_funcs[uf].code);
+	if (user_funcs[uf].ncode <= 0) {
+		free_user_code(uf);
+		user_funcs[uf].ncode = -1;	/* don't try again */
+		return false;
+	}
+	return true;
+}
+
+/*
+ * Calculate user-defined function "uf" with the "nargs" real number arguments in "args".
+ * Finite results are remembered, so the same call is only calculated once.
+ * A function can't call itself, even through other functions,
+ * so its compiled body and stack are never in use when this is called.
+ *
+ * Return true with the result in "*dp" if the result is a finite real number.
+ */
+static int
+user_value(uf, args, nargs, dp)
+int	uf;
+double	*args;
+int	nargs;
+double	*dp;
+{
+	memo_type	*mp = NULL;
+	int		rv, save_approximate_roots;
+	double		d;
+
+	if (uf >= n_user_funcs || nargs != user_funcs[uf].nargs)
+		return false;
+	if (user_funcs[uf].memo == NULL) {
+		user_funcs[uf].memo = (memo_type *) mem_calloc(MEMO_SIZE, sizeof(memo_type), MEM_FUNCTIONS);
+	}
+	if (user_funcs[uf].memo) {
+		mp = memo_entry(user_funcs[uf].memo, args, nargs);
+		if (mp->valid && memcmp(mp->args, args, nargs * sizeof(double)) == 0) {
+			*dp = mp->result;
+			return true;
+		}
+	}
+	if (!compile_user(uf))
+		return false;
+	save_approximate_roots = approximate_roots;
+	approximate_roots = true;	/* the value is wanted here, not an exact root */
+	rv = eval_numeric(user_funcs[uf].code, user_funcs[uf].ncode, args, user_funcs[uf].stack, &d);
+	approximate_roots = save_approximate_roots;
+	if (!rv || !isfinite(d))
+		return false;
+	if (mp) {
+		mp->valid = true;
+		blt(mp->args, args, nargs * sizeof(double));
+		mp->result = d;
+	}
+	*dp = d;
+	return true;
+}
+
+/*
+ * Calculate the function called by function call operator "op"
+ * with the "nargs" real number arguments in "args".
+ *
+ * Return true with the result in "*dp" if the result is a finite real number.
+ */
+int
+func_value(op, args, nargs, dp)
+int	op;
+double	*args;
+int	nargs;
+double	*dp;
+{
+	int	fn;
+	double	d;
+
+	fn = FUNC_NUMBER(op);
+	if (fn >= FIRST_USER_FUNC)
+		return user_value(fn - FIRST_USER_FUNC, args, nargs, dp);
+	if (fn < 0 || fn >= ARR_CNT(builtins) || builtins[fn].func == NULL || nargs != 1)
+		return false;
+	errno = 0;
+	d = (*builtins[fn].func)(args[0]);
+	if (errno || !isfinite(d)) {
+		errno = 0;
+		return false;
+	}
+	*dp = d;
+	return true;
+}
+
+/*
+ * Replace equation[start] to equation[end-1] with the "n" tokens at "src".
+ */
+static void
+replace_tokens(equation, np, start, end, src, n)
+token_type	*equation;
+int		*np;
+int		start, end;
+token_type	*src;
+int		n;
+{
+	if (*np - (end - start) + n > n_tokens) {
+		error_huge();
+	}
+	blt(&equation[start+n], &equation[end], (*np - end) * sizeof(token_type));
+	blt(&equation[start], src, n * sizeof(token_type));
+	*np += n - (end - start);
+}
+
+/*
+ * Copy expression "p1" of length "n" to "dest", as an operand of the operators at level "level".
+ *
+ * Return "n".
+ */
+static int
+copy_operand(dest, p1, n, level)
+token_type	*dest;
+token_type	*p1;
+int		n;
+int		level;
+{
+	int	i, extra;
+
+	if (n == 1) {
+		extra = max(level, 1) - p1[0].level;
+	} else {
+		extra = level + 1 - min_level(p1, n);
+	}
+	for (i = 0; i < n; i++) {
+		dest[i] = p1[i];
+		dest[i].level += extra;
+	}
+	return n;
+}
+
+/*
+ * Allocate func_buf[], if not already allocated.
+ */
+static void
+need_func_buf(void)
+{
+	if (func_buf == NULL) {
+		func_buf = (token_type *) mem_alloc(n_tokens * sizeof(token_type), MEM_FUNCTIONS);
+		if (func_buf == NULL) {
+			error(_("Out of memory (can't malloc(3))."));
+			longjmp(jmp_save, 2);
+		}
+	}
+}
+
+/*
+ * Replace the function call at equation[i] with its expansion, if it has one.
+ *
+ * Return true if expanded.
+ */
+int
+expand_call(equation, np, i)
+token_type	*equation;
+int		*np;
+int		i;
+{
+	token_type	*tp;
+	int		n, len, fn;
+	int		arg_start[MAX_FUNC_ARGS], arg_len[MAX_FUNC_ARGS];
+
+	fn = FUNC_NUMBER(equation[i+1].token.operatr);
+	if ((tp = func_expansion(fn, &n)) == NULL)
+		return false;
+	if (call_args(equation, *np, i, arg_start, arg_len) != func_nargs(fn))
+		return false;
+	need_func_buf();
+	len = subst_template(func_buf, n_tokens, tp, n, equation, arg_start, arg_len, equation[i].level - 1);
+	replace_tokens(equation, np, i, call_end(equation, *np, i), func_buf, len);
+	return true;
+}
+
+/*
+ * Return true if calls of function "fn" are expanded by expand_matching() for "which",
+ * which is a function number or one of the expand_list values.
+ */
+static int
+expand_wanted(fn, which)
+int	fn, which;
+{
+	switch (which) {
+	case EXPAND_ALL:
+		return true;
+	case EXPAND_USER:
+		return(fn >= FIRST_USER_FUNC);
+	case EXPAND_JAVA:
+/* the generated code has no user-defined functions, and the Java Math class has no inverse hyperbolic functions */
+		return(fn >= FIRST_USER_FUNC || fn == F_ASINH || fn == F_ACOSH || fn == F_ATANH);
+	}
+	return(fn == which);
+}
+
+/*
+ * Replace the function calls containing variable "v" in an equation side with their expansions,
+ * for the functions selected by "which" (see expand_wanted()) that have an expansion.
+ * All calls are tested if "v" is 0.
+ *
+ * Return true if anything was expanded.
+ */
+static int
+expand_matching(equation, np, v, which)
+token_type	*equation;
+int		*np;
+long		v;
+int		which;
+{
+	int	i;
+	int	modified = false;
+
+	for (i = 0; i < *np;) {
+		if (is_call(equation, *np, i)
+		    && expand_wanted(FUNC_NUMBER(equation[i+1].token.operatr), which)
+		    && (v == 0 || found_var(&equation[i], call_end(equation, *np, i) - i, v))
+		    && expand_call(equation, np, i)) {
+			modified = true;
+			continue;	/* the expansion might contain other calls */
+		}
+		i += 2;
+	}
+	if (modified) {
+		organize(equation, np);
+	}
+	return modified;
+}
+
+/*
+ * Replace the function calls containing variable "v" in an equation side with their expansions,
+ * if they have one.  All calls are expanded if "v" is 0.
+ *
+ * Return true if anything was expanded.
+ */
+int
+expand_calls(equation, np, v)
+token_type	*equation;
+int		*np;
+long		v;
+{
+	return expand_matching(equation, np, v, EXPAND_ALL);
+}
+
+/*
+ * Replace the user-defined function calls containing variable "v" in an equation side with the function bodies,
+ * for the commands that need to look into them.  All user-defined function calls are expanded if "v" is 0.
+ *
+ * Return true if anything was expanded.
+ */
+int
+expand_user_calls(equation, np, v)
+token_type	*equation;
+int		*np;
+long		v;
+{
+	return expand_matching(equation, np, v, EXPAND_USER);
+}
+
+/*
+ * Replace the calls of the functions that the code command can't output in "language"
+ * with their expansions.
+ *
+ * Return true if anything was expanded.
+ */
+int
+expand_code_calls(equation, np, language)
+token_type		*equation;
+int			*np;
+enum language_list	language;
+{
+	return expand_matching(equation, np, 0L, (language == JAVA) ? EXPAND_JAVA : EXPAND_USER);
+}
+
+/*
+ * Return true if function body "tp" of length "n" has variables other than its parameters,
+ * not counting constants like e and pi.
+ */
+static int
+has_free_vars(tp, n)
+token_type	*tp;
+int		n;
+{
+	int	i;
+	long	v;
+
+	for (i = 0; i < n; i += 2) {
+		if (tp[i].kind == VARIABLE) {
+			v = tp[i].token.variable;
+			if ((v & VAR_MASK) != MATCH_ANY && v != V_E && v != V_PI && v != IMAGINARY)
+				return true;
+		}
+	}
+	return false;
+}
+
+/*
+ * Define or redefine the user-defined function named by the "name_len" characters at "name",
+ * with the "nargs" parameter names in "params" and body "tp" of length "n",
+ * parsed with the parameters as PARAM_VAR(0) to PARAM_VAR(nargs-1).
+ * When redefining, the calls of the old definition, in the equation spaces and the other function bodies,
+ * are replaced with its body first, so they keep their meaning.
+ *
+ * Return the function number, or -1 on error.
+ */
+int
+define_user_function(name, name_len, params, param_len, nargs, tp, n)
+char		*name;
+int		name_len;
+char		**params;
+int		*param_len;
+int		nargs;
+token_type	*tp;
+int		n;
+{
+	int		uf, i, k, len;
+	token_type	*tokens, *buf;
+
+	for (uf = 0; uf < n_user_funcs; uf++) {
+		if (strncmp(name, user_funcs[uf].name, name_len) == 0 && user_funcs[uf].name[name_len] == '\0')
+			break;
+	}
+	if (uf >= MAX_USER_FUNCS) {
+		error(_("Too many functions defined."));
+		return -1;
+	}
+	if (uf < n_user_funcs && !user_funcs[uf].native) {
+		for (i = 0; i < n_equations; i++) {
+			if (n_lhs[i] > 0) {
+				expand_matching(lhs[i], &n_lhs[i], 0L, FIRST_USER_FUNC + uf);
+				expand_matching(rhs[i], &n_rhs[i], 0L, FIRST_USER_FUNC + uf);
+			}
+		}
+		if ((buf = (token_type *) mem_alloc(n_tokens * sizeof(token_type), MEM_TEMP)) == NULL) {
+			error(_("Out of memory (can't malloc(3))."));
+			return -1;
+		}
+		for (k = 0; k < n_user_funcs; k++) {
+			if (k == uf)
+				continue;
+			len = user_funcs[k].body_len;
+			blt(buf, user_funcs[k].body, len * sizeof(token_type));
+			if (!expand_matching(buf, &len, 0L, FIRST_USER_FUNC + uf))
+				continue;
+			if ((tokens = (token_type *) mem_alloc(len * sizeof(token_type), MEM_FUNCTIONS)) == NULL) {
+				error(_("Out of memory (can't malloc(3))."));
+				mem_free(buf, n_tokens * sizeof(token_type), MEM_TEMP);
+				return -1;
+			}
+			blt(tokens, buf, len * sizeof(token_type));
+			free_user_code(k);
+			mem_free(user_funcs[k].body, user_funcs[k].body_len * sizeof(token_type), MEM_FUNCTIONS);
+			user_funcs[k].body = tokens;
+			user_funcs[k].body_len = len;
+		}
+		mem_free(buf, n_tokens * sizeof(token_type), MEM_TEMP);
+	}
+	if ((tokens = (token_type *) mem_alloc(n * sizeof(token_type), MEM_FUNCTIONS)) == NULL) {
+		error(_("Out of memory (can't malloc(3))."));
+		return -1;
+	}
+	blt(tokens, tp, n * sizeof(token_type));
+	if (uf >= n_user_funcs) {
+		blt(user_funcs[uf].name, name, name_len);
+		user_funcs[uf].name[name_len] = '\0';
+		user_funcs[uf].body = NULL;
+		user_funcs[uf].body_len = 0;
+		user_funcs[uf].code = NULL;
+		user_funcs[uf].stack = NULL;
+		user_funcs[uf].memo = NULL;
+		n_user_funcs++;
+	}
+	free_user_code(uf);
+	mem_free(user_funcs[uf].body, user_funcs[uf].body_len * sizeof(token_type), MEM_FUNCTIONS);
+	user_funcs[uf].body = tokens;
+	user_funcs[uf].body_len = n;
+	user_funcs[uf].nargs = nargs;
+	user_funcs[uf].native = has_free_vars(tp, n);
+	for (k = 0; k < nargs; k++) {
+		blt(user_funcs[uf].params[k], params[k], param_len[k]);
+		user_funcs[uf].params[k][param_len[k]] = '\0';
+	}
+	if (user_funcs[uf].memo)
+		memset(user_funcs[uf].memo, 0, MEMO_SIZE * sizeof(memo_type));
+	return FIRST_USER_FUNC + uf;
+}
+
+/*
+ * Return true if all of the user-defined functions called in the body of user-defined function "uf"
+ * are marked in "done".
+ */
+static int
+callees_done(uf, done)
+int	uf;
+char	*done;
+{
+	int	i, fn;
+
+	for (i = 1; i < user_funcs[uf].body_len; i += 2) {
+		if (IS_FUNC_OP(user_funcs[uf].body[i].token.operatr)) {
+			fn = FUNC_NUMBER(user_funcs[uf].body[i].token.operatr);
+			if (fn >= FIRST_USER_FUNC && !done[fn - FIRST_USER_FUNC])
+				return false;
+		}
+	}
+	return true;
+}
+
+/*
+ * Display the definitions of all user-defined functions, like "f(x, y) = x^2 + y",
+ * each one after the functions it calls, so they can be read back in.
+ * The save and edit commands list these before the equation spaces.
+ *
+ * Return true if successful.
+ */
+int
+list_functions(void)
+{
+	char	done[MAX_USER_FUNCS];
+	int	uf, i, k, n;
+	int	progress;
+
+	memset(done, 0, sizeof(done));
+	do {
+		progress = false;
+		for (uf = 0; uf < n_user_funcs; uf++) {
+			if (done[uf] || !callees_done(uf, done))
+				continue;
+/* list the body with variables named like the parameters */
+			need_func_buf();
+			n = user_funcs[uf].body_len;
+			blt(func_buf, user_funcs[uf].body, n * sizeof(token_type));
+			for (i = 0; i < n; i += 2) {
+				if (func_buf[i].kind == VARIABLE && (func_buf[i].token.variable & VAR_MASK) == MATCH_ANY) {
+					k = (func_buf[i].token.variable >> VAR_SHIFT) - 1;
+					if (parse_var(&func_buf[i].token.variable, user_funcs[uf].params[k]) == NULL)
+						return false;
+				}
+			}
+			fprintf(gfp, "%s(", user_funcs[uf].name);
+			for (k = 0; k < user_funcs[uf].nargs; k++) {
+				fprintf(gfp, "%s%s", (k ? ", " : ""), user_funcs[uf].params[k]);
+			}
+			fprintf(gfp, ") = ");
+			list_proc(func_buf, n, false);
+			fprintf(gfp, "\n");
+			done[uf] = true;
+			progress = true;
+		}
+	} while (progress);
+	return true;
+}
+
+/*
+ * Return true if the expression at p1[start] to p1[end-1] is a term of a sum or difference,
+ * that is, an operand of the plus and minus operators at level "level".
+ * The bounds of the whole sum are returned in "*sum_startp" and "*sum_endp".
+ */
+static int
+term_of_sum(p1, n, start, end, level, sum_startp, sum_endp)
+token_type	*p1;
+int		n;
+int		start, end;
+int		level;
+int		*sum_startp, *sum_endp;
+{
+	int	i, op;
+
+	if (level < 1)
+		return false;
+	if (start > 0 && p1[start-1].level == level) {
+		op = p1[start-1].token.operatr;
+	} else if (end < n && p1[end].level == level) {
+		op = p1[end].token.operatr;
+	} else {
+		return false;
+	}
+	if (op != PLUS && op != MINUS)
+		return false;
+	for (i = start; i > 0 && p1[i-1].level >= level; i--)
+		;
+	*sum_startp = i;
+	for (i = end; i < n && p1[i].level >= level; i++)
+		;
+	*sum_endp = i;
+	return true;
+}
+
+/*
+ * Replace the function call at equation[i] to equation[end-1] with the expression at "p1" of length "n",
+ * which may be within the call.
+ */
+static void
+replace_call(equation, np, i, end, p1, n)
+token_type	*equation;
+int		*np;
+int		i, end;
+token_type	*p1;
+int		n;
+{
+	need_func_buf();
+	copy_operand(func_buf, p1, n, equation[i].level - 1);
+	replace_tokens(equation, np, i, end, func_buf, n);
+}
+
+/*
+ * Replace equation[start] to equation[end-1] with the constant "d" at level "level".
+ */
+static void
+replace_constant(equation, np, start, end, level, d)
+token_type	*equation;
+int		*np;
+int		start, end;
+int		level;
+double		d;
+{
+	token_type	token;
+
+	token.level = max(level, 1);
+	token.kind = CONSTANT;
+	token.token.constant = d;
+	replace_tokens(equation, np, start, end, &token, 1);
+}
+
+/*
+ * Combine log(u) in a sum with another logarithm in the same sum:
+ * log(u) + log(v) becomes log(u*v) and log(u) - log(v) becomes log(u/v).
+ * The function call is at equation[i] to equation[end-1].
+ *
+ * Return true if the equation side was modified.
+ */
+static int
+log_sum_sub(equation, np, i, end)
+token_type	*equation;
+int		*np;
+int		i, end;
+{
+	int		level, op;
+	int		j, k, len;
+	int		sum_start, sum_end;
+	int		minus1, minus2;
+	int		pos, pos_end, neg, neg_end;
+
+	level = equation[i].level;
+	op = equation[i+1].token.operatr;
+	if (!term_of_sum(equation, *np, i, end, level - 1, &sum_start, &sum_end))
+		return false;
+	minus1 = (i > sum_start && equation[i-1].token.operatr == MINUS);
+	for (j = sum_start; j < sum_end; j = k + 1) {
+		for (k = j + 1; k < sum_end && equation[k].level >= level; k += 2)
+			;
+		if (j == i || !is_call(equation, *np, j) || equation[j].level != level
+		    || equation[j+1].token.operatr != op || call_end(equation, *np, j) != k)
+			continue;
+		minus2 = (j > sum_start && equation[j-1].token.operatr == MINUS);
+/* the combined call replaces the added term, or the first one if both are added or both subtracted */
+		if (minus1 == minus2 || minus2) {
+			pos = i;
+			pos_end = end;
+			neg = j;
+			neg_end = k;
+		} else {
+			pos = j;
+			pos_end = k;
+			neg = i;
+			neg_end = end;
+		}
+		need_func_buf();
+		if ((pos_end - pos) + (neg_end - neg) > n_tokens) {
+			error_huge();
+		}
+		len = 0;
+		func_buf[len++] = equation[pos];
+		func_buf[len++] = equation[pos+1];
+		len += copy_operand(&func_buf[len], &equation[pos+2], pos_end - (pos + 2), level + 1);
+		func_buf[len].level = level + 1;
+		func_buf[len].kind = OPERATOR;
+		func_buf[len].token.operatr = ((minus1 == minus2) ? TIMES : DIVIDE);
+		len++;
+		len += copy_operand(&func_buf[len], &equation[neg+2], neg_end - (neg + 2), level + 1);
+/* replace the later term first, so the location of the earlier one doesn't change */
+		if (neg > pos) {
+			replace_constant(equation, np, neg, neg_end, level - 1, 0.0);
+			replace_tokens(equation, np, pos, pos_end, func_buf, len);
+		} else {
+			replace_tokens(equation, np, pos, pos_end, func_buf, len);
+			replace_constant(equation, np, neg, neg_end, level - 1, 0.0);
+		}
+		return true;
+	}
+	return false;
+}
+
+/*
+ * Apply sin(u)^2 + cos(u)^2 = 1 and cosh(u)^2 - sinh(u)^2 = 1.
+ * The function call at equation[i] to equation[end-1] must be sin() or cosh(), squared,
+ * and be a term of a sum, or a factor of a term of a sum.
+ * The sum must have another term that is the same, except with cos() or sinh() instead.
+ * The squared call is replaced with 1 and the other term with 0.
+ *
+ * Return true if the equation side was modified.
+ */
+static int
+trig_square_sub(equation, np, i, end)
+token_type	*equation;
+int		*np;
+int		i, end;
+{
+	int	level, sum_level;
+	int	op, other_op;
+	int	j, k, fend;
+	int	term_start, term_end;
+	int	sum_start, sum_end;
+	int	minus1, minus2, diff_sign;
+	int	found = false;
+
+	level = equation[i].level - 1;	/* level of the power operator */
+	op = equation[i+1].token.operatr;
+	switch (FUNC_NUMBER(op)) {
+	case F_SIN:
+		other_op = FUNC_OP(F_COS);
+		break;
+	case F_COSH:
+		other_op = FUNC_OP(F_SINH);
+		break;
+	default:
+		return false;
+	}
+	if ((end + 1) >= *np || equation[end].level != level || equation[end].token.operatr != POWER
+	    || equation[end+1].level != level || equation[end+1].kind != CONSTANT || equation[end+1].token.constant != 2.0)
+		return false;
+	if (i > 0 && equation[i-1].level >= level)
+		return false;
+	fend = end + 2;
+	if (fend < *np && equation[fend].level >= level)
+		return false;
+	if (term_of_sum(equation, *np, i, fend, level - 1, &sum_start, &sum_end)) {
+		term_start = i;
+		term_end = fend;
+	} else {
+/* the squared call must be a factor of a term, and not a divisor */
+		if (i > 0 && equation[i-1].level == level - 1) {
+			if (equation[i-1].token.operatr != TIMES)
+				return false;
+		} else if (fend >= *np || equation[fend].level != level - 1
+		    || (equation[fend].token.operatr != TIMES && equation[fend].token.operatr != DIVIDE)) {
+			return false;
+		}
+		for (term_start = i; term_start > 0 && equation[term_start-1].level >= level - 1; term_start--)
+			;
+		for (term_end = fend; term_end < *np && equation[term_end].level >= level - 1; term_end++)
+			;
+		if (!term_of_sum(equation, *np, term_start, term_end, level - 2, &sum_start, &sum_end))
+			return false;
+	}
+	sum_level = (term_start > sum_start) ? equation[term_start-1].level : equation[term_end].level;
+	minus1 = (term_start > sum_start && equation[term_start-1].token.operatr == MINUS);
+/* compare the other terms with this one, with the other function */
+	equation[i+1].token.operatr = other_op;
+	for (j = sum_start; j < sum_end; j = k + 1) {
+		for (k = j + 1; k < sum_end && equation[k].level > sum_level; k += 2)
+			;
+		if (j != term_start && se_compare(&equation[term_start], term_end - term_start, &equation[j], k - j, &diff_sign)) {
+			minus2 = (j > sum_start && equation[j-1].token.operatr == MINUS) ^ diff_sign;
+			if ((FUNC_NUMBER(op) == F_SIN) ? (minus1 == minus2) : (minus1 != minus2)) {
+				found = true;
+				break;
+			}
+		}
+	}
+	equation[i+1].token.operatr = op;
+	if (!found)
+		return false;
+/* replace the later one first, so the location of the earlier one doesn't change */
+	if (j > term_start) {
+		replace_constant(equation, np, j, k, sum_level, 0.0);
+		replace_constant(equation, np, i, fend, level - 1, 1.0);
+	} else {
+		replace_constant(equation, np, i, fend, level - 1, 1.0);
+		replace_constant(equation, np, j, k, sum_level, 0.0);
+	}
+	return true;
+}
+
+/*
+ * Calculate the user-defined function call at equation[i] to equation[end-1], if its arguments are numerical.
+ * Like the roots in calc(), the value replaces the call only if it is a rational number or approximating;
+ * a call without a real number value is replaced with the function body, to be simplified symbolically.
+ *
+ * Return true if the equation side was modified.
+ */
+static int
+user_func_sub(equation, np, i, end)
+token_type	*equation;
+int		*np;
+int		i, end;
+{
+	int		k, nargs;
+	int		arg_start[MAX_FUNC_ARGS], arg_len[MAX_FUNC_ARGS];
+	double		args[MAX_FUNC_ARGS];
+	double		d, d1, d2;
+	complexs	c;
+
+	nargs = call_args(equation, *np, i, arg_start, arg_len);
+	if (nargs > MAX_FUNC_ARGS)
+		return false;
+	for (k = 0; k < nargs; k++) {
+		if (!exp_is_numeric(&equation[arg_start[k]], arg_len[k]) || !parse_complex(&equation[arg_start[k]], arg_len[k], &c))
+			return false;
+		if (c.im != 0.0)
+			return expand_call(equation, np, i);
+		args[k] = c.re;
+	}
+	if (!func_value(equation[i+1].token.operatr, args, nargs, &d))
+		return expand_call(equation, np, i);
+	if (preserve_surds && !approximate_roots && !f_to_fraction(d, &d1, &d2))
+		return false;
+	replace_constant(equation, np, i, end, equation[i].level - 1, d);
+	return true;
+}
+
+/*
+ * Simplify the function call at equation[i], if possible.
+ *
+ * Return true if the equation side was modified.
+ */
+static int
+func_sub(equation, np, i)
+token_type	*equation;
+int		*np;
+int		i;
+{
+	token_type	*p1;
+	token_type	tokens[5];
+	int		level, op, fn, inner;
+	int		j, k, n, end;
+	int		arg_start[MAX_FUNC_ARGS], arg_len[MAX_FUNC_ARGS];
+	double		d;
+	complexs	c;
+
+	level = equation[i].level;
+	op = equation[i+1].token.operatr;
+	fn = FUNC_NUMBER(op);
+	end = call_end(equation, *np, i);
+	if (fn >= FIRST_USER_FUNC)
+		return user_func_sub(equation, np, i, end);
+	if (fn >= ARR_CNT(builtins) || call_args(equation, *np, i, arg_start, arg_len) != 1)
+		return false;
+	p1 = &equation[arg_start[0]];
+	n = arg_len[0];
+/* Calculate calls with a numerical argument, using complex numbers if needed. */
+	if (exp_is_numeric(p1, n) && parse_complex(p1, n, &c)) {
+		if (c.im == 0.0 && func_value(op, &c.re, 1, &d)) {
+			replace_constant(equation, np, i, end, level - 1, d);
+			return true;
+		}
+		if (fn == F_LOG) {
+			if (c.re == 0.0 && c.im == 0.0)
+				return false;
+			c = complex_log(c);
+			for (j = 0; j < ARR_CNT(tokens); j++) {
+				tokens[j].level = level + (j >= 2);
+			}
+			tokens[0].kind = CONSTANT;
+			tokens[0].token.constant = c.re;
+			tokens[1].kind = OPERATOR;
+			tokens[1].token.operatr = PLUS;
+			tokens[2].kind = CONSTANT;
+			tokens[2].token.constant = c.im;
+			tokens[3].kind = OPERATOR;
+			tokens[3].token.operatr = TIMES;
+			tokens[4].kind = VARIABLE;
+			tokens[4].token.variable = IMAGINARY;
+			replace_tokens(equation, np, i, end, tokens, ARR_CNT(tokens));
+			return true;
+		}
+		return expand_call(equation, np, i);
+	}
+/* Apply the inverse function identities, like sin(asin(u)) = u. */
+	if (is_call(p1, n, 0) && call_end(p1, n, 0) == n && call_args(p1, n, 0, arg_start, arg_len) == 1) {
+		inner = FUNC_NUMBER(p1[1].token.operatr);
+		for (k = 0; k < ARR_CNT(inverse_pairs); k++) {
+			if ((inverse_pairs[k].outer == fn && inverse_pairs[k].inner == inner)
+			    || (symb_flag && inverse_pairs[k].outer == inner && inverse_pairs[k].inner == fn)) {
+				replace_call(equation, np, i, end, &p1[2], n - 2);
+				return true;
+			}
+		}
+	}
+	switch (fn) {
+	case F_LOG:
+	case F_LOG10:
+/* e^log(u) = u and 10^log10(u) = u */
+		if (i >= 2 && equation[i-1].level == level - 1 && equation[i-1].token.operatr == POWER
+		    && equation[i-2].level == level - 1 && (i == 2 || equation[i-3].level < level - 1)
+		    && (end >= *np || equation[end].level < level - 1)
+		    && ((fn == F_LOG) ? (equation[i-2].kind == VARIABLE && equation[i-2].token.variable == V_E)
+		    : (equation[i-2].kind == CONSTANT && equation[i-2].token.constant == 10.0))) {
+			need_func_buf();
+			copy_operand(func_buf, p1, n, level - 2);
+			replace_tokens(equation, np, i - 2, end, func_buf, n);
+			return true;
+		}
+/* log(e^u) = u and log10(10^u) = u, only for the principal values of "u" */
+		if (symb_flag && n >= 3 && p1[1].level == min_level(p1, n) && p1[1].token.operatr == POWER
+		    && p1[0].level == p1[1].level
+		    && ((fn == F_LOG) ? (p1[0].kind == VARIABLE && p1[0].token.variable == V_E)
+		    : (p1[0].kind == CONSTANT && p1[0].token.constant == 10.0))) {
+			for (j = 3; j < n && p1[j].level > p1[1].level; j += 2)
+				;
+			if (j >= n) {
+				replace_call(equation, np, i, end, &p1[2], n - 2);
+				return true;
+			}
+		}
+		return log_sum_sub(equation, np, i, end);
+	case F_SIN:
+	case F_COSH:
+		return trig_square_sub(equation, np, i, end);
+	}
+	return false;
+}
+
+/*
+ * Simplify the function calls in an equation side:
+ * calculate calls with numerical arguments and apply the function identities.
+ * Called from elim_loop(), so this is quick when there are no function calls.
+ *
+ * Return true if the equation side was modified, after which it needs organizing.
+ */
+int
+simp_functions(equation, np)
+token_type	*equation;
+int		*np;
+{
+	int	i;
+
+	for (i = 1; i < *np; i += 2) {
+		if (IS_FUNC_OP(equation[i].token.operatr) && is_call(equation, *np, i - 1)) {
+			if (count_rule(R_FUNC, func_sub(equation, np, i - 1)))
+				return true;
+		}
+	}
+	return false;
+}
@@ -162,13 +162,22 @@ int		security_level;		/* current enforced security level for session, -1 for m4
 int		repeat_flag;		/* true if the command is to repeat its function or simplification, set by repeat command */
 int		show_usage;		/* show command usage info if a command fails and this flag is true */
 int		point_flag;		/* point to location of parse error if true */
+int		command_stats_flag;	/* true to display per-command statistics when exiting, set by "set command_statistics" */
+FILE		*trace_fp;		/* "set trace" Chrome trace-event output file, or NULL if not tracing */
+counters_type	counters;		/* hot-path instrumentation counters, displayed by "version counters" */
+mem_stats_type	mem_stats;		/* real memory accounting of the symbolic math engine */
+int		command_peak_tokens;	/* largest expression size in tokens during the current command, see note_tokens() */
+int		pass_profile_flag;	/* true to profile the simpa_side() passes, set by "set pass_profile" */
+pass_stats_type	pass_stats[N_PASSES];	/* simpa_side() pass profile, displayed by "version passes" */
+char		pass_skip[N_PASSES];	/* true for the simpa_side() passes skipped by "set pass_schedule" */
 
 /* library variables go here */
 char		*result_str;		/* returned result text string when using as library */
 int		result_en = -1;		/* equation number of the returned result, if stored in an equation space */
+int		result_wanted = true;	/* false if the library caller will not use result_str, so it isn't made */
+int		result_reuse;		/* true to make result_str in a reused buffer, which must not be freed */
+volatile int	*cancel_flagp;		/* library caller's cancel flag; if it points to non-zero, abort current operation */
+int		(*progress_callback)(const char *where, long count, void *data);	/* library caller's progress function */
+void		*progress_data;		/* passed to progress_callback() */
 const char	*error_str;		/* last error string */
 const char	*warning_str;		/* last warning string */
-
-/* Screen character array, for buffering page-at-a-time 2D string output: */
-char		*vscreen[TEXT_ROWS];
-int		current_columns;
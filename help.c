@@ -96,7 +96,7 @@ static com_type com_list[] = {
 {	"replace",	NULL,			replace_cmd,		"[variables [\"with\" expression]]",			"Substitute variables in the current equation with expressions.", "This command may be preceded with \"repeat\"." },
 {	"roots",	NULL,			roots_cmd,		"root real-part imaginary-part",			"Display all the roots of a complex number.", "\"repeat roots\" repeatedly prompts for any input." },
 #if	!SECURE
-{	"save",		NULL,			save_cmd,		"file-name",						"Save all equation spaces in a text file.", "Related command: read" },
+{	"save",		NULL,			save_cmd,		"[\"binary\"] file-name",				"Save all equation spaces in a text file or binary snapshot.", "Related command: read" },
 #endif
 {	"set",		NULL,			set_cmd,		"[[\"no\"] option [value]] ...",			"Display, set, or \"save\" current session options.", "\"set\" by itself will show all current option settings." },
 {	"simplify",	NULL,			simplify_cmd,		"[\"sign\" \"symbolic\" \"quick[est]\" \"fraction\"] [equation-number-ranges]",	"Completely simplify expressions.", "This command may be preceded with \"repeat\" for full simplify." },
@@ -108,7 +108,7 @@ static com_type com_list[] = {
 {	"taylor",	NULL,			taylor_cmd,		"[\"nosimplify\"] variable order point",		"Compute the Taylor series expansion of the current expression." },
 {	"unfactor",	"expand",		unfactor_cmd,		"[\"count\" \"fraction\" \"quick\" \"power\"] [equation-number-range]",	"Algebraically expand (multiply out) expressions." },
 {	"variables",	NULL,			variables_cmd,		"[\"c\" \"java\" \"integer\" \"count\"] [equation-number-ranges]",	"Show all variable names used within the specified expressions.", "Related command: code" },
-{	"version",	NULL,			version_cmd,		"[\"status\"]",							"Display Mathomatic version, status, and compiler information." }
+{	"version",	NULL,			version_cmd,		"[\"status\" | \"counters\" [\"reset\"] | \"statistics\" [\"reset\"] | \"passes\" [\"reset\"]]",							"Display Mathomatic version, status, and compiler information." }
 };
 
 #if	HELP
@@ -258,6 +258,8 @@ char	*cp;
 
 	if (cp == NULL)
 		return false;
+	if ((rv = define_function(cp)) >= 0)
+		return rv;
 	if ((cp1 = strchr(cp, '=')) != NULL) {
 		if (strrchr(cp, '=') == cp1 && is_mathomatic_operator(cp[0]) && cp[0] != '='
 		    && is_mathomatic_operator(cp[1])) {
@@ -397,8 +399,11 @@ char	*cp;
 					}
 				}
 			}
+			for (cp1 = cp; *cp1 && !isvarchar(*cp1); cp1++)
+				;
 			if (!equals_flag && autoselect && n_lhs[n] == 1 && lhs[n][0].kind == CONSTANT && fmod(lhs[n][0].token.constant, 1.0) == 0.0
-			    && lhs[n][0].token.constant > 0.0 && lhs[n][0].token.constant <= n_equations) {
+			    && lhs[n][0].token.constant > 0.0 && lhs[n][0].token.constant <= n_equations
+			    && *cp1 == '\0') {	/* not if there are names, like in the function call "f(3)" */
 				/* easy selecting of equation spaces by just typing in the equation number */
 				cur_equation = lhs[n][0].token.constant - 1;
 				n_lhs[n] = 0;
@@ -477,12 +482,19 @@ int
 process(cp)
 char	*cp;
 {
+	if (cp && trace_fp) {
+		trace_event('B', "process", cp, -1);
+	}
 	if (cp && cp[0] == ':') {
 		input_column++;
 		previous_return_value = process_rv(cp + 1);
+		trace_end("process", -1);
+		sample_peak_tokens();
 		return true;
 	} else {
 		previous_return_value = process_rv(cp);
+		trace_end("process", -1);
+		sample_peak_tokens();
 		if (!previous_return_value) {
 			debug_string(1, "Error return.");
 		}
@@ -507,6 +519,7 @@ char	*cp;
 	int	rv;
 	char	buf2[MAX_CMD_LEN];	/* do not make this static! */
 	int	our_repeat_flag = false;
+	int	level;			/* command statistics nesting level */
 	long	v;			/* Mathomatic variable */
 #if	!SECURE
 	FILE	*fp;
@@ -701,7 +714,11 @@ do_repeat:
 			show_usage = true;
 			repeat_flag = our_repeat_flag;
 /* execute the command by calling the command function */
+			trace_begin(com_list[i].name, -1);
+			level = begin_command_stats(i);
 			rv = (*com_list[i].func)(buf2);
+			end_command_stats(level);
+			trace_end(com_list[i].name, -1);
 			repeat_flag = false;
 #if	!SECURE
 			if (fp && gfp != default_out) {
@@ -732,7 +749,208 @@ do_repeat:
 /* cp is not a command, so parse the expression */
 	i = next_espace();
 	input_column += (cp - cp_start);
-	return process_parse(i, cp);
+	level = begin_command_stats(ARR_CNT(com_list));
+	rv = process_parse(i, cp);
+	end_command_stats(level);
+	return rv;
+}
+
+#define	N_LATENCY_BUCKETS	22	/* latency histogram bucket i counts runs taking less than 10 * 2^i microseconds */
+#define	MAX_STATS_NESTING	20	/* maximum nesting of commands measured, like commands run by the read command */
+
+typedef struct {		/* running statistics for one command */
+	long	count;		/* number of times the command was run */
+	double	total_time;	/* total seconds taken */
+	double	max_time;	/* longest run in seconds */
+	long	histogram[N_LATENCY_BUCKETS];	/* number of runs in each latency bucket, the last is unbounded */
+	int	peak_tokens;	/* largest expression size in tokens during a run, n_tokens if one overflowed */
+	long	peak_memory;	/* most bytes of memory allocated at once during a run */
+	long	memory_growth;	/* largest increase of memory allocated during one run above what it started with */
+} command_stats_type;
+
+static command_stats_type	command_stats[ARR_CNT(com_list) + 1];	/* indexed like com_list[], the extra entry is for expression input */
+
+static struct {			/* the commands now being measured, outermost first */
+	int	index;		/* command_stats[] index */
+	double	start_time;	/* get_time() when the command started */
+	long	start_memory;	/* mem_stats.total_live when the command started */
+	long	outer_peak;	/* mem_stats.command_peak of the enclosing command when this one started */
+	int	outer_peak_tokens;	/* command_peak_tokens of the enclosing command when this one started */
+} running_stats[MAX_STATS_NESTING];
+static int	n_running_stats;
+
+/*
+ * Start measuring a run of the command with index "i" in com_list[],
+ * or ARR_CNT(com_list) for an expression.
+ *
+ * Return the nesting level to pass to end_command_stats().
+ */
+int
+begin_command_stats(i)
+int	i;
+{
+	int	level;
+
+	level = n_running_stats;
+	if (n_running_stats < MAX_STATS_NESTING) {
+		running_stats[n_running_stats].index = i;
+		running_stats[n_running_stats].start_memory = mem_stats.total_live;
+		running_stats[n_running_stats].outer_peak = mem_stats.command_peak;
+		mem_stats.command_peak = mem_stats.total_live;	/* measure the high-water mark of this command alone */
+		running_stats[n_running_stats].outer_peak_tokens = command_peak_tokens;
+		command_peak_tokens = 0;	/* measure the largest expression of this command alone */
+		running_stats[n_running_stats].start_time = get_time();
+		n_running_stats++;
+	}
+	return level;
+}
+
+/*
+ * Finish measuring all commands running at nesting "level" and deeper.
+ * Deeper ones were left by a longjmp(3) out of them, so they end now too.
+ * Called with a level of 0 by the top-level error traps.
+ */
+void
+end_command_stats(level)
+int	level;
+{
+	command_stats_type	*sp;
+	double			t, now;
+	int			j;
+
+	if (level < 0 || level >= n_running_stats)
+		return;
+	now = get_time();
+	while (n_running_stats > level) {
+		n_running_stats--;
+		sp = &command_stats[running_stats[n_running_stats].index];
+		t = now - running_stats[n_running_stats].start_time;
+		if (t < 0.0)
+			t = 0.0;
+		sp->count++;
+		sp->total_time += t;
+		if (t > sp->max_time)
+			sp->max_time = t;
+		for (j = 0; j < N_LATENCY_BUCKETS - 1 && t >= 10.0e-6 * (double) (1L << j); j++)
+			;
+		sp->histogram[j]++;
+		if (command_peak_tokens > sp->peak_tokens)
+			sp->peak_tokens = command_peak_tokens;
+		if (running_stats[n_running_stats].outer_peak_tokens > command_peak_tokens)	/* the enclosing command's peak includes this one */
+			command_peak_tokens = running_stats[n_running_stats].outer_peak_tokens;
+		if (mem_stats.command_peak > sp->peak_memory)
+			sp->peak_memory = mem_stats.command_peak;
+		if (mem_stats.command_peak - running_stats[n_running_stats].start_memory > sp->memory_growth)
+			sp->memory_growth = mem_stats.command_peak - running_stats[n_running_stats].start_memory;
+		if (running_stats[n_running_stats].outer_peak > mem_stats.command_peak)	/* the enclosing command's peak includes this one */
+			mem_stats.command_peak = running_stats[n_running_stats].outer_peak;
+	}
+}
+
+/*
+ * Return the name of command_stats[] entry "i".
+ */
+static char *
+command_stats_name(i)
+int	i;
+{
+	if (i < ARR_CNT(com_list))
+		return com_list[i].name;
+	return "(expression)";
+}
+
+/*
+ * Return the latency in seconds that "fraction" of the runs of command_stats[] entry "sp" are faster than,
+ * rounded up to the latency histogram bucket limit.
+ */
+static double
+percentile(sp, fraction)
+command_stats_type	*sp;
+double			fraction;
+{
+	long	sum = 0;
+	int	j;
+
+	for (j = 0; j < N_LATENCY_BUCKETS - 1; j++) {
+		sum += sp->histogram[j];
+		if (sum >= fraction * sp->count)
+			break;
+	}
+	return min(10.0e-6 * (double) (1L << j), sp->max_time);
+}
+
+/*
+ * Zero the per-command statistics.
+ */
+void
+reset_command_stats(void)
+{
+	memset(command_stats, 0, sizeof(command_stats));
+}
+
+/*
+ * Display the per-command latency statistics and memory high-water marks to "ofp".
+ */
+void
+command_stats_report(ofp)
+FILE	*ofp;
+{
+	command_stats_type	*sp;
+	int			i, any = false;
+
+	for (i = 0; i < ARR_CNT(command_stats); i++) {
+		sp = &command_stats[i];
+		if (sp->count == 0)
+			continue;
+		if (!any) {
+			fprintf(ofp, _("Command statistics, latencies in milliseconds:\n"));
+			fprintf(ofp, "%-14s %8s %9s %9s %9s %9s %9s %7s %10s %10s\n", _("command"), _("count"),
+			    _("mean"), _("p50"), _("p90"), _("p99"), _("max"), _("tokens"), _("peak mem"), _("growth"));
+			any = true;
+		}
+		fprintf(ofp, "%-14s %8ld %9.3f %9.3f %9.3f %9.3f %9.3f %7d %8ldkB %8ldkB\n", command_stats_name(i), sp->count,
+		    sp->total_time * 1000.0 / sp->count, percentile(sp, 0.5) * 1000.0, percentile(sp, 0.9) * 1000.0,
+		    percentile(sp, 0.99) * 1000.0, sp->max_time * 1000.0, sp->peak_tokens,
+		    (sp->peak_memory + 1023) / 1024, (sp->memory_growth + 1023) / 1024);
+	}
+	if (!any) {
+		fprintf(ofp, _("No command statistics yet.\n"));
+	}
+}
+
+/*
+ * Return the per-command statistics as a JSON object string,
+ * in a static buffer that is overwritten by the next call.
+ */
+char *
+command_stats_json(void)
+{
+	static char		buf[(ARR_CNT(com_list) + 1) * (N_LATENCY_BUCKETS * 12 + 320) + 64];
+	command_stats_type	*sp;
+	int			i, j, len, any = false;
+
+	len = snprintf(buf, sizeof(buf), "{\"bucket_limits_us\": [");
+	for (j = 0; j < N_LATENCY_BUCKETS - 1; j++) {
+		len += snprintf(&buf[len], sizeof(buf) - len, "%s%ld", (j ? ", " : ""), 10L << j);
+	}
+	len += snprintf(&buf[len], sizeof(buf) - len, "], \"commands\": {");
+	for (i = 0; i < ARR_CNT(command_stats); i++) {
+		sp = &command_stats[i];
+		if (sp->count == 0)
+			continue;
+		len += snprintf(&buf[len], sizeof(buf) - len, "%s\"%s\": {\"count\": %ld, \"total_seconds\": %.6f, "
+		    "\"p50_ms\": %.3f, \"p90_ms\": %.3f, \"p99_ms\": %.3f, \"max_ms\": %.3f, \"histogram\": [",
+		    (any ? ", " : ""), command_stats_name(i), sp->count, sp->total_time,
+		    percentile(sp, 0.5) * 1000.0, percentile(sp, 0.9) * 1000.0, percentile(sp, 0.99) * 1000.0, sp->max_time * 1000.0);
+		for (j = 0; j < N_LATENCY_BUCKETS; j++) {
+			len += snprintf(&buf[len], sizeof(buf) - len, "%s%ld", (j ? ", " : ""), sp->histogram[j]);
+		}
+		len += snprintf(&buf[len], sizeof(buf) - len, "], \"peak_tokens\": %d, \"peak_memory_bytes\": %ld, \"max_memory_growth_bytes\": %ld}",
+		    sp->peak_tokens, sp->peak_memory, sp->memory_growth);
+		any = true;
+	}
+	snprintf(&buf[len], sizeof(buf) - len, "}}");
+	return buf;
 }
 
 /*
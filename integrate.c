@@ -351,6 +351,12 @@ char	*cp;
 	factorv(source, nps, v);
 	blt(dest, source, *nps * sizeof(token_type));
 	n1 = *nps;
+	if (expand_user_calls(dest, &n1, v)) {
+		partial_flag = false;
+		uf_simp(dest, &n1);
+		partial_flag = true;
+		factorv(dest, &n1, v);
+	}
 	for (l1 = 0; l1 < integrate_order; l1++) {
 		if (!int_dispatch(dest, &n1, v, integrate_sub)) {
 			error(_("Integration failed, not a polynomial."));
@@ -645,6 +651,12 @@ char	*cp;
 	factorv(source, nps, v);
 	blt(dest, source, *nps * sizeof(token_type));
 	n1 = *nps;
+	if (expand_user_calls(dest, &n1, v)) {
+		partial_flag = false;
+		uf_simp(dest, &n1);
+		partial_flag = true;
+		factorv(dest, &n1, v);
+	}
 	if (inverse_flag) {
 		if (!poly_in_v(dest, n1, v, true) || !int_dispatch(dest, &n1, v, inv_laplace_sub)) {
 			error(_("Inverse Laplace transformation failed."));
@@ -834,6 +846,9 @@ char	*cp;
 	dest[0] = zero_token;
 	n1 = 1;
 	for (j = 0; j <= iterations; j++) {
+		if (aborted("nintegrate", j)) {
+			longjmp(jmp_save, 13);
+		}
 		if ((n1 + 1 + *nps) > n_tokens)
 			error_huge();
 		for (k = 0; k < n1; k++) {
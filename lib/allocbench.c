@@ -0,0 +1,102 @@
+/*
+ * Heap allocation counter for the Mathomatic symbolic math library.
+ * Runs a fixed group of commands through matho_process_buf() over and over,
+ * counting every malloc(3), calloc(3), and realloc(3) call made while doing so.
+ * After the first few warm-up groups, when all reused buffers are big enough,
+ * the number of allocations per call should be zero.
+ *
+ * Allocations are counted by replacing the C library's malloc(3) functions,
+ * which only works with the GNU C library.
+ *
+ * Usage: ./allocbench [ groups ]
+ */
+
+#include "../includes.h"
+#include "mathomatic.h"
+
+#if	!__GLIBC__
+#error "allocbench requires the GNU C library."
+#endif
+
+#define	WARMUP_GROUPS	10	/* number of groups of commands to run before counting */
+
+extern void	*__libc_malloc(size_t size);
+extern void	*__libc_calloc(size_t nmemb, size_t size);
+extern void	*__libc_realloc(void *ptr, size_t size);
+
+static long	alloc_count;	/* number of heap allocations so far */
+
+void *
+malloc(size_t size)
+{
+	alloc_count++;
+	return __libc_malloc(size);
+}
+
+void *
+calloc(size_t nmemb, size_t size)
+{
+	alloc_count++;
+	return __libc_calloc(nmemb, size);
+}
+
+void *
+realloc(void *ptr, size_t size)
+{
+	alloc_count++;
+	return __libc_realloc(ptr, size);
+}
+
+/*
+ * A typical group of commands, leaving the equation spaces empty and
+ * selecting the first one again, so the same spaces are reused.
+ * "clear all" is not used, because it also forgets all variable names,
+ * so the next group would have to allocate them again.
+ */
+static char	*commands[] = {
+	"(x+1)^3*(y-2)",
+	"unfactor",
+	"factor",
+	"derivative x",
+	"simplify",
+	"y=x^2+2*x+1",
+	"solve x",
+	"clear 1-4",
+	"#1",
+	NULL
+};
+
+int
+main(int argc, char **argv)
+{
+	char	buf[1000];
+	long	groups = 1000, g, count, calls = 0;
+	int	i;
+
+	if (argc > 1) {
+		groups = atol(argv[1]);
+	}
+	if (!matho_init()) {
+		fprintf(stderr, "Not enough memory.\n");
+		exit(1);
+	}
+	for (g = 0; g < WARMUP_GROUPS; g++) {
+		for (i = 0; commands[i]; i++) {
+			matho_process_buf(commands[i], buf, sizeof(buf));
+		}
+	}
+	count = alloc_count;
+	for (g = 0; g < groups; g++) {
+		for (i = 0; commands[i]; i++) {
+			if (!matho_process_buf(commands[i], buf, sizeof(buf))) {
+				printf("Command \"%s\" failed: %s\n", commands[i], buf);
+				exit(1);
+			}
+			calls++;
+		}
+	}
+	count = alloc_count - count;
+	printf("%ld calls after warm-up, %ld heap allocations, %.3f allocations per call.\n",
+	    calls, count, (double) count / calls);
+	exit(count != 0);
+}
@@ -0,0 +1,271 @@
+/*
+ * Test program for the typed, prepared expression, and asynchronous APIs
+ * of the Mathomatic symbolic math library.
+ * Every call is checked against known results, including the calls that should fail.
+ * Displays each failed check and exits with status 1 if there were any.
+ */
+
+#include "../includes.h"
+#include "mathomatic.h"
+#include <poll.h>
+
+static int	n_checks, n_failed;
+
+#define	CHECK(expr)	check((expr) != 0, #expr, __LINE__)
+
+static void
+check(int ok, const char *text, int line)
+{
+	n_checks++;
+	if (!ok) {
+		n_failed++;
+		printf("apitest.c:%d: check failed: %s\n", line, text);
+		if (error_str)
+			printf("  error_str: %s\n", error_str);
+	}
+}
+
+/*
+ * Return true if "d" is within a relative error of 1e-12 of the expected value "expected".
+ */
+static int
+close_to(double d, double expected)
+{
+	return fabs(d - expected) <= 1e-12 * (fabs(expected) > 1.0 ? fabs(expected) : 1.0);
+}
+
+/*
+ * Parse "input" into an equation space and prepare it.
+ * Returns the prepared expression, or NULL if either step failed.
+ */
+static matho_prepared *
+prepare(const char *input)
+{
+	char	*output = NULL;
+	int	rv;
+
+	rv = matho_parse((char *) input, &output);
+	CHECK(rv);
+	if (rv)
+		free(output);
+	else
+		return NULL;
+	return matho_prepare(result_en);
+}
+
+static void
+test_prepared(void)
+{
+	matho_prepared	*pp;
+	double		d, re, im;
+	int		x, y;
+
+	CHECK((pp = prepare("y = x^2 + 3*x")) != NULL);
+	if (pp == NULL)
+		return;
+	CHECK((x = matho_slot(pp, "x")) == 0);
+	CHECK(matho_slot(pp, "y") == -1);
+	CHECK(strcmp(matho_slot_name(pp, 0), "x") == 0);
+	CHECK(matho_slot_name(pp, 1) == NULL);
+	CHECK(matho_eval(pp, &d) && d == 0.0);		/* slots start out bound to zero */
+	CHECK(matho_bind(pp, x, 2.0, 0.0));
+	CHECK(matho_eval(pp, &d) && d == 10.0);
+	CHECK(matho_bind(pp, x, 0.5, 0.0));
+	CHECK(matho_eval(pp, &d) && d == 1.75);
+	CHECK(matho_bind(pp, x, 0.0, 1.0));
+	CHECK(!matho_eval(pp, &d));			/* a bound value is not real */
+	CHECK(matho_eval_complex(pp, &re, &im) && re == -1.0 && im == 3.0);
+/* Slots that don't exist can't be bound: */
+	CHECK((y = matho_slot(pp, "z")) == -1);
+	CHECK(!matho_bind(pp, y, 1.0, 0.0));
+	CHECK(!matho_bind(pp, 1, 1.0, 0.0));
+	matho_unprepare(pp);
+
+	CHECK((pp = prepare("sin(pi/6) + a/b")) != NULL);
+	if (pp == NULL)
+		return;
+	CHECK(matho_bind(pp, matho_slot(pp, "a"), 3.0, 0.0));
+	CHECK(matho_bind(pp, matho_slot(pp, "b"), 4.0, 0.0));
+	CHECK(matho_eval(pp, &d) && close_to(d, 1.25));
+	matho_unprepare(pp);
+
+/* Function calls with symbolic arguments are kept as calls and evaluated with the C library: */
+	CHECK((pp = prepare("tan(x) + log(x)")) != NULL);
+	if (pp == NULL)
+		return;
+	CHECK(matho_bind(pp, matho_slot(pp, "x"), 2.0, 0.0));
+	CHECK(matho_eval(pp, &d) && close_to(d, tan(2.0) + log(2.0)));
+	matho_unprepare(pp);
+
+/* The imaginary unit can only be evaluated with complex numbers: */
+	CHECK((pp = prepare("2*x + i")) != NULL);
+	if (pp == NULL)
+		return;
+	CHECK(matho_bind(pp, matho_slot(pp, "x"), 1.5, 0.0));
+	CHECK(!matho_eval(pp, &d));
+	CHECK(matho_eval_complex(pp, &re, &im) && re == 3.0 && im == 1.0);
+	matho_unprepare(pp);
+
+/* Empty equation spaces can't be prepared: */
+	matho_clear();
+	CHECK(matho_prepare(0) == NULL && error_str != NULL);
+}
+
+static void
+test_typed(void)
+{
+	matho_token		t[5];
+	const matho_token	*tp;
+	matho_prepared		*pp;
+	double			d;
+	long			a, b, c;
+	int			en, n;
+
+	matho_clear();
+	CHECK((a = matho_var("a")) != 0);
+	CHECK((b = matho_var("b")) != 0 && b != a);
+	CHECK((c = matho_var("c_2")) != 0 && c != a && c != b);
+	CHECK(matho_var("a") == a);
+	CHECK(strcmp(matho_var_name(c), "c_2") == 0);
+	CHECK(matho_var("pi") != 0 && strcmp(matho_var_name(matho_var("pi")), "pi") == 0);
+	CHECK(matho_var("2x") == 0);
+	CHECK(matho_var("") == 0);
+
+/* a*(b+c) is: a(level 1) TIMES(1) b(2) PLUS(2) c(2) */
+	t[0].kind = MATHO_VARIABLE;	t[0].level = 1;	t[0].token.variable = a;
+	t[1].kind = MATHO_OPERATOR;	t[1].level = 1;	t[1].token.operatr = MATHO_TIMES;
+	t[2].kind = MATHO_VARIABLE;	t[2].level = 2;	t[2].token.variable = b;
+	t[3].kind = MATHO_OPERATOR;	t[3].level = 2;	t[3].token.operatr = MATHO_PLUS;
+	t[4].kind = MATHO_VARIABLE;	t[4].level = 2;	t[4].token.variable = c;
+	CHECK((en = matho_set_expr(-1, t, 5, NULL, 0)) >= 0);
+	CHECK(en == cur_equation);
+	CHECK(matho_get_expr(en, 0, &tp, &n) && n == 5);
+	CHECK(tp[0].kind == MATHO_VARIABLE && tp[1].kind == MATHO_OPERATOR && tp[1].token.operatr == MATHO_TIMES);
+	CHECK(matho_get_expr(en, 1, &tp, &n) && n == 0);	/* an expression has no right-hand side */
+	CHECK(!matho_get_expr(en + 1, 0, &tp, &n) && tp == NULL && n == 0);
+	CHECK((pp = matho_prepare(en)) != NULL);
+	if (pp) {
+		CHECK(matho_bind(pp, matho_slot(pp, "a"), 2.0, 0.0));
+		CHECK(matho_bind(pp, matho_slot(pp, "b"), 3.0, 0.0));
+		CHECK(matho_bind(pp, matho_slot(pp, "c_2"), 4.0, 0.0));
+		CHECK(matho_eval(pp, &d) && d == 14.0);
+		matho_unprepare(pp);
+	}
+
+/* Store the equation b = 2.5 in equation space 5: */
+	t[3].kind = MATHO_VARIABLE;	t[3].level = 1;	t[3].token.variable = b;
+	t[4].kind = MATHO_CONSTANT;	t[4].level = 1;	t[4].token.constant = 2.5;
+	CHECK(matho_set_expr(5, &t[3], 1, &t[4], 1) == 5);
+	CHECK(matho_get_expr(5, 1, &tp, &n) && n == 1 && tp[0].kind == MATHO_CONSTANT && tp[0].token.constant == 2.5);
+
+/* Invalid token arrays are rejected: */
+	t[3].kind = MATHO_OPERATOR;	t[3].level = 2;	t[3].token.operatr = MATHO_PLUS;
+	t[4].kind = MATHO_VARIABLE;	t[4].level = 2;	t[4].token.variable = c;
+	t[0].token.variable = -1;	/* bad variable number */
+	CHECK(matho_set_expr(-1, t, 5, NULL, 0) == -1 && error_str != NULL);
+	t[0].token.variable = a;
+	CHECK(matho_set_expr(-1, t, 4, NULL, 0) == -1 && error_str != NULL);	/* even length */
+	t[1].level = 3;			/* operator deeper than its operands */
+	CHECK(matho_set_expr(-1, t, 3, NULL, 0) == -1 && error_str != NULL);
+	t[1].level = 1;
+	CHECK(matho_set_expr(-1, t, 3, NULL, 0) >= 0);
+
+/* sin(a) is: 1(2) F(2) a(2) */
+	t[0].kind = MATHO_CONSTANT;	t[0].level = 2;	t[0].token.constant = 1.0;
+	t[1].kind = MATHO_OPERATOR;	t[1].level = 2;	t[1].token.operatr = MATHO_FUNC_OP(MATHO_SIN);
+	t[2].kind = MATHO_VARIABLE;	t[2].level = 2;	t[2].token.variable = a;
+	CHECK((en = matho_set_expr(-1, t, 3, NULL, 0)) >= 0);
+	CHECK((pp = matho_prepare(en)) != NULL);
+	if (pp) {
+		CHECK(matho_bind(pp, matho_slot(pp, "a"), 0.5, 0.0));
+		CHECK(matho_eval(pp, &d) && close_to(d, sin(0.5)));
+		matho_unprepare(pp);
+	}
+	t[0].token.constant = 2.0;	/* the dummy operand must be 1 */
+	CHECK(matho_set_expr(-1, t, 3, NULL, 0) == -1 && error_str != NULL);
+	t[0].token.constant = 1.0;
+	t[1].token.operatr = MATHO_FUNC_OP(99);	/* no such function */
+	CHECK(matho_set_expr(-1, t, 3, NULL, 0) == -1 && error_str != NULL);
+}
+
+static void
+test_async(void)
+{
+	static const char	*requests[] = {
+		"x^2 - 4 = 0",
+		"solve x",
+		"1/k^2",
+		"sum k 1 1000000000",	/* much too slow, so it is canceled */
+		"2+3",
+		NULL
+	};
+	struct pollfd		pfd;
+	matho_completion	c;
+	long			ids[5];
+	int			i, waiting = 0, done[5] = { 0 };
+
+	matho_clear();
+	CHECK((pfd.fd = matho_async_start()) >= 0);
+	if (pfd.fd < 0)
+		return;
+	pfd.events = POLLIN;
+	for (i = 0; requests[i]; i++) {
+		CHECK((ids[i] = matho_submit(requests[i], (void *) requests[i])) > 0);
+		waiting++;
+	}
+	CHECK(matho_cancel_request(ids[3]));
+	CHECK(!matho_cancel_request(-1));
+	while (waiting > 0) {
+		if (poll(&pfd, 1, 10000) <= 0) {
+			CHECK(!"timed out waiting for completions");
+			break;
+		}
+		while (matho_complete(&c)) {
+			for (i = 0; requests[i]; i++) {
+				if (ids[i] == c.id)
+					break;
+			}
+			CHECK(requests[i] != NULL && c.data == (void *) requests[i] && !done[i]);
+			if (requests[i] == NULL) {
+				free(c.output);
+				continue;
+			}
+			done[i] = true;
+			switch (i) {
+			case 1:
+				CHECK(c.rv && c.output && strcmp(c.output, "x = 2*sign") == 0);
+				break;
+			case 3:
+				CHECK(!c.rv);
+				break;
+			case 4:
+				CHECK(c.rv && c.output && strcmp(c.output, "answer = 5") == 0);
+				break;
+			default:
+				CHECK(c.rv);
+				break;
+			}
+			free(c.output);
+			waiting--;
+		}
+	}
+	matho_async_stop();
+}
+
+int
+main(int argc, char **argv)
+{
+	if (!matho_init()) {
+		fprintf(stderr, "Not enough memory.\n");
+		exit(1);
+	}
+	test_prepared();
+	test_typed();
+	test_async();
+	if (n_failed) {
+		printf("%d of %d library API checks failed.\n", n_failed, n_checks);
+		exit(1);
+	}
+	printf("All %d library API checks passed.\n", n_checks);
+	exit(0);
+}
@@ -0,0 +1,309 @@
+/*
+ * Mathomatic asynchronous API, for calling the symbolic math library
+ * from event loops without blocking them.
+ *
+ * Requests are queued by matho_submit(3) and processed in order by one worker thread,
+ * because the Mathomatic engine is a single global instance that is not re-entrant.
+ * Completed requests are taken from the completion queue with matho_complete(3).
+ * The file descriptor returned by matho_async_start(3) becomes readable
+ * when completions are waiting, so it can be watched with poll(2), select(2), or epoll(7)
+ * like an eventfd.
+ *
+ * This file is kept separate from "lib.c", so only programs that use it
+ * need to be linked with the POSIX threads library (-lpthread).
+ */
+
+#include "../includes.h"
+#include "mathomatic.h"
+#include <pthread.h>
+#include <fcntl.h>
+
+typedef struct request {	/* a submitted request, queued first for processing, then for completion */
+	struct request	*next;	/* next request in the queue */
+	long		id;	/* request id, counting up from 1 */
+	char		*input;	/* malloc()ed copy of the input string */
+	void		*data;	/* caller's pointer from matho_submit() */
+	int		rv;	/* matho_process() return value */
+	char		*output;	/* malloc()ed output string, or NULL */
+} request_type;
+
+typedef struct {		/* a linked list queue of requests */
+	request_type	*head, *tail;
+} queue_type;
+
+static pthread_mutex_t	lock = PTHREAD_MUTEX_INITIALIZER;	/* protects everything below */
+static pthread_cond_t	work_ready = PTHREAD_COND_INITIALIZER;	/* signaled when a request is submitted or stopping */
+static pthread_t	worker;		/* the worker thread */
+static int		started;	/* true if the worker thread is running */
+static int		stopping;	/* true if the worker thread should exit when the submission queue is empty */
+static queue_type	submitted;	/* submission queue, waiting for the worker thread */
+static queue_type	completed;	/* completion queue, waiting for matho_complete() */
+static int		notify_fds[2] = { -1, -1 };	/* pipe with one byte for each completion */
+static long		last_id;	/* id of the last submitted request */
+static long		running_id;	/* id of the request being processed, or 0 */
+static volatile int	cancel_flag;	/* cancel flag given to matho_set_cancel() for the running request */
+
+static void
+enqueue(queue_type *qp, request_type *rp)
+{
+	rp->next = NULL;
+	if (qp->tail)
+		qp->tail->next = rp;
+	else
+		qp->head = rp;
+	qp->tail = rp;
+}
+
+static request_type *
+dequeue(queue_type *qp)
+{
+	request_type	*rp;
+
+	if ((rp = qp->head) != NULL) {
+		qp->head = rp->next;
+		if (qp->head == NULL)
+			qp->tail = NULL;
+	}
+	return rp;
+}
+
+static void
+free_queue(queue_type *qp)
+{
+	request_type	*rp;
+
+	while ((rp = dequeue(qp)) != NULL) {
+		free(rp->input);
+		free(rp->output);
+		free(rp);
+	}
+}
+
+/*
+ * Put a finished request on the completion queue and make the notify pipe readable.
+ * Must be called with the lock held.
+ */
+static void
+complete(request_type *rp)
+{
+	enqueue(&completed, rp);
+	if (write(notify_fds[1], "", 1) < 0) {
+		/* pipe is full, so it is already readable */
+	}
+}
+
+/*
+ * The worker thread, which processes submitted requests in order.
+ */
+static void *
+worker_main(void *arg)
+{
+	request_type	*rp;
+	char		*output;
+
+	for (;;) {
+		pthread_mutex_lock(&lock);
+		while (submitted.head == NULL && !stopping)
+			pthread_cond_wait(&work_ready, &lock);
+		if ((rp = dequeue(&submitted)) == NULL) {
+			pthread_mutex_unlock(&lock);
+			break;
+		}
+		running_id = rp->id;
+		cancel_flag = false;
+		pthread_mutex_unlock(&lock);
+
+		rp->rv = matho_process(rp->input, &output);
+		if (output && !rp->rv) {
+			output = strdup(output);	/* error messages are constant strings */
+		}
+		rp->output = output;
+		free(rp->input);
+		rp->input = NULL;
+
+		pthread_mutex_lock(&lock);
+		running_id = 0;
+		complete(rp);
+		pthread_mutex_unlock(&lock);
+	}
+	return NULL;
+}
+
+/** 3
+ * matho_async_start - Start the asynchronous Mathomatic API
+ * Start the worker thread that processes requests submitted with matho_submit(3).
+ * matho_init(3) must have been called before this.
+ * Until matho_async_stop(3) is called, no other library functions may be called,
+ * except matho_submit(3), matho_complete(3), and matho_cancel_request(3),
+ * which may be called from any thread.
+ *
+ * Returns a file descriptor that is readable when completions are waiting,
+ * for use with poll(2) and the like, or -1 if the worker thread or pipe
+ * could not be created.  Don't read from or close the file descriptor.
+ */
+int
+matho_async_start(void)
+{
+	int	i;
+
+	if (started)
+		return notify_fds[0];
+	if (pipe(notify_fds) < 0)
+		return -1;
+	for (i = 0; i < 2; i++) {
+		fcntl(notify_fds[i], F_SETFL, fcntl(notify_fds[i], F_GETFL) | O_NONBLOCK);
+		fcntl(notify_fds[i], F_SETFD, FD_CLOEXEC);
+	}
+	stopping = false;
+	matho_set_cancel(&cancel_flag);
+	if (pthread_create(&worker, NULL, worker_main, NULL) != 0) {
+		matho_set_cancel(NULL);
+		close(notify_fds[0]);
+		close(notify_fds[1]);
+		notify_fds[0] = notify_fds[1] = -1;
+		return -1;
+	}
+	started = true;
+	return notify_fds[0];
+}
+
+/** 3
+ * matho_submit - Queue a Mathomatic command or expression for processing
+ * Queue "input" to be processed by matho_process(3) in the worker thread,
+ * after all previously submitted requests.  Doesn't block.
+ * "input" is copied, and "data" is any pointer to give back with the completion.
+ *
+ * Returns the request id, a positive number that is unique until matho_async_stop(3),
+ * or -1 if the asynchronous API isn't started or there is not enough memory.
+ */
+long
+matho_submit(const char *input, void *data)
+{
+	request_type	*rp;
+	long		id;
+
+	if (input == NULL || (rp = (request_type *) calloc(1, sizeof(request_type))) == NULL)
+		return -1;
+	if ((rp->input = strdup(input)) == NULL) {
+		free(rp);
+		return -1;
+	}
+	rp->data = data;
+	pthread_mutex_lock(&lock);
+	if (!started || stopping) {
+		pthread_mutex_unlock(&lock);
+		free(rp->input);
+		free(rp);
+		return -1;
+	}
+	id = rp->id = ++last_id;
+	enqueue(&submitted, rp);
+	pthread_cond_signal(&work_ready);
+	pthread_mutex_unlock(&lock);
+	return id;
+}
+
+/** 3
+ * matho_complete - Get the next completed request
+ * Take the next completed request off the completion queue, without blocking.
+ * Completions are in the same order as the requests were submitted,
+ * except that canceled requests that were still queued complete right away.
+ * When the file descriptor from matho_async_start(3) is readable,
+ * call this repeatedly until it returns false.
+ *
+ * If a completion was waiting, this fills in "*cp" and returns true.
+ * "cp->id" and "cp->data" identify the request, and "cp->rv" and "cp->output"
+ * are what matho_process(3) returned, except that "cp->output" is always a malloc()ed
+ * string, even for error messages, which must be free()d after use, unless it is NULL.
+ *
+ * Returns false if no completions are waiting.
+ */
+int
+matho_complete(matho_completion *cp)
+{
+	request_type	*rp;
+	char		c;
+
+	pthread_mutex_lock(&lock);
+	if ((rp = dequeue(&completed)) == NULL) {
+		pthread_mutex_unlock(&lock);
+		return false;
+	}
+	if (read(notify_fds[0], &c, 1) < 0) {
+		/* one byte per completion, unless the pipe was full */
+	}
+	pthread_mutex_unlock(&lock);
+	cp->id = rp->id;
+	cp->rv = rp->rv;
+	cp->output = rp->output;
+	cp->data = rp->data;
+	free(rp);
+	return true;
+}
+
+/** 3
+ * matho_cancel_request - Cancel a submitted request
+ * Cancel the request with the id returned by matho_submit(3), from any thread.
+ * If it is still queued, it is completed right away without being processed.
+ * If it is being processed, processing stops as soon as possible.
+ * Either way, it completes with a false return value and an error message.
+ *
+ * Returns true if the request was found and canceled,
+ * false if it already completed or the id is unknown.
+ */
+int
+matho_cancel_request(long id)
+{
+	request_type	*rp, *prev;
+
+	pthread_mutex_lock(&lock);
+	if (id > 0 && id == running_id) {
+		cancel_flag = true;
+		pthread_mutex_unlock(&lock);
+		return true;
+	}
+	for (prev = NULL, rp = submitted.head; rp; prev = rp, rp = rp->next) {
+		if (rp->id == id) {
+			if (prev)
+				prev->next = rp->next;
+			else
+				submitted.head = rp->next;
+			if (submitted.tail == rp)
+				submitted.tail = prev;
+			free(rp->input);
+			rp->input = NULL;
+			rp->rv = false;
+			rp->output = strdup(_("Request canceled."));
+			complete(rp);
+			pthread_mutex_unlock(&lock);
+			return true;
+		}
+	}
+	pthread_mutex_unlock(&lock);
+	return false;
+}
+
+/** 3
+ * matho_async_stop - Stop the asynchronous Mathomatic API
+ * Wait for all submitted requests to finish, stop the worker thread,
+ * and discard any completions not yet taken by matho_complete(3).
+ * The file descriptor from matho_async_start(3) is closed.
+ * Afterwards, the other library functions may be called again.
+ */
+void
+matho_async_stop(void)
+{
+	if (!started)
+		return;
+	pthread_mutex_lock(&lock);
+	stopping = true;
+	pthread_cond_signal(&work_ready);
+	pthread_mutex_unlock(&lock);
+	pthread_join(worker, NULL);
+	matho_set_cancel(NULL);
+	free_queue(&completed);
+	close(notify_fds[0]);
+	close(notify_fds[1]);
+	notify_fds[0] = notify_fds[1] = -1;
+	started = false;
+}
@@ -0,0 +1,68 @@
+/*
+ * Example event loop using the asynchronous API of the Mathomatic symbolic math library.
+ * Submits a few requests, cancels a slow one, and waits for the completions with poll(2),
+ * printing a dot every 10 milliseconds to show the event loop is never blocked.
+ */
+
+#include "../includes.h"
+#include "mathomatic.h"
+#include <poll.h>
+
+static char	*requests[] = {
+	"x^2-5*x+6=0",
+	"solve x",
+	"(a+b)^4",
+	"expand",
+	"factor",
+	"integrate a",
+	"1/k^2",
+	"sum k 1 1000000000",	/* much too slow, so it is canceled */
+	NULL
+};
+
+int
+main(int argc, char **argv)
+{
+	struct pollfd		pfd;
+	matho_completion	c;
+	long			slow_id = 0, id;
+	int			i, waiting = 0, ticks = 0;
+
+	if (!matho_init()) {
+		fprintf(stderr, "Not enough memory.\n");
+		exit(1);
+	}
+	if ((pfd.fd = matho_async_start()) < 0) {
+		fprintf(stderr, "Can't start the worker thread.\n");
+		exit(1);
+	}
+	pfd.events = POLLIN;
+	for (i = 0; requests[i]; i++) {
+		if ((id = matho_submit(requests[i], requests[i])) < 0) {
+			fprintf(stderr, "Submit failed.\n");
+			exit(1);
+		}
+		if (strncmp(requests[i], "sum", 3) == 0)
+			slow_id = id;
+		waiting++;
+	}
+	while (waiting > 0) {
+		if (poll(&pfd, 1, 10) == 0) {
+			printf(".");
+			fflush(stdout);
+			if (++ticks == 20 && slow_id) {
+				printf("\nCanceling request %ld.\n", slow_id);
+				matho_cancel_request(slow_id);
+			}
+			continue;
+		}
+		while (matho_complete(&c)) {
+			printf("\n%ld: %s -> %s%s\n", c.id, (char *) c.data,
+			    c.rv ? "" : "error: ", c.output ? c.output : "");
+			free(c.output);
+			waiting--;
+		}
+	}
+	matho_async_stop();
+	exit(0);
+}
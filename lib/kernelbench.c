@@ -0,0 +1,430 @@
+/*
+ * Microbenchmark for the core kernels of the Mathomatic symbolic math engine.
+ * Times parse_expr(), list_string(), organize(), elim_loop(), simp_loop(), se_compare(),
+ * poly_div(), poly_gcd(), and factor_one() on reproducible generated expressions,
+ * by calling them directly, without the overhead of commands and display.
+ *
+ * Each kernel is warmed up, then timed in a number of samples,
+ * each running the kernel enough times to take about 10 milliseconds.
+ * The minimum, median, mean, and relative standard deviation
+ * of the time per call of the samples are displayed.
+ * Inputs are copied to a work area before each call, and that time is included.
+ *
+ * Usage: ./kernelbench [ -r samples ] [ -s save_file ] [ -c compare_file [ -t percent ] ] [ kernel ... ]
+ * With no kernel names, all kernels are timed.
+ * -s saves the median times as a baseline for -c to compare against later.
+ * -c shows the change from the baseline median times, and exits with a non-zero
+ * status if any kernel is more than "percent" (default 10) percent slower.
+ */
+
+#include "../includes.h"
+#include "mathomatic.h"
+#include <time.h>
+
+#define	WARMUP_SECONDS	0.05	/* time to run each kernel before timing it */
+#define	SAMPLE_SECONDS	0.01	/* approximate time of each sample */
+#define	MAX_SAMPLES	1000
+
+typedef struct {
+	char	*name;		/* kernel function name */
+	int	n;		/* size of the generated input, in terms or degree */
+	void	(*setup)(int n);	/* generates the input */
+	void	(*run)(void);	/* calls the kernel once */
+} kernel_type;
+
+static unsigned long	seed;		/* pseudo-random number generator state, reset for each kernel */
+static char		*text;		/* generated expression text */
+static char		*out;		/* list_string() output buffer */
+static token_type	*src1, *src2;	/* generated input expressions */
+static int		n_src1, n_src2;
+static token_type	*work;		/* copy of src1 for kernels that modify their input */
+static int		n_work;
+static long		v_x;		/* variable number of "x" */
+static double		semiprime;	/* the number to factor */
+
+static double
+seconds(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1.0e9;
+}
+
+/*
+ * Return a reproducible pseudo-random number from 0 to limit - 1.
+ */
+static int
+next_rand(int limit)
+{
+	seed = (seed * 1103515245UL + 12345UL) & 0x7fffffffUL;
+	return (int) ((seed >> 16) % limit);
+}
+
+/*
+ * Generate an "n" term polynomial in x, y, and z, with small exponents,
+ * so there are many like terms to combine.
+ * If "reverse" is true, the terms are in the reverse order.
+ */
+static void
+gen_sum(char *buf, int n, int reverse)
+{
+	int	i, k, terms[1000][4];
+	char	*cp = buf;
+
+	n = min(n, ARR_CNT(terms));
+	for (i = 0; i < n; i++) {
+		for (k = 0; k < 4; k++)
+			terms[i][k] = next_rand(k ? 4 : 100) + (k == 0);
+	}
+	for (i = 0; i < n; i++) {
+		k = reverse ? n - 1 - i : i;
+		cp += sprintf(cp, "%s%d*x^%d*y^%d*z^%d", (i ? "+" : ""), terms[k][0], terms[k][1], terms[k][2], terms[k][3]);
+	}
+}
+
+/*
+ * Generate the expanded polynomial (x+1)^n*(x+a)*(x+b).
+ */
+static void
+gen_poly(char *buf, int n, double a, double b)
+{
+	double	c[100], r;
+	int	i, k;
+	char	*cp = buf;
+
+	n = min(n, ARR_CNT(c) - 3);
+	c[0] = 1.0;
+	for (k = 1; k <= n + 2; k++)
+		c[k] = 0.0;
+	for (i = 1; i <= n + 2; i++) {
+		r = (i <= n) ? 1.0 : ((i == n + 1) ? a : b);
+		for (k = i; k > 0; k--)
+			c[k] = c[k-1] + r * c[k];
+		c[0] = r * c[0];
+	}
+	*cp = '\0';
+	for (k = n + 2; k >= 0; k--) {
+		if (c[k] != 0.0)
+			cp += sprintf(cp, "%s%.0f*x^%d", ((cp != buf && c[k] > 0.0) ? "+" : ""), c[k], k);
+	}
+}
+
+static void
+parse_into(token_type *p1, int *np, char *buf)
+{
+	if (parse_expr(p1, np, buf, true) == NULL || *np <= 0) {
+		fprintf(stderr, "Error parsing generated expression.\n");
+		exit(1);
+	}
+}
+
+static void
+copy_work(void)
+{
+	blt(work, src1, n_src1 * sizeof(token_type));
+	n_work = n_src1;
+}
+
+static void
+setup_sum(int n)
+{
+	gen_sum(text, n, false);
+	parse_into(src1, &n_src1, text);
+	gen_sum(text, n, false);	/* parse_expr() may have changed the text */
+}
+
+static void
+setup_list(int n)
+{
+	setup_sum(n);
+	if ((out = (char *) realloc(out, list_string(src1, n_src1, NULL, false) + 1)) == NULL) {
+		fprintf(stderr, "Not enough memory.\n");
+		exit(1);
+	}
+}
+
+/* Put redundant parentheses around every term, for organize() to remove. */
+static void
+setup_organize(int n)
+{
+	int	i;
+
+	setup_sum(n);
+	for (i = 0; i < n_src1; i++) {
+		if (src1[i].kind != OPERATOR || src1[i].level != 1 || src1[i].token.operatr != PLUS)
+			src1[i].level++;
+	}
+}
+
+/* Compare a sum with the same sum in reverse order. */
+static void
+setup_compare(int n)
+{
+	unsigned long	save_seed = seed;
+
+	setup_sum(n);
+	seed = save_seed;
+	gen_sum(text, n, true);
+	parse_into(src2, &n_src2, text);
+}
+
+static void
+setup_poly(int n)
+{
+	gen_poly(text, n, -2.0, 3.0);
+	parse_into(src1, &n_src1, text);
+	gen_poly(text, n / 2, 5.0, -2.0);
+	parse_into(src2, &n_src2, text);
+}
+
+static void
+setup_factor(int n)
+{
+	semiprime = 999983.0 * 1000003.0;	/* the product of two 6 and 7 digit primes */
+}
+
+static void
+run_parse(void)
+{
+	if (parse_expr(work, &n_work, text, true) == NULL)
+		longjmp(jmp_save, 3);
+}
+
+static void
+run_list(void)
+{
+	list_string(src1, n_src1, out, false);
+}
+
+static void
+run_organize(void)
+{
+	copy_work();
+	organize(work, &n_work);
+}
+
+static void
+run_elim(void)
+{
+	copy_work();
+	elim_loop(work, &n_work);
+}
+
+static void
+run_simp(void)
+{
+	copy_work();
+	simp_loop(work, &n_work);
+}
+
+static void
+run_compare(void)
+{
+	int	diff_sign;
+
+	if (!se_compare(src1, n_src1, src2, n_src2, &diff_sign))
+		longjmp(jmp_save, 3);
+}
+
+static void
+run_div(void)
+{
+	long	v = v_x;
+
+	if (poly_div(src1, n_src1, src2, n_src2, &v) == 0)
+		longjmp(jmp_save, 3);
+}
+
+static void
+run_gcd(void)
+{
+	if (poly_gcd(src1, n_src1, src2, n_src2, v_x) <= 0)
+		longjmp(jmp_save, 3);
+}
+
+static void
+run_factor(void)
+{
+	if (!factor_one(semiprime))
+		longjmp(jmp_save, 3);
+}
+
+static kernel_type	kernels[] = {
+	{ "parse_expr",		200,	setup_sum,	run_parse },
+	{ "list_string",	200,	setup_list,	run_list },
+	{ "organize",		200,	setup_organize,	run_organize },
+	{ "elim_loop",		200,	setup_sum,	run_elim },
+	{ "simp_loop",		200,	setup_sum,	run_simp },
+	{ "se_compare",		200,	setup_compare,	run_compare },
+	{ "poly_div",		16,	setup_poly,	run_div },
+	{ "poly_gcd",		16,	setup_poly,	run_gcd },
+	{ "factor_one",		13,	setup_factor,	run_factor },	/* n is the number of digits */
+	{ NULL }
+};
+
+static int
+compare_doubles(const void *p1, const void *p2)
+{
+	double	d1 = *(const double *) p1, d2 = *(const double *) p2;
+
+	return (d1 > d2) - (d1 < d2);
+}
+
+/*
+ * Time kernel "kp" in "samples" samples.
+ *
+ * Return the median time per call in nanoseconds, or -1 if it failed.
+ */
+static double
+bench(kernel_type *kp, int samples)
+{
+	static double	ns[MAX_SAMPLES];
+	double		start, elapsed, mean, var;
+	long		calls, batch, j;
+	int		i;
+
+	if (setjmp(jmp_save) != 0) {
+		printf("%-12s failed\n", kp->name);
+		return -1.0;
+	}
+	seed = 1;
+	(*kp->setup)(kp->n);
+	start = seconds();
+	calls = 0;
+	do {
+		(*kp->run)();
+		calls++;
+	} while ((elapsed = seconds() - start) < WARMUP_SECONDS);
+	batch = max(1, (long) (SAMPLE_SECONDS * calls / elapsed));
+	for (i = 0; i < samples; i++) {
+		start = seconds();
+		for (j = 0; j < batch; j++)
+			(*kp->run)();
+		ns[i] = (seconds() - start) * 1.0e9 / batch;
+	}
+	qsort(ns, samples, sizeof(double), compare_doubles);
+	for (mean = 0.0, i = 0; i < samples; i++)
+		mean += ns[i];
+	mean /= samples;
+	for (var = 0.0, i = 0; i < samples; i++)
+		var += (ns[i] - mean) * (ns[i] - mean);
+	var /= samples;
+	printf("%-12s %5d %12.0f %12.0f %12.0f %7.1f%%", kp->name, kp->n,
+	    ns[0], ns[samples / 2], mean, 100.0 * sqrt(var) / mean);
+	return ns[samples / 2];
+}
+
+/*
+ * Look up the baseline median time for kernel "name" in file "fp".
+ *
+ * Return it, or -1 if not found.
+ */
+static double
+baseline(FILE *fp, char *name)
+{
+	char	buf[100];
+	double	d;
+
+	rewind(fp);
+	while (fscanf(fp, "%99s %lf", buf, &d) == 2) {
+		if (strcmp(buf, name) == 0)
+			return d;
+	}
+	return -1.0;
+}
+
+int
+main(int argc, char **argv)
+{
+	FILE		*save_fp = NULL, *compare_fp = NULL;
+	kernel_type	*kp;
+	int		i, c, samples = 15, selected, slower = 0;
+	double		threshold = 10.0, median, base, change;
+
+	while ((c = getopt(argc, argv, "r:s:c:t:")) >= 0) {
+		switch (c) {
+		case 'r':
+			samples = atoi(optarg);
+			if (samples < 1 || samples > MAX_SAMPLES) {
+				fprintf(stderr, "Number of samples must be 1 to %d.\n", MAX_SAMPLES);
+				exit(2);
+			}
+			break;
+		case 's':
+			if ((save_fp = fopen(optarg, "w")) == NULL) {
+				perror(optarg);
+				exit(2);
+			}
+			break;
+		case 'c':
+			if ((compare_fp = fopen(optarg, "r")) == NULL) {
+				perror(optarg);
+				exit(2);
+			}
+			break;
+		case 't':
+			threshold = atof(optarg);
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [ -r samples ] [ -s save_file ] [ -c compare_file [ -t percent ] ] [ kernel ... ]\n", argv[0]);
+			exit(2);
+		}
+	}
+	for (i = optind; i < argc; i++) {
+		for (kp = kernels; kp->name; kp++) {
+			if (strcmp(argv[i], kp->name) == 0)
+				break;
+		}
+		if (kp->name == NULL) {
+			fprintf(stderr, "Unknown kernel: %s\n", argv[i]);
+			exit(2);
+		}
+	}
+	if (!matho_init()) {
+		fprintf(stderr, "Not enough memory.\n");
+		exit(1);
+	}
+	text = (char *) malloc(100000);
+	src1 = (token_type *) malloc(n_tokens * sizeof(token_type));
+	src2 = (token_type *) malloc(n_tokens * sizeof(token_type));
+	work = (token_type *) malloc(n_tokens * sizeof(token_type));
+	if (text == NULL || src1 == NULL || src2 == NULL || work == NULL) {
+		fprintf(stderr, "Not enough memory.\n");
+		exit(1);
+	}
+	parse_var(&v_x, "x");
+	printf("%d samples, nanoseconds per call:\n", samples);
+	printf("%-12s %5s %12s %12s %12s %8s%s\n", "kernel", "n", "min", "median", "mean", "stddev",
+	    compare_fp ? "   change" : "");
+	for (kp = kernels; kp->name; kp++) {
+		selected = (optind >= argc);
+		for (i = optind; i < argc; i++) {
+			if (strcmp(argv[i], kp->name) == 0)
+				selected = true;
+		}
+		if (!selected)
+			continue;
+		if ((median = bench(kp, samples)) < 0.0)
+			continue;
+		if (save_fp) {
+			fprintf(save_fp, "%s %.1f\n", kp->name, median);
+		}
+		if (compare_fp && (base = baseline(compare_fp, kp->name)) > 0.0) {
+			change = 100.0 * (median - base) / base;
+			printf(" %+7.1f%%%s", change, (change > threshold) ? " SLOWER" : "");
+			if (change > threshold)
+				slower++;
+		}
+		printf("\n");
+	}
+	if (save_fp && fclose(save_fp) != 0) {
+		perror("save file");
+		exit(1);
+	}
+	if (slower) {
+		printf("%d kernel(s) more than %g%% slower than the baseline.\n", slower, threshold);
+		exit(1);
+	}
+	exit(0);
+}
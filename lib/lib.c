@@ -13,6 +13,32 @@
 
 #include "../includes.h"
 #include "mathomatic.h"
+#include <stddef.h>	/* for offsetof() */
+
+static char	*input_buf;		/* reused copy of the input string, so it isn't strdup()ed for every call */
+static int	input_buf_size;		/* allocated size of input_buf */
+
+/*
+ * Copy "input" into the reused input buffer, enlarging it if needed.
+ *
+ * Return the copy, or NULL if out of memory.
+ */
+static char *
+copy_input(char *input)
+{
+	int	len;
+	char	*cp;
+
+	len = strlen(input) + 1;
+	if (len > input_buf_size) {
+		if ((cp = (char *) realloc(input_buf, len)) == NULL)
+			return NULL;
+		input_buf = cp;
+		input_buf_size = len;
+	}
+	blt(input_buf, input, len);
+	return input_buf;
+}
 
 /** 3
  * matho_init - Initialize the Mathomatic symbolic math library
@@ -83,6 +109,8 @@ matho_clear(void)
  *
  * The resulting output string can safely be ignored by calling
  * this function with "outputp" set to NULL.
+ * That is faster, because the result expression is then not converted to a string;
+ * use matho_get_expr(3) to read the result from equation space "result_en" instead.
  */
 int
 matho_process(char *input, char **outputp)
@@ -93,14 +121,22 @@ matho_process(char *input, char **outputp)
 	if (outputp)
 		*outputp = NULL;
 	result_str = NULL;
+	result_wanted = (outputp != NULL);
 	result_en = -1;
 	error_str = NULL;
 	warning_str = NULL;
 	if (input == NULL)
 		return false;
-	input = strdup(input);
+	if ((input = copy_input(input)) == NULL) {
+		error(_("Out of memory (can't malloc(3))."));
+		if (outputp)
+			*outputp = (char *) error_str;
+		return false;
+	}
 	if ((i = setjmp(jmp_save)) != 0) {
 		clean_up();	/* Mathomatic processing was interrupted, so do a clean up. */
+		trace_unwind();
+		end_command_stats(0);
 		if (i == 14) {
 			error(_("Expression too large."));
 		}
@@ -112,7 +148,6 @@ matho_process(char *input, char **outputp)
 			}
 		}
 		free_result_str();
-		free(input);
 		previous_return_value = 0;
 		return false;
 	}
@@ -123,7 +158,8 @@ matho_process(char *input, char **outputp)
 			*outputp = result_str;
 		} else {
 			if (result_str) {
-				free(result_str);
+				if (!reused_string(result_str))
+					free(result_str);
 				result_str = NULL;
 			}
 		}
@@ -137,7 +173,42 @@ matho_process(char *input, char **outputp)
 		}
 		free_result_str();
 	}
-	free(input);
+	return rv;
+}
+
+/** 3
+ * matho_process_buf - Process Mathomatic input, with output to a caller supplied buffer
+ * Same as matho_process(3), except the resulting output string or error message
+ * is copied into the "size" character buffer "outbuf", truncated if it doesn't fit,
+ * and nothing needs to be freed afterwards.
+ * "outbuf" may be NULL if the output is not wanted.
+ *
+ * The input and output strings are kept in buffers that are reused by the next call,
+ * so once they are big enough, processing a command with single-line output
+ * does not allocate any memory in the library API.
+ * 2D output (display2d) is still allocated and freed each time.
+ *
+ * Returns true (non-zero) if successful.
+ */
+int
+matho_process_buf(char *input, char *outbuf, int size)
+{
+	char	*output = NULL;
+	int	rv;
+
+	result_reuse = true;
+	rv = matho_process(input, (outbuf && size > 0) ? &output : NULL);
+	result_reuse = false;
+	if (outbuf && size > 0) {
+		if (output) {
+			my_strlcpy(outbuf, output, size);
+		} else {
+			outbuf[0] = '\0';
+		}
+	}
+	if (rv && output && !reused_string(output)) {
+		free(output);
+	}
 	return rv;
 }
 
@@ -175,14 +246,22 @@ matho_parse(char *input, char **outputp)
 	if (outputp)
 		*outputp = NULL;
 	result_str = NULL;
+	result_wanted = (outputp != NULL);
 	result_en = -1;
 	error_str = NULL;
 	warning_str = NULL;
 	if (input == NULL)
 		return false;
-	input = strdup(input);
+	if ((input = copy_input(input)) == NULL) {
+		error(_("Out of memory (can't malloc(3))."));
+		if (outputp)
+			*outputp = (char *) error_str;
+		return false;
+	}
 	if ((i = setjmp(jmp_save)) != 0) {
 		clean_up();	/* Mathomatic processing was interrupted, so do a clean up. */
+		trace_unwind();
+		end_command_stats(0);
 		if (i == 14) {
 			error(_("Expression too large."));
 		}
@@ -194,7 +273,6 @@ matho_parse(char *input, char **outputp)
 			}
 		}
 		free_result_str();
-		free(input);
 		return false;
 	}
 	set_error_level(input);
@@ -209,7 +287,8 @@ matho_parse(char *input, char **outputp)
 			*outputp = result_str;
 		} else {
 			if (result_str) {
-				free(result_str);
+				if (!reused_string(result_str))
+					free(result_str);
 				result_str = NULL;
 			}
 		}
@@ -223,10 +302,605 @@ matho_parse(char *input, char **outputp)
 		}
 		free_result_str();
 	}
-	free(input);
 	return rv;
 }
 
+/** 3
+ * matho_set_cancel - Set the flag that cancels Mathomatic processing
+ * Make the symbolic math engine poll the int pointed to by "flagp" while it works.
+ * Setting that int to non-zero, from any thread or from a signal handler,
+ * makes the library call in progress stop as soon as possible and return false
+ * with a "Processing was interrupted." error.
+ * As long as the flag stays non-zero, later calls are also canceled.
+ * The flag belongs to the caller, it is never changed by the library.
+ *
+ * Use a new flag (or clear the old one) for each request,
+ * so canceling a stale request can't cancel the next one.
+ * Passing NULL stops polling any flag.
+ */
+void
+matho_set_cancel(volatile int *flagp)
+{
+	cancel_flagp = flagp;
+}
+
+/** 3
+ * matho_set_progress - Set a function to call with progress reports
+ * Set a function to be called periodically by long running loops of the
+ * symbolic math engine: repeated simplification, polynomial factoring,
+ * the sum and product commands, and nintegrate.
+ * It is called from the thread running the library call, as
+ * (*callback)(where, count, data), where "where" is a constant string naming the loop
+ * ("simplify", "factor", "sum", "product", or "nintegrate"),
+ * "count" is how far along the loop is, and "data" is the pointer given here.
+ * The callback must not call the library.
+ *
+ * If the callback returns non-zero, the current library call is canceled,
+ * and returns false with a "Processing was interrupted." error.
+ * Passing NULL for "callback" turns off progress reports.
+ */
+void
+matho_set_progress(int (*callback)(const char *where, long count, void *data), void *data)
+{
+	progress_callback = callback;
+	progress_data = data;
+}
+
+/** 3
+ * matho_counters_json - Get the hot-path instrumentation counters
+ * Return the symbolic math engine's always-compiled instrumentation counters
+ * as a JSON object string: se_compare() calls and size early-outs, bytes moved by blt(),
+ * simp_loop() iterations, error_huge() aborts, calls and hits of each
+ * transformation rule function, the peak number of tokens in each equation space,
+ * and a "memory" object with the bytes allocated now ("live") and at most ("peak") for each
+ * memory category and in total, with the memory quota and how many times it was exceeded.
+ * The counters accumulate from program start, or from the last reset.
+ * The same counters are displayed by the "version counters" command.
+ *
+ * If "reset_flag" is true, all counters are zeroed after they are read,
+ * and the memory peaks are set to the memory allocated now.
+ * The returned string is overwritten by the next call; don't free() it.
+ */
+const char *
+matho_counters_json(int reset_flag)
+{
+	const char	*cp;
+
+	sample_peak_tokens();
+	cp = counters_json();
+	if (reset_flag)
+		reset_counters();
+	return cp;
+}
+
+/** 3
+ * matho_command_stats_json - Get per-command latency histograms and memory high-water marks
+ * Return running statistics for each Mathomatic command keyword,
+ * and for "(expression)" input that is not a command, as a JSON object string.
+ * For each command run at least once, it gives the count, the total seconds,
+ * the 50th, 90th, and 99th percentile and maximum latencies in milliseconds,
+ * a latency histogram with the bucket limits in microseconds in "bucket_limits_us"
+ * (the last bucket has no limit), the peak expression size in tokens,
+ * and the most memory really allocated at once during a run and its largest growth
+above what was allocated when the run started, in bytes.
+ * The same statistics are displayed by the "version statistics" command.
+ *
+ * If "reset_flag" is true, all statistics are zeroed after they are read.
+ * The returned string is overwritten by the next call; don't free() it.
+ */
+const char *
+matho_command_stats_json(int reset_flag)
+{
+	const char	*cp;
+
+	cp = command_stats_json();
+	if (reset_flag)
+		reset_command_stats();
+	return cp;
+}
+
+/*
+ * The typed API below reads and writes equation spaces directly as token arrays,
+ * so chains of operations need not print and re-parse their intermediate results.
+ * matho_token must be laid out exactly like the internal token_type:
+ */
+typedef char	matho_token_check[(sizeof(matho_token) == sizeof(token_type)
+		    && offsetof(matho_token, level) == offsetof(token_type, level)
+		    && offsetof(matho_token, token) == offsetof(token_type, token)) ? 1 : -1];
+
+/*
+ * Return the operator precedence class of operator "op",
+ * operators of the same class may be on the same level of parentheses.
+ */
+static int
+op_class(int op)
+{
+	switch (op) {
+	case MINUS:
+		return PLUS;
+	case DIVIDE:
+	case MODULUS:
+	case IDIVIDE:
+		return TIMES;
+	}
+	return op;
+}
+
+/*
+ * Return true if "v" is a variable that exists in this session:
+ * a predefined special variable, possibly subscripted,
+ * or a subscript-free reference to an entry in var_names[].
+ */
+static int
+valid_variable(long v)
+{
+	long	name, subscript;
+
+	if (v <= 0)
+		return false;
+	name = v & VAR_MASK;
+	subscript = v >> VAR_SHIFT;
+	if (subscript & ~SUBSCRIPT_MASK)
+		return false;
+	if (name < VAR_OFFSET)
+		return(name >= V_E && name <= SIGN);
+	if (subscript)
+		return false;
+	name -= VAR_OFFSET;
+	return(name < MAX_VAR_NAMES && var_names[name] != NULL);
+}
+
+/*
+ * Check that "n" tokens at "p1" are a valid expression in Mathomatic internal format.
+ *
+ * Return true if valid, otherwise give an error message and return false.
+ */
+static int
+check_tokens(const matho_token *p1, int n)
+{
+	int	i, sp = 0;
+
+	if (n <= 0 || (n & 1) == 0 || n > n_tokens) {
+		error(_("Bad expression size."));
+		return false;
+	}
+	for (i = 0; i < n; i++) {
+		if (p1[i].level < 1 || p1[i].level > n) {
+			error(_("Bad level of parentheses in expression."));
+			return false;
+		}
+		if ((i & 1) == 0) {
+			switch (p1[i].kind) {
+			case MATHO_CONSTANT:
+				if (isnan(p1[i].token.constant)) {
+					error(_("Invalid constant in expression."));
+					return false;
+				}
+				continue;
+			case MATHO_VARIABLE:
+				if (!valid_variable(p1[i].token.variable)) {
+					error(_("Invalid variable in expression."));
+					return false;
+				}
+				continue;
+			}
+			error(_("Operand expected in expression."));
+			return false;
+		}
+		if (p1[i].kind != MATHO_OPERATOR || p1[i].token.operatr < PLUS
+		    || (p1[i].token.operatr > FACTORIAL && !IS_FUNC_OP(p1[i].token.operatr))
+		    || p1[i].token.operatr == NEGATE) {
+			error(_("Operator expected in expression."));
+			return false;
+		}
+		if (p1[i-1].level < p1[i].level || p1[i+1].level < p1[i].level) {
+			error(_("Operator level of parentheses is higher than its operands."));
+			return false;
+		}
+/* Use scratch[] as a stack of the operators of each level of parentheses not yet closed. */
+		while (sp > 0 && scratch[sp-1].level > p1[i].level)
+			sp--;
+		if (sp > 0 && scratch[sp-1].level == p1[i].level) {
+			if (op_class(scratch[sp-1].token.operatr) != op_class(p1[i].token.operatr)) {
+				error(_("Operators of different precedence on the same level of parentheses."));
+				return false;
+			}
+		} else {
+			scratch[sp].level = p1[i].level;
+			scratch[sp].token.operatr = p1[i].token.operatr;
+			sp++;
+		}
+	}
+	if (!check_calls((token_type *) p1, n)) {
+		error(_("Invalid function call in expression."));
+		return false;
+	}
+	return true;
+}
+
+/** 3
+ * matho_get_expr - Get an equation space as a token array, without copying
+ * Get one side of the expression or equation stored in equation space number "en" (origin 0),
+ * as a pointer to Mathomatic's own token array for it, which is stored in "*tokensp",
+ * and its length in tokens, which is stored in "*np".
+ * "side" is 0 for the left-hand side and 1 for the right-hand side.
+ * The right-hand side has zero length if the equation space holds an expression, not an equation.
+ *
+ * The token array is read-only and only valid until the equation space is next changed,
+ * by any call to matho_process(3), matho_parse(3), matho_set_expr(3), or matho_clear(3).
+ * The tokens are in Mathomatic internal format, described in "mathomatic.h".
+ * Use matho_var_name(3) to get the names of variables.
+ *
+ * Returns true if successful, false if the equation space is empty or doesn't exist.
+ */
+int
+matho_get_expr(int en, int side, const matho_token **tokensp, int *np)
+{
+	*tokensp = NULL;
+	*np = 0;
+	if (empty_equation_space(en))
+		return false;
+	if (side) {
+		*tokensp = (const matho_token *) rhs[en];
+		*np = n_rhs[en];
+	} else {
+		*tokensp = (const matho_token *) lhs[en];
+		*np = n_lhs[en];
+	}
+	return true;
+}
+
+/** 3
+ * matho_set_expr - Store token arrays in an equation space, without parsing
+ * Store the expression with "n_lhs_tokens" tokens at "lhs_tokens"
+ * into equation space number "en" (origin 0), replacing what was there,
+ * and make it the current equation.
+ * If "n_rhs_tokens" is greater than zero, "rhs_tokens" is stored as the right-hand side,
+ * making it an equation; otherwise "rhs_tokens" may be NULL.
+ * If "en" is negative, the next empty equation space is used.
+ *
+ * The tokens must be in Mathomatic internal format, as described in "mathomatic.h".
+ * They are checked, copied, and have their parentheses tidied,
+ * but are not simplified; use matho_process(3) to operate on them.
+ * Use matho_var(3) to get the number of a variable from its name.
+ *
+ * Returns the equation space number stored into if successful,
+ * otherwise -1 with an error message in "error_str".
+ */
+int
+matho_set_expr(int en, const matho_token *lhs_tokens, int n_lhs_tokens, const matho_token *rhs_tokens, int n_rhs_tokens)
+{
+	error_str = NULL;
+	warning_str = NULL;
+	if (setjmp(jmp_save) != 0) {
+		clean_up();
+		if (error_str == NULL)
+			error(_("Processing was interrupted."));
+		return -1;
+	}
+	if (!check_tokens(lhs_tokens, n_lhs_tokens)
+	    || (n_rhs_tokens > 0 && !check_tokens(rhs_tokens, n_rhs_tokens))) {
+		return -1;
+	}
+	if (en < 0) {
+		en = next_espace();
+	} else if (!alloc_to_espace(en)) {
+		error(_("Equation space number out of range."));
+		return -1;
+	}
+	blt(lhs[en], lhs_tokens, n_lhs_tokens * sizeof(token_type));
+	n_lhs[en] = n_lhs_tokens;
+	organize(lhs[en], &n_lhs[en]);
+	n_rhs[en] = 0;
+	if (n_rhs_tokens > 0) {
+		blt(rhs[en], rhs_tokens, n_rhs_tokens * sizeof(token_type));
+		n_rhs[en] = n_rhs_tokens;
+		organize(rhs[en], &n_rhs[en]);
+	}
+	cur_equation = en;
+	return en;
+}
+
+/** 3
+ * matho_var - Get the number of a variable, given its name
+ * Convert the variable name string "name" to the Mathomatic variable number used in matho_token,
+ * creating the variable if it is new.
+ * Special variables like "pi", "e", and "i" are also converted.
+ *
+ * Returns the variable number, or 0 if "name" is not a valid variable name.
+ */
+long
+matho_var(const char *name)
+{
+	long	v = V_NULL;
+	char	*cp;
+
+	error_str = NULL;
+	if (setjmp(jmp_save) != 0) {
+		return V_NULL;
+	}
+	cp = parse_var(&v, (char *) name);
+	if (cp == NULL || *cp) {
+		return V_NULL;
+	}
+	return v;
+}
+
+/** 3
+ * matho_var_name - Get the name of a variable, given its number
+ * Convert the Mathomatic variable number "v", as used in matho_token, to its name string.
+ *
+ * Returns a pointer to the name, which is overwritten by the next call,
+ * so copy it if you need to keep it.
+ */
+const char *
+matho_var_name(long v)
+{
+	list_var(v, 0);
+	return var_str;
+}
+
+/*
+ * A prepared expression, compiled once by matho_prepare() for evaluating many times.
+ * Everything needed for evaluation is allocated here, so evaluation allocates nothing.
+ */
+struct matho_prepared {
+	code_type	*code;		/* compiled instructions */
+	int		ncode;		/* number of instructions in code[] */
+	int		nslots;		/* number of variable slots */
+	long		*vars;		/* variable in each slot, then the imaginary unit if used */
+	char		**names;	/* name of the variable in each slot */
+	int		imaginary;	/* slot number of the imaginary unit, or -1 if not used */
+	double		*values;	/* real part of the value bound to each slot */
+	complexs	*cvalues;	/* complex value bound to each slot */
+	double		*stack;		/* real evaluation stack */
+	complexs	*cstack;	/* complex evaluation stack */
+};
+
+/** 3
+ * matho_prepare - Compile an equation space for fast numerical evaluation
+ * Simplify the expression in equation space number "en" (origin 0) once,
+ * and compile it for evaluating many times with matho_eval(3) or matho_eval_complex(3).
+ * If the equation space holds an equation, like a solved equation "y = ...",
+ * its right-hand side is compiled.
+ *
+ * Each variable in the expression gets a numbered slot, origin 0, to bind its value to
+ * with matho_bind(3); use matho_slot(3) to find the slot of a variable by name.
+ * All slots start out bound to zero.
+ * The constants e, pi, and i are built in and don't have slots.
+ *
+ * The prepared expression doesn't depend on the equation space afterwards,
+ * and is still usable after matho_clear(3).
+ * Free it with matho_unprepare(3) when done.
+ *
+ * Returns the prepared expression if successful,
+ * otherwise NULL with an error message in "error_str".
+ */
+matho_prepared *
+matho_prepare(int en)
+{
+	matho_prepared	*pp;
+	token_type	*source;
+	int		i, j, n;
+
+	error_str = NULL;
+	warning_str = NULL;
+	if (empty_equation_space(en)) {
+		error(_("Equation space is empty."));
+		return NULL;
+	}
+	if ((pp = (matho_prepared *) calloc(1, sizeof(matho_prepared))) == NULL) {
+		error(_("Out of memory (can't malloc(3))."));
+		return NULL;
+	}
+	if (setjmp(jmp_save) != 0) {
+		clean_up();
+		if (error_str == NULL)
+			error(_("Processing was interrupted."));
+		matho_unprepare(pp);
+		return NULL;
+	}
+	if (n_rhs[en]) {
+		source = rhs[en];
+		n = n_rhs[en];
+	} else {
+		source = lhs[en];
+		n = n_lhs[en];
+	}
+	blt(tes, source, n * sizeof(token_type));
+	subst_constants(tes, &n);
+	approximate_roots = true;
+	simp_loop(tes, &n);
+	approximate_roots = false;
+	pp->imaginary = -1;
+	pp->vars = (long *) malloc((n + 1) * sizeof(long));
+	pp->names = (char **) calloc(n + 1, sizeof(char *));
+	pp->code = (code_type *) malloc(n * sizeof(code_type));
+	if (pp->vars == NULL || pp->names == NULL || pp->code == NULL) {
+		error(_("Out of memory (can't malloc(3))."));
+		longjmp(jmp_save, 2);
+	}
+	for (i = 0; i < n; i += 2) {
+		if (tes[i].kind != VARIABLE || var_is_const(tes[i].token.variable, NULL)
+		    || tes[i].token.variable == IMAGINARY)
+			continue;
+		for (j = 0; j < pp->nslots; j++) {
+			if (pp->vars[j] == tes[i].token.variable)
+				break;
+		}
+		if (j >= pp->nslots) {
+			pp->vars[pp->nslots] = tes[i].token.variable;
+			list_var(pp->vars[pp->nslots], 0);
+			if ((pp->names[pp->nslots++] = strdup(var_str)) == NULL) {
+				error(_("Out of memory (can't malloc(3))."));
+				longjmp(jmp_save, 2);
+			}
+		}
+	}
+	for (i = 0; i < n; i += 2) {
+		if (tes[i].kind == VARIABLE && tes[i].token.variable == IMAGINARY) {
+			pp->imaginary = pp->nslots;
+			pp->vars[pp->nslots] = IMAGINARY;
+			break;
+		}
+	}
+	pp->ncode = compile_numeric(tes, n, pp->vars, pp->nslots + (pp->imaginary >= 0), pp->code);
+	if (pp->ncode <= 0) {
+		error(_("Expression can't be compiled."));
+		longjmp(jmp_save, 2);
+	}
+	pp->values = (double *) calloc(pp->nslots + 1, sizeof(double));
+	pp->cvalues = (complexs *) calloc(pp->nslots + 1, sizeof(complexs));
+	pp->stack = (double *) malloc(pp->ncode * sizeof(double));
+	pp->cstack = (complexs *) malloc(pp->ncode * sizeof(complexs));
+	if (pp->values == NULL || pp->cvalues == NULL || pp->stack == NULL || pp->cstack == NULL) {
+		error(_("Out of memory (can't malloc(3))."));
+		longjmp(jmp_save, 2);
+	}
+	if (pp->imaginary >= 0) {
+		pp->cvalues[pp->imaginary].im = 1.0;
+	}
+	return pp;
+}
+
+/** 3
+ * matho_slot - Find the slot of a variable in a prepared expression
+ * Look up the variable named "name" in prepared expression "pp".
+ *
+ * Returns its slot number (origin 0) for matho_bind(3),
+ * or -1 if the prepared expression doesn't contain that variable.
+ */
+int
+matho_slot(matho_prepared *pp, const char *name)
+{
+	int	i;
+
+	for (i = 0; i < pp->nslots; i++) {
+		if (strcmp(pp->names[i], name) == 0)
+			return i;
+	}
+	return -1;
+}
+
+/** 3
+ * matho_slot_name - Get the name of the variable in a slot of a prepared expression
+ * Returns the name of the variable in slot number "slot" (origin 0)
+ * of prepared expression "pp", or NULL if there is no such slot.
+ * To list all variables, call this with slot numbers counting up from 0 until it returns NULL.
+ */
+const char *
+matho_slot_name(matho_prepared *pp, int slot)
+{
+	if (slot < 0 || slot >= pp->nslots)
+		return NULL;
+	return pp->names[slot];
+}
+
+/** 3
+ * matho_bind - Set the value of a variable in a prepared expression
+ * Bind the complex number value "re" + "im"*i to slot number "slot" (origin 0)
+ * of prepared expression "pp", for the following evaluations.
+ * For real numbers, "im" is 0.
+ *
+ * Returns true if successful, false if there is no such slot.
+ */
+int
+matho_bind(matho_prepared *pp, int slot, double re, double im)
+{
+	if (slot < 0 || slot >= pp->nslots)
+		return false;
+	pp->values[slot] = re;
+	pp->cvalues[slot].re = re;
+	pp->cvalues[slot].im = im;
+	return true;
+}
+
+/** 3
+ * matho_eval - Evaluate a prepared expression with real numbers
+ * Calculate prepared expression "pp" with the values currently bound to its slots,
+ * storing the result in "*resultp".
+ * Nothing is parsed, simplified, or allocated.
+ *
+ * Returns true if successful.  Returns false if any bound value is not real,
+ * or if the result can't be calculated with real numbers, like an imaginary root;
+ * use matho_eval_complex(3) for those.
+ */
+int
+matho_eval(matho_prepared *pp, double *resultp)
+{
+	int	i;
+	int	rv;
+
+	if (pp->imaginary >= 0)
+		return false;
+	for (i = 0; i < pp->nslots; i++) {
+		if (pp->cvalues[i].im != 0.0)
+			return false;
+	}
+	if (setjmp(jmp_save) != 0) {
+		approximate_roots = false;
+		return false;
+	}
+	approximate_roots = true;
+	rv = eval_numeric(pp->code, pp->ncode, pp->values, pp->stack, resultp);
+	approximate_roots = false;
+	return rv;
+}
+
+/** 3
+ * matho_eval_complex - Evaluate a prepared expression with complex numbers
+ * Calculate prepared expression "pp" with the complex values currently bound to its slots,
+ * storing the real part of the result in "*rep" and the imaginary part in "*imp".
+ * Nothing is parsed, simplified, or allocated.
+ *
+ * Returns true if successful.
+ */
+int
+matho_eval_complex(matho_prepared *pp, double *rep, double *imp)
+{
+	int		rv;
+	complexs	c;
+
+	if (setjmp(jmp_save) != 0) {
+		approximate_roots = false;
+		return false;
+	}
+	approximate_roots = true;
+	rv = eval_complex(pp->code, pp->ncode, pp->cvalues, pp->cstack, &c);
+	approximate_roots = false;
+	if (rv) {
+		*rep = c.re;
+		*imp = c.im;
+	}
+	return rv;
+}
+
+/** 3
+ * matho_unprepare - Free a prepared expression
+ * Free all memory used by prepared expression "pp", which was returned by matho_prepare(3).
+ */
+void
+matho_unprepare(matho_prepared *pp)
+{
+	int	i;
+
+	if (pp == NULL)
+		return;
+	if (pp->names) {
+		for (i = 0; i < pp->nslots; i++) {
+			free(pp->names[i]);
+		}
+		free(pp->names);
+	}
+	free(pp->vars);
+	free(pp->code);
+	free(pp->values);
+	free(pp->cvalues);
+	free(pp->stack);
+	free(pp->cstack);
+	free(pp);
+}
+
 /*
  * Floating point exception handler.
  * Usually doesn't work in most operating systems, so just ignore it.
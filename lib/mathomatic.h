@@ -4,8 +4,102 @@
 
 extern int matho_init(void);				/* one-time Mathomatic initialization */
 extern int matho_process(char *input, char **outputp);	/* Mathomatic command or expression input */
+extern int matho_process_buf(char *input, char *outbuf, int size);	/* same, with output copied to outbuf[size] */
 extern int matho_parse(char *input, char **outputp);	/* Mathomatic expression or equation input */
 extern void matho_clear(void);				/* Restart Mathomatic quickly and cleanly, replaces clear_all(). */
+extern void matho_set_cancel(volatile int *flagp);	/* cancel processing when *flagp is set non-zero, from any thread */
+extern void matho_set_progress(int (*callback)(const char *where, long count, void *data), void *data);	/* report progress of long operations */
+extern const char *matho_counters_json(int reset_flag);	/* hot-path instrumentation counters as a JSON string */
+extern const char *matho_command_stats_json(int reset_flag);	/* per-command latency histograms and memory high-water marks as a JSON string */
+
+/*
+ * Typed API, for reading and writing equation spaces as token arrays without string conversion.
+ * An expression is an array of tokens, alternating operands (constants and variables) and operators,
+ * starting and ending with an operand.  So its length is always odd.
+ * Each token has a level of parentheses, origin 1; each operator's level must be less than or equal to
+ * its neighbor operands' levels, and operators of different precedence must be on different levels.
+ * For example, "a*(b+c)" is: a(level 1) TIMES(1) b(2) PLUS(2) c(2).
+ * The factorial operator has a dummy constant operand on its right, so "x!" is: x(1) FACTORIAL(1) 1(1).
+ * A function call is the dummy constant 1 followed by each argument, each preceded by the
+ * function call operator, all on their own level of parentheses, so "sin(x)" is: 1(2) F(2) x(2),
+ * where F is MATHO_FUNC_OP(MATHO_SIN); an argument that is not a single operand goes one level deeper.
+ */
+#define	MATHO_CONSTANT	0	/* matho_token kinds */
+#define	MATHO_VARIABLE	1
+#define	MATHO_OPERATOR	2
+
+#define	MATHO_PLUS	1	/* a + b, matho_token operators */
+#define	MATHO_MINUS	2	/* a - b */
+#define	MATHO_TIMES	4	/* a * b */
+#define	MATHO_DIVIDE	5	/* a / b */
+#define	MATHO_MODULUS	6	/* a % b */
+#define	MATHO_IDIVIDE	7	/* a // b */
+#define	MATHO_POWER	8	/* a ^ b */
+#define	MATHO_FACTORIAL	9	/* a! */
+#define	MATHO_FUNCTION	10	/* f(a), see MATHO_FUNC_OP() */
+
+#define	MATHO_FUNC_OP(fn)	(MATHO_FUNCTION + ((fn) << 8))	/* function call operator of function number "fn" */
+
+#define	MATHO_LOG	4	/* function numbers of the functions that are kept as calls */
+#define	MATHO_LOG10	5
+#define	MATHO_SIN	6
+#define	MATHO_COS	7
+#define	MATHO_TAN	8
+#define	MATHO_ASIN	9
+#define	MATHO_ACOS	10
+#define	MATHO_ATAN	11
+#define	MATHO_SINH	12
+#define	MATHO_COSH	13
+#define	MATHO_TANH	14
+#define	MATHO_ASINH	15
+#define	MATHO_ACOSH	16
+#define	MATHO_ATANH	17
+#define	MATHO_FIRST_USER_FUNC	64	/* user-defined functions are numbered from here, in order of definition */
+
+typedef struct {		/* one token of an expression, laid out exactly like Mathomatic's internal token_type */
+	int	kind;		/* MATHO_CONSTANT, MATHO_VARIABLE, or MATHO_OPERATOR */
+	int	level;		/* level of parentheses, origin 1 */
+	union {
+		double	constant;	/* value of a MATHO_CONSTANT */
+		long	variable;	/* variable number of a MATHO_VARIABLE, from matho_var() */
+		int	operatr;	/* operator of a MATHO_OPERATOR */
+	} token;
+} matho_token;
+
+extern int matho_get_expr(int en, int side, const matho_token **tokensp, int *np);	/* read an equation space side without copying */
+extern int matho_set_expr(int en, const matho_token *lhs_tokens, int n_lhs_tokens, const matho_token *rhs_tokens, int n_rhs_tokens);	/* store tokens in an equation space */
+extern long matho_var(const char *name);		/* variable name to variable number */
+extern const char *matho_var_name(long v);		/* variable number to variable name */
+
+/*
+ * Prepared expression API, for evaluating a formula many times with different variable values.
+ */
+typedef struct matho_prepared matho_prepared;		/* a compiled expression, contents private */
+
+extern matho_prepared *matho_prepare(int en);		/* simplify and compile an equation space once */
+extern int matho_slot(matho_prepared *pp, const char *name);	/* variable name to slot number */
+extern const char *matho_slot_name(matho_prepared *pp, int slot);	/* slot number to variable name */
+extern int matho_bind(matho_prepared *pp, int slot, double re, double im);	/* set the value of a slot */
+extern int matho_eval(matho_prepared *pp, double *resultp);	/* evaluate with real numbers */
+extern int matho_eval_complex(matho_prepared *pp, double *rep, double *imp);	/* evaluate with complex numbers */
+extern void matho_unprepare(matho_prepared *pp);	/* free a prepared expression */
+
+/*
+ * Asynchronous API in "async.c", for event loops; requires linking with -lpthread.
+ * Requests are processed in order by one worker thread, since the engine is not re-entrant.
+ */
+typedef struct {
+	long	id;		/* request id returned by matho_submit() */
+	int	rv;		/* matho_process() return value, true if successful */
+	char	*output;	/* malloc()ed output or error message string, or NULL; free() after use */
+	void	*data;		/* caller's pointer given to matho_submit() */
+} matho_completion;
+
+extern int matho_async_start(void);			/* start the worker thread, returns a file descriptor readable when completions are waiting */
+extern long matho_submit(const char *input, void *data);	/* queue a command or expression, returns the request id */
+extern int matho_complete(matho_completion *cp);	/* get the next completion without blocking, returns true if got one */
+extern int matho_cancel_request(long id);		/* cancel a queued or running request */
+extern void matho_async_stop(void);			/* finish all requests and stop the worker thread */
 
 extern void free_mem(void);	/* Free all allocated memory before quitting Mathomatic, if operating system doesn't when done. */
 				/* Mathomatic becomes unusable after free_mem(), until matho_init() is called again. */
@@ -23,3 +117,4 @@ extern int result_en;		/* Equation number of the API's returned result, */
 				/* to act on it with further commands. */
 
 extern const char *warning_str;	/* optional warning message generated by the last command */
+extern const char *error_str;	/* error message generated by the last failed call */
@@ -0,0 +1,111 @@
+/*
+ * Parser benchmark for the Mathomatic symbolic math library.
+ * Times parsing of generated expressions from 1/8 megabyte to 2 megabytes long,
+ * to show that parsing takes time linear with the length of the input.
+ * The seconds per megabyte should stay about the same as the size doubles.
+ * Only the parser is timed; simplifying and displaying such large expressions is much slower.
+ *
+ * Usage: ./parsebench [ kind ]
+ * where kind is "sum", "product", or "negate"; the default is to do all three.
+ */
+
+#include "../includes.h"
+#include "mathomatic.h"
+#include <time.h>
+
+#define	MAX_SIZE	(2L * 1024L * 1024L)	/* largest input string to parse, in bytes */
+
+static char	*kinds[] = { "sum", "product", "negate", NULL };
+
+static double
+seconds(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1.0e9;
+}
+
+/*
+ * Generate a "kind" of expression string about "size" bytes long in "buf".
+ */
+static void
+generate(char *buf, long size, char *kind)
+{
+	char	*cp;
+	long	i;
+
+	*buf = '\0';
+	for (cp = buf, i = 0; cp - buf < size; i++) {
+		if (strcmp(kind, "sum") == 0) {
+			cp += sprintf(cp, "%s%ld*a%ld^2", (i ? "+" : ""), i, i % 50);
+		} else if (strcmp(kind, "product") == 0) {
+			cp += sprintf(cp, "%sa%ld", (i ? "*" : ""), i % 50);
+		} else {
+			cp += sprintf(cp, "%s-a%ld", (i ? "*" : ""), i % 50);
+		}
+	}
+}
+
+static int
+bench(char *kind)
+{
+	char	*buf;
+	long	size;
+	int	n;
+	double	start, elapsed;
+
+	if ((buf = (char *) malloc(MAX_SIZE + 100)) == NULL) {
+		fprintf(stderr, "Not enough memory.\n");
+		return false;
+	}
+	for (size = MAX_SIZE / 16; size <= MAX_SIZE; size *= 2) {
+		generate(buf, size, kind);
+		if (setjmp(jmp_save) != 0) {
+			printf("%-8s %8ld bytes: failed\n", kind, (long) strlen(buf));
+			continue;
+		}
+		start = seconds();
+		if (parse_expr(tlhs, &n, buf, true) == NULL) {
+			printf("%-8s %8ld bytes: parse error\n", kind, (long) strlen(buf));
+			continue;
+		}
+		elapsed = seconds() - start;
+		printf("%-8s %8ld bytes %8d tokens %8.3f seconds %8.3f seconds/MB\n",
+		    kind, (long) strlen(buf), n, elapsed, elapsed / (strlen(buf) / (1024.0 * 1024.0)));
+	}
+	free(buf);
+	return true;
+}
+
+int
+main(int argc, char **argv)
+{
+	int	i, j;
+
+	n_tokens = MAX_SIZE + 1000;	/* every input byte can be a token, plus "-" makes two */
+	if (!matho_init()) {
+		fprintf(stderr, "Not enough memory.\n");
+		exit(1);
+	}
+	if (argc > 1) {
+		for (i = 1; i < argc; i++) {
+			for (j = 0; kinds[j]; j++) {
+				if (strcmp(argv[i], kinds[j]) == 0)
+					break;
+			}
+			if (kinds[j] == NULL) {
+				fprintf(stderr, "Unknown kind of expression: %s\n", argv[i]);
+				exit(2);
+			}
+			if (!bench(kinds[j]))
+				exit(1);
+		}
+	} else {
+		for (i = 0; kinds[i]; i++) {
+			if (!bench(kinds[i]))
+				exit(1);
+		}
+	}
+	exit(0);
+}
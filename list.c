@@ -63,8 +63,19 @@ static int	carray[] = {
 #define	EQUATE_STRING	" = "	/* string displayed between the LHS and RHS of equations */
 #define MODULUS_STRING	" % "	/* string displayed for the modulus operator */
 
-static int flist_sub(token_type *p1, int n, int out_flag, char *string, int sbuffer_size, int pos, int *highp, int *lowp);
-static int flist_recurse(token_type *p1, int n, int out_flag, char *string, int sbuffer_size, int line, int pos, int cur_level, int *highp, int *lowp);
+typedef struct {		/* growable output string, for building output text in one pass */
+	char	*str;		/* allocated null-terminated string, or NULL if out of memory */
+	int	len;		/* current length of the string */
+	int	size;		/* allocated size of str */
+} string_buffer_type;
+
+static string_buffer_type reuse_sb;	/* the buffer reused by list_equation_reuse() */
+
+static int list_string_sb(token_type *p1, int n, int outflag, string_buffer_type *sb, int export_flag);
+static int list_expanded_call(token_type *p1, int n, int outflag, string_buffer_type *sb, int export_flag);
+static int list_code_sb(token_type *equation, int *np, int outflag, string_buffer_type *sb, enum language_list language, int int_flag);
+static int flist_sub(token_type *p1, int n, int out_flag, int pos, int *highp, int *lowp);
+static int flist_recurse(token_type *p1, int n, int out_flag, int line, int pos, int cur_level, int *highp, int *lowp);
 
 /* Bright HTML color array. */
 /* Used when HTML output and "set color" and "set bold" options are enabled. */
@@ -235,25 +246,183 @@ display_all_colors(void)
 }
 
 /*
- * Trim the trailing zeros from a string, after the decimal point.
+ * If "d" is a whole number with less than 16 digits, which most constants are,
+ * store it as a decimal integer string in "buf" (at least 18 characters long).
+ *
+ * Return the number of digits, or 0 if "d" is not such a whole number.
  */
-static void
-trim_zeros(buf)
+static int
+integer_string(buf, d)
 char	*buf;
+double	d;
 {
-	int	j;
+	char	tmp[20];
+	char	*cp;
+	double	high;
+	long	hi, lo;
+	int	digits = 0;
+	int	neg;
 
-	j = strlen(buf) - 1;
-	for (; j >= 0; j--) {
-		if (buf[j] == '0')
-			continue;
-		if (buf[j] == '.') {
-			if (buf[j+1])
-				buf[j+2] = '\0';
-		} else {
-			break;
+	if (!(d > -MAX_K_INTEGER && d < MAX_K_INTEGER) || d != floor(d))
+		return 0;
+	neg = (d < 0.0);
+	d = fabs(d);
+	high = floor(d / 1.0e8);	/* split in two, so each part fits in a long */
+	hi = (long) high;
+	lo = (long) (d - high * 1.0e8);
+	cp = &tmp[sizeof(tmp)-1];
+	*cp = '\0';
+	do {
+		*--cp = '0' + (lo % 10);
+		lo /= 10;
+		digits++;
+	} while (lo > 0 || (hi > 0 && digits < 8));
+	for (; hi > 0; hi /= 10) {
+		*--cp = '0' + (hi % 10);
+		digits++;
+	}
+	if (neg)
+		*--cp = '-';
+	strcpy(buf, cp);
+	return digits;
+}
+
+/*
+ * Store constant "d" in "buf", exactly like snprintf(buf, size, "%.*g", digits, d),
+ * only faster for whole numbers.
+ *
+ * Return the length of the string.
+ */
+static int
+format_constant(buf, size, digits, d)
+char	*buf;
+int	size, digits;
+double	d;
+{
+	int	i;
+
+	if (size >= 18 && (i = integer_string(buf, d)) > 0 && i <= digits)
+		return strlen(buf);
+	return snprintf(buf, size, "%.*g", digits, d);
+}
+
+/*
+ * Store the shortest decimal string that reads back as exactly "d" in "buf",
+ * so exported and saved constants lose nothing.
+ * If "float_flag" is true, make sure the result is a floating point constant
+ * in programming languages, by appending ".0" to whole numbers.
+ *
+ * Return the length of the string.
+ */
+static int
+format_exact(buf, size, d, float_flag)
+char	*buf;
+int	size;
+double	d;
+int	float_flag;
+{
+	int	digits;
+	int	len;
+
+	if (size >= 20 && integer_string(buf, d) > 0) {
+		len = strlen(buf);
+	} else {
+		/* "%g" drops trailing zeros, so only denormal numbers can need fewer than DBL_DIG digits. */
+		for (digits = ((fabs(d) < DBL_MIN) ? 1 : DBL_DIG); digits < 17; digits++) {
+			len = snprintf(buf, size, "%.*g", digits, d);
+			if (fast_strtod(buf, NULL) == d)
+				break;
+		}
+		if (digits >= 17) {
+			len = snprintf(buf, size, "%.17g", d);
+		}
+	}
+	if (float_flag && isfinite(d) && strpbrk(buf, ".e") == NULL && len + 2 < size) {
+		strcpy(&buf[len], ".0");
+		len += 2;
+	}
+	return len;
+}
+
+/*
+ * Start an empty growable output string.
+ */
+static void
+sb_init(sb)
+string_buffer_type	*sb;
+{
+	sb->len = 0;
+	sb->size = 256;
+	if ((sb->str = (char *) mem_alloc(sb->size, MEM_STRINGS)) != NULL)
+		sb->str[0] = '\0';
+}
+
+/*
+ * Free a growable output string.
+ */
+static void
+sb_free(sb)
+string_buffer_type	*sb;
+{
+	mem_free(sb->str, sb->size, MEM_STRINGS);
+	sb->str = NULL;
+}
+
+/*
+ * Append "len" characters of "str" to a growable output string,
+ * doubling its allocated size when full, so building a string of any length takes linear time.
+ */
+static void
+sb_append_len(sb, str, len)
+string_buffer_type	*sb;
+char			*str;
+int			len;
+{
+	char	*cp;
+	int	new_size;
+
+	if (sb->str == NULL)
+		return;
+	if (sb->len + len >= sb->size) {
+		for (new_size = sb->size; sb->len + len >= new_size;)
+			new_size *= 2;
+		if ((cp = (char *) mem_realloc(sb->str, sb->size, new_size, MEM_STRINGS)) == NULL) {
+			sb_free(sb);
+			return;
 		}
+		sb->str = cp;
+		sb->size = new_size;
 	}
+	memcpy(&sb->str[sb->len], str, len);
+	sb->len += len;
+	sb->str[sb->len] = '\0';
+}
+
+static void
+sb_append(sb, str)
+string_buffer_type	*sb;
+char			*str;
+{
+	sb_append_len(sb, str, strlen(str));
+}
+
+/*
+ * Return the finished string of a growable output string,
+ * which should be freed with free() when done.
+ * It is no longer counted by the memory accounting.
+ *
+ * Return NULL with an error message if memory ran out while building it.
+ */
+static char *
+sb_finish(sb)
+string_buffer_type	*sb;
+{
+	if (sb->str == NULL) {
+		error(_("Out of memory (can't malloc(3))."));
+	} else {
+		mem_disown(sb->size, MEM_STRINGS);
+	}
+	return sb->str;
 }
 
 /*
@@ -507,7 +676,7 @@ int		n;		/* length of expression */
 int		export_flag;	/* flag for exportable format (usually false) */
 				/* 1 for Maxima, 2 for other, 3 for gnuplot, 4 for hexadecimal */
 {
-	return list_string_sub(p1, n, true, NULL, export_flag);
+	return list_string_sb(p1, n, true, NULL, export_flag);
 }
 
 /*
@@ -521,31 +690,65 @@ list_equation(n, export_flag)
 int	n;		/* equation space number */
 int	export_flag;	/* flag for exportable format (usually false) */
 {
-	int	len;
-	char	*cp;
+	string_buffer_type	sb;
 
 	if (empty_equation_space(n))
 		return NULL;
-	len = list_string(lhs[n], n_lhs[n], NULL, export_flag);
+	sb_init(&sb);
+	list_string_sb(lhs[n], n_lhs[n], false, &sb, export_flag);
 	if (n_rhs[n]) {
-		len += strlen(EQUATE_STRING);
-		len += list_string(rhs[n], n_rhs[n], NULL, export_flag);
+		sb_append(&sb, EQUATE_STRING);
+		list_string_sb(rhs[n], n_rhs[n], false, &sb, export_flag);
 	}
-	len += 2;	/* for possible semicolon and terminating null character */
-	cp = (char *) malloc(len);
-	if (cp == NULL) {
-		error(_("Out of memory (can't malloc(3))."));
+	if (export_flag == 1) {
+		sb_append(&sb, ";");
+	}
+	return sb_finish(&sb);
+}
+
+/*
+ * Same as list_equation(), except the string is built in a buffer that is reused by the next call,
+ * so no memory is allocated once the buffer has grown big enough.
+ * The string must not be freed, and is only valid until the next call.
+ *
+ * Returns text string, or NULL if error.
+ */
+char *
+list_equation_reuse(n, export_flag)
+int	n;		/* equation space number */
+int	export_flag;	/* flag for exportable format (usually false) */
+{
+	if (empty_equation_space(n))
 		return NULL;
+	if (reuse_sb.str == NULL) {
+		sb_init(&reuse_sb);
+	} else {
+		reuse_sb.len = 0;
+		reuse_sb.str[0] = '\0';
 	}
-	list_string(lhs[n], n_lhs[n], cp, export_flag);
+	list_string_sb(lhs[n], n_lhs[n], false, &reuse_sb, export_flag);
 	if (n_rhs[n]) {
-		strcat(cp, EQUATE_STRING);
-		list_string(rhs[n], n_rhs[n], &cp[strlen(cp)], export_flag);
+		sb_append(&reuse_sb, EQUATE_STRING);
+		list_string_sb(rhs[n], n_rhs[n], false, &reuse_sb, export_flag);
 	}
 	if (export_flag == 1) {
-		strcat(cp, ";");
+		sb_append(&reuse_sb, ";");
 	}
-	return cp;
+	if (reuse_sb.str == NULL) {	/* not handed to the caller, so still counted */
+		error(_("Out of memory (can't malloc(3))."));
+	}
+	return reuse_sb.str;
+}
+
+/*
+ * Return true if "cp" is the reused string returned by list_equation_reuse(),
+ * which must not be freed.
+ */
+int
+reused_string(cp)
+char	*cp;
+{
+	return(cp != NULL && cp == reuse_sb.str);
 }
 
 /*
@@ -560,21 +763,14 @@ token_type	*p1;		/* expression pointer */
 int		n;		/* length of expression */
 int		export_flag;
 {
-	int	len;
-	char	*cp;
+	string_buffer_type	sb;
 
 	if (n <= 0) {
 		return NULL;
 	}
-	len = list_string(p1, n, NULL, export_flag);
-	len++;	/* for terminating null character */
-	cp = (char *) malloc(len);
-	if (cp == NULL) {
-		error(_("Out of memory (can't malloc(3))."));
-		return NULL;
-	}
-	list_string(p1, n, cp, export_flag);
-	return cp;
+	sb_init(&sb);
+	list_string_sb(p1, n, false, &sb, export_flag);
+	return sb_finish(&sb);
 }
 
 /*
@@ -595,8 +791,7 @@ int		export_flag;
 	return list_string_sub(p1, n, false, string, export_flag);
 }
 
-#define	APPEND(str)	{ if (string) { strcpy(&string[len], str); } if (outflag) { fprintf(gfp, "%s", str); } len += strlen(str); }
-#define	APPEND2(str)	{ if (string) { if ((sbuffer_size - current_len) > 0) my_strlcpy(&string[current_len], str, sbuffer_size - current_len); } else { fprintf(gfp, "%s", str); } current_len += strlen(str); }
+#define	APPEND(str)	{ if (sb) { sb_append(sb, str); } if (outflag) { fprintf(gfp, "%s", str); } len += strlen(str); }
 
 int
 list_string_sub(p1, n, outflag, string, export_flag)
@@ -606,6 +801,68 @@ int		outflag;	/* if true, output to gfp */
 char		*string;	/* buffer to save output to or NULL pointer */
 int		export_flag;	/* flag for exportable format (usually false) */
 				/* 1 for Maxima, 2 for other, 3 for gnuplot, 4 for hexadecimal */
+{
+	string_buffer_type	sb;
+	int			len;
+
+	if (string == NULL)
+		return list_string_sb(p1, n, outflag, NULL, export_flag);
+	sb_init(&sb);
+	len = list_string_sb(p1, n, outflag, &sb, export_flag);
+	if (sb_finish(&sb) == NULL) {
+		string[0] = '\0';
+		return 0;
+	}
+	memcpy(string, sb.str, sb.len + 1);
+	free(sb.str);
+	return len;
+}
+
+/*
+ * List the user-defined function call "p1" of length "n" as its parenthesized expansion,
+ * with any calls in it expanded too, for list_string_sb().
+ *
+ * Return length (number of characters).
+ */
+static int
+list_expanded_call(p1, n, outflag, sb, export_flag)
+token_type		*p1;
+int			n;
+int			outflag;
+string_buffer_type	*sb;
+int			export_flag;
+{
+	token_type	*buf;
+	int		len = 0;
+
+	if ((buf = (token_type *) mem_alloc(n_tokens * sizeof(token_type), MEM_TEMP)) == NULL) {
+		error(_("Out of memory (can't malloc(3))."));
+		longjmp(jmp_save, 2);
+	}
+	blt(buf, p1, n * sizeof(token_type));
+	expand_user_calls(buf, &n, 0L);
+	APPEND("(");
+	len += list_string_sb(buf, n, outflag, sb, export_flag);
+	APPEND(")");
+	mem_free(buf, n_tokens * sizeof(token_type), MEM_TEMP);
+	return len;
+}
+
+/*
+ * Convert an expression to single-line format,
+ * appending it to growable string "sb" if "sb" is not NULL,
+ * and displaying it if "outflag" is true.
+ *
+ * Return length (number of characters).
+ */
+static int
+list_string_sb(p1, n, outflag, sb, export_flag)
+token_type		*p1;		/* expression pointer */
+int			n;		/* length of expression */
+int			outflag;	/* if true, output to gfp */
+string_buffer_type	*sb;		/* growable string to append output to, or NULL */
+int			export_flag;	/* flag for exportable format (usually false) */
+					/* 1 for Maxima, 2 for other, 3 for gnuplot, 4 for hexadecimal */
 {
 	int	i, j, k, i1;
 	int	min1;
@@ -613,20 +870,54 @@ int		export_flag;	/* flag for exportable format (usually false) */
 	char	*cp;
 	int	len = 0;
 	char	buf[500], buf2[500];
-	int	export_precision;
 	int	cflag, power_flag;
 
 	cflag = (outflag && (export_flag == 0 || export_flag == 4));
 	if (cflag)
 		set_color(0);
-	if (string)
-		string[0] = '\0';
-	if (high_prec)
-		export_precision = 20;
-	else
-		export_precision = DBL_DIG;
 	cur_level = min1 = min_level(p1, n);
 	for (i = 0; i < n; i++) {
+		if (is_call(p1, n, i)) {
+/* a function call is listed as its name followed by its parenthesized arguments, like "f(a, b)" */
+			j = cur_level - max(p1[i].level - 1, min1);
+			for (k = abs(j); k > 0; k--) {
+				if (j > 0) {
+					cur_level--;
+					APPEND(")");
+					if (cflag)
+						set_color(cur_level-min1);
+				} else {
+					cur_level++;
+					if (cflag)
+						set_color(cur_level-min1);
+					APPEND("(");
+				}
+			}
+			if (export_flag && FUNC_NUMBER(p1[i+1].token.operatr) >= FIRST_USER_FUNC) {
+/* other programs don't have the user-defined functions, so the body is listed instead */
+				j = call_end(p1, n, i);
+				len += list_expanded_call(&p1[i], j - i, outflag, sb, export_flag);
+				if (cflag)
+					set_color(cur_level-min1);
+				i = j - 1;
+				continue;
+			}
+			APPEND(func_name(p1[i+1].token.operatr));
+			APPEND("(");
+			for (j = call_end(p1, n, i), i++; i < j; i = k) {	/* skip the dummy constant, then list each argument */
+				for (k = i + 2; k < j && p1[k].level > p1[i].level; k += 2)
+					;
+				len += list_string_sb(&p1[i+1], k - (i + 1), outflag, sb, export_flag);
+				if (k < j) {
+					APPEND(", ");
+				}
+			}
+			APPEND(")");
+			if (cflag)
+				set_color(cur_level-min1);
+			i = j - 1;
+			continue;
+		}
 		power_flag = false;
 		if (export_flag == 0 && !high_prec) {
 			for (j = i - 1; j <= (i + 1); j++) {
@@ -667,10 +958,9 @@ int		export_flag;	/* flag for exportable format (usually false) */
 			if (export_flag == 4) {
 				snprintf(buf, sizeof(buf), "%a", p1[i].token.constant);
 			} else if (export_flag == 3) {
-				snprintf(buf, sizeof(buf), "%#.*g", DBL_DIG, p1[i].token.constant);
-				trim_zeros(buf);
+				format_exact(buf, sizeof(buf), p1[i].token.constant, true);
 			} else if (export_flag || high_prec) {
-				snprintf(buf, sizeof(buf), "%.*g", export_precision, p1[i].token.constant);
+				format_exact(buf, sizeof(buf), p1[i].token.constant, false);
 			} else if (finance_option >= 0) {
 #if	THOUSANDS_SEPARATOR	/* Fails miserably in MinGW and possibly others, displaying nothing but the format string. */
 				snprintf(buf, sizeof(buf), "%'.*f", finance_option, p1[i].token.constant);
@@ -680,9 +970,11 @@ int		export_flag;	/* flag for exportable format (usually false) */
 			} else {
 				if (p1[i].token.constant < 0.0 && (i + 1) < n && p1[i+1].level == p1[i].level
 				    && (p1[i+1].token.operatr >= POWER)) {
-					snprintf(buf, sizeof(buf), "(%.*g)", precision, p1[i].token.constant);
+					buf[0] = '(';
+					format_constant(&buf[1], sizeof(buf) - 2, precision, p1[i].token.constant);
+					strcat(buf, ")");
 				} else {
-					snprintf(buf, sizeof(buf), "%.*g", precision, p1[i].token.constant);
+					format_constant(buf, sizeof(buf), precision, p1[i].token.constant);
 				}
 				APPEND(buf);
 				break;
@@ -775,6 +1067,8 @@ int		n;		/* length of expression */
 		case OPERATOR:
 			if (p1[i].token.operatr == DIVIDE)
 				rv = -1;
+			if (IS_FUNC_OP(p1[i].token.operatr))
+				return 0;
 			break;
 		}
 	}
@@ -796,10 +1090,10 @@ int			int_flag;	/* integer arithmetic flag */
 
 	if (empty_equation_space(en))
 		return 0;
-	len += list_code(lhs[en], &n_lhs[en], true, NULL, language, int_flag);
+	len += list_code_sb(lhs[en], &n_lhs[en], true, NULL, language, int_flag);
 	if (n_rhs[en]) {
 		len += fprintf(gfp, EQUATE_STRING);
-		len += list_code(rhs[en], &n_rhs[en], true, NULL, language, int_flag);
+		len += list_code_sb(rhs[en], &n_rhs[en], true, NULL, language, int_flag);
 	}
 	switch (language) {
 	case C:
@@ -825,36 +1119,25 @@ int			en;		/* equation space number */
 enum language_list	language;
 int			int_flag;	/* integer arithmetic flag */
 {
-	int	len;
-	char	*cp;
+	string_buffer_type	sb;
 
 	if (empty_equation_space(en))
 		return NULL;
-	len = list_code(lhs[en], &n_lhs[en], false, NULL, language, int_flag);
+	sb_init(&sb);
+	list_code_sb(lhs[en], &n_lhs[en], false, &sb, language, int_flag);
 	if (n_rhs[en]) {
-		len += strlen(EQUATE_STRING);
-		len += list_code(rhs[en], &n_rhs[en], false, NULL, language, int_flag);
-	}
-	len += 2;	/* for possible semicolon and terminating null character */
-	cp = (char *) malloc(len);
-	if (cp == NULL) {
-		error(_("Out of memory (can't malloc(3))."));
-		return NULL;
-	}
-	list_code(lhs[en], &n_lhs[en], false, cp, language, int_flag);
-	if (n_rhs[en]) {
-		strcat(cp, EQUATE_STRING);
-		list_code(rhs[en], &n_rhs[en], false, &cp[strlen(cp)], language, int_flag);
+		sb_append(&sb, EQUATE_STRING);
+		list_code_sb(rhs[en], &n_rhs[en], false, &sb, language, int_flag);
 	}
 	switch (language) {
 	case C:
 	case JAVA:
-		strcat(cp, ";");
+		sb_append(&sb, ";");
 		break;
 	default:
 		break;
 	}
-	return cp;
+	return sb_finish(&sb);
 }
 
 /*
@@ -871,6 +1154,38 @@ int			outflag;	/* if true, output to gfp */
 char			*string;	/* buffer to save output to or NULL pointer */
 enum language_list	language;	/* see enumeration language_list in am.h */
 int			int_flag;	/* integer arithmetic flag, should work with any language */
+{
+	string_buffer_type	sb;
+	int			len;
+
+	if (string == NULL)
+		return list_code_sb(equation, np, outflag, NULL, language, int_flag);
+	sb_init(&sb);
+	len = list_code_sb(equation, np, outflag, &sb, language, int_flag);
+	if (sb_finish(&sb) == NULL) {
+		string[0] = '\0';
+		return 0;
+	}
+	memcpy(string, sb.str, sb.len + 1);
+	free(sb.str);
+	return len;
+}
+
+/*
+ * Output C, Java, or Python code for an expression,
+ * appending it to growable string "sb" if "sb" is not NULL,
+ * and displaying it if "outflag" is true.
+ *
+ * Return length of output (number of characters).
+ */
+static int
+list_code_sb(equation, np, outflag, sb, language, int_flag)
+token_type		*equation;	/* equation side pointer */
+int			*np;		/* pointer to length of equation side */
+int			outflag;	/* if true, output to gfp */
+string_buffer_type	*sb;		/* growable string to append output to, or NULL */
+enum language_list	language;	/* see enumeration language_list in am.h */
+int			int_flag;	/* integer arithmetic flag, should work with any language */
 {
 	int	i, j, k, i1, i2;
 	int	min1;
@@ -879,8 +1194,6 @@ int			int_flag;	/* integer arithmetic flag, should work with any language */
 	char	buf[500], buf2[500];
 	int	len = 0;
 
-	if (string)
-		string[0] = '\0';
 	min1 = min_level(equation, *np);
 	if (*np > 1)
 		min1--;
@@ -922,6 +1235,21 @@ int			int_flag;	/* integer arithmetic flag, should work with any language */
 						case FACTORIAL:
 							APPEND("factorial");
 							break;
+						default:
+							if (IS_FUNC_OP(equation[i2].token.operatr)) {
+								switch (language) {
+								case JAVA:
+									APPEND("Math.");
+									break;
+								case PYTHON:
+									APPEND("math.");
+									break;
+								default:
+									break;
+								}
+								APPEND(func_name(equation[i2].token.operatr));
+							}
+							break;
 						}
 						break;
 					}
@@ -931,14 +1259,17 @@ int			int_flag;	/* integer arithmetic flag, should work with any language */
 		}
 		switch (equation[i].kind) {
 		case CONSTANT:
+			if (is_call(equation, *np, i)) {
+				i++;	/* skip the dummy constant and the first function call operator */
+				break;
+			}
 			if (equation[i].token.constant == 0.0) {
 				equation[i].token.constant = 0.0; /* fix -0 */
 			}
 			if (int_flag) {
 				snprintf(buf, sizeof(buf), "%.0f", equation[i].token.constant);
 			} else {
-				snprintf(buf, sizeof(buf), "%#.*g", DBL_DIG, equation[i].token.constant);
-				trim_zeros(buf);
+				format_exact(buf, sizeof(buf), equation[i].token.constant, true);
 			}
 /* Here we will need to parenthesize negative numbers to make -2**x work the same with Python: */
 			if (equation[i].token.constant < 0) {
@@ -990,6 +1321,10 @@ int			int_flag;	/* integer arithmetic flag, should work with any language */
 				cp = "";
 				i++;
 				break;
+			default:
+				if (IS_FUNC_OP(equation[i].token.operatr))
+					cp = ", ";	/* separates function arguments */
+				break;
 			}
 			APPEND(cp);
 			break;
@@ -1001,9 +1336,192 @@ int			int_flag;	/* integer arithmetic flag, should work with any language */
 	return len;
 }
 
+/*
+ * The 2D output is laid out by making one pass through the expression,
+ * writing every line at once into the growable strings in flist_rows[].
+ * The sizes of numerators and denominators are cached in size_cache[],
+ * so that each subexpression is only measured once.
+ * This makes displaying very wide or very tall expressions take about linear time,
+ * with no limit on the number of lines.
+ */
+#define	COLOR_MARK		'\001'	/* in flist_rows[], followed by a color number and ';' for set_color() */
+#define	DEFAULT_COLOR_MARK	'\002'	/* in flist_rows[], means call default_color() here */
+
+typedef struct {		/* cached size of a numerator or denominator, for flist_recurse() */
+	token_type	*p1;	/* the subexpression this entry is for, or NULL if unused */
+	int		n;	/* its length */
+	int		len;	/* its width in screen columns */
+	int		high;	/* its highest line, relative to the line it is centered on */
+	int		low;	/* its lowest line, relative to the line it is centered on */
+} flist_size_type;
+
 /* global variables for the flist functions below */
-static int	cur_line;	/* current line */
-static int	cur_pos;	/* current position in the current line on the screen */
+static string_buffer_type *flist_rows;	/* output lines being built, highest line first */
+static int	*flist_cols;		/* current screen column of each line in flist_rows[] */
+static int	flist_max_line;		/* line number of flist_rows[0]; 0 is the middle line */
+static int	flist_n_rows;		/* number of lines in flist_rows[] */
+static int	flist_color;		/* true if color changes are to be recorded in flist_rows[] */
+static token_type *size_base;		/* expression the size_cache[] entries are indexed from */
+static int	size_n;			/* length of that expression */
+static flist_size_type *size_cache;	/* numerator size at the division operator, denominator size after it */
+
+#define	APPEND2(str)	flist_append(line, str)
+
+/*
+ * Allocate the output lines max_line down to min_line, for flist_sub() to output into.
+ * Color changes are recorded in them if "color" is true.
+ *
+ * Return true if successful.
+ */
+static int
+flist_open(max_line, min_line, color)
+int	max_line, min_line;
+int	color;
+{
+	int	i;
+
+	flist_max_line = max_line;
+	flist_n_rows = max_line - min_line + 1;
+	flist_color = (color && color_flag);
+	flist_rows = (string_buffer_type *) mem_alloc(flist_n_rows * sizeof(string_buffer_type), MEM_DISPLAY);
+	flist_cols = (int *) mem_alloc(flist_n_rows * sizeof(int), MEM_DISPLAY);
+	if (flist_rows == NULL || flist_cols == NULL) {
+		mem_free(flist_rows, flist_n_rows * sizeof(string_buffer_type), MEM_DISPLAY);
+		mem_free(flist_cols, flist_n_rows * sizeof(int), MEM_DISPLAY);
+		flist_rows = NULL;
+		flist_cols = NULL;
+		error(_("Out of memory (can't malloc(3))."));
+		return false;
+	}
+	for (i = 0; i < flist_n_rows; i++) {
+		sb_init(&flist_rows[i]);
+		flist_cols[i] = 0;
+	}
+	return true;
+}
+
+/*
+ * Free the output lines allocated by flist_open().
+ *
+ * Return true if no memory ran out while building them.
+ */
+static int
+flist_close(void)
+{
+	int	i;
+	int	rv = true;
+
+	for (i = 0; i < flist_n_rows; i++) {
+		if (flist_rows[i].str) {
+			sb_free(&flist_rows[i]);
+		} else {
+			rv = false;
+		}
+	}
+	mem_free(flist_rows, flist_n_rows * sizeof(string_buffer_type), MEM_DISPLAY);
+	mem_free(flist_cols, flist_n_rows * sizeof(int), MEM_DISPLAY);
+	flist_rows = NULL;
+	flist_cols = NULL;
+	flist_n_rows = 0;
+	return rv;
+}
+
+/*
+ * Append "str" to output line number "line", without changing its current column.
+ */
+static void
+flist_append(line, str)
+int	line;
+char	*str;
+{
+	int	i;
+
+	i = flist_max_line - line;
+	if (i >= 0 && i < flist_n_rows) {
+		sb_append(&flist_rows[i], str);
+	}
+}
+
+/*
+ * Append "str" to the middle output line, advancing its current column.
+ */
+static void
+flist_text(str)
+char	*str;
+{
+	flist_append(0, str);
+	flist_cols[flist_max_line] += strlen(str);
+}
+
+/*
+ * Record a change to "color" in output line number "line", if color is being output.
+ */
+static void
+flist_set_color(line, color)
+int	line;
+int	color;
+{
+	char	buf[30];
+
+	if (flist_color) {
+		snprintf(buf, sizeof(buf), "%c%d;", COLOR_MARK, color);
+		flist_append(line, buf);
+	}
+}
+
+/*
+ * Record a change to the normal text color at the end of every output line, if color is being output.
+ */
+static void
+flist_default_color(void)
+{
+	int	i;
+	char	mark = DEFAULT_COLOR_MARK;
+
+	if (flist_color) {
+		for (i = 0; i < flist_n_rows; i++) {
+			sb_append_len(&flist_rows[i], &mark, 1);
+		}
+	}
+}
+
+/*
+ * Output all of the lines built by flist_sub() to gfp, doing the recorded color changes,
+ * then free them.
+ *
+ * Return true if successful.
+ */
+static int
+flist_print(void)
+{
+	int	i;
+	char	*cp, *cp1;
+
+	for (i = 0; i < flist_n_rows; i++) {
+		if ((cp = flist_rows[i].str) == NULL)
+			break;
+		for (;;) {
+			for (cp1 = cp; *cp1 && *cp1 != COLOR_MARK && *cp1 != DEFAULT_COLOR_MARK; cp1++)
+				;
+			fwrite(cp, 1, cp1 - cp, gfp);
+			if (*cp1 == COLOR_MARK) {
+				set_color((int) strtol(cp1 + 1, &cp, 10));
+				cp++;
+			} else if (*cp1 == DEFAULT_COLOR_MARK) {
+				default_color(false);
+				cp = cp1 + 1;
+			} else {
+				break;
+			}
+		}
+		fprintf(gfp, "\n");
+	}
+	if (!flist_close()) {
+		error(_("Out of memory (can't malloc(3))."));
+		return false;
+	}
+	return true;
+}
 
 /*
  * Return a multi-line C string containing the specified equation space in 2D multi-line fraction format.
@@ -1014,75 +1532,90 @@ static int	cur_pos;	/* current position in the current line on the screen */
  * The equation sides must first be basically simplified and prepared by fractions_and_group(),
  * for proper formatting.
  *
+ * If the result is wider than the "set columns" value, it is wrapped into blocks of lines
+ * no wider than that, separated by empty lines, breaking at a column of spaces where possible.
+ * There is no width limit if "set columns" is 0, and no limit on the number of lines.
+ *
  * Return NULL on failure.
- * Result will be limited to current_columns columns, TEXT_ROWS lines.
- * Exceeding current_columns will result in truncation,
- * exceeding TEXT_ROWS will result in failure and NULL return.
- * current_columns is set in malloc_vscreen().
  */
 char *
 flist_equation_string(n)
 int	n;	/* equation space number */
 {
-	int	i;
-	int	len, cur_len, buf_len;
-	int	pos;
+	int	i, j;
+	int	len, columns;
+	int	pos, start, end;
 	int	high = 0, low = 0;
 	int	max_line = 0, min_line = 0;
-	int	screen_line;
-	char	*cp;
+	string_buffer_type	sb;
 
 	if (empty_equation_space(n))
 		return NULL;
-	if (!malloc_vscreen())
-		return NULL;
-	for (i = 0; i < TEXT_ROWS; i++) {
-		vscreen[i][0] = '\0';
-	}
-	cur_line = 0;
-	cur_pos = 0;
-	len = flist_sub(lhs[n], n_lhs[n], false, NULL, current_columns, 0, &max_line, &min_line);
+	len = flist_sub(lhs[n], n_lhs[n], false, 0, &max_line, &min_line);
 	if (n_rhs[n]) {
 		len += strlen(EQUATE_STRING);
-		len += flist_sub(rhs[n], n_rhs[n], false, NULL, current_columns, 0, &high, &low);
+		len += flist_sub(rhs[n], n_rhs[n], false, 0, &high, &low);
 		if (high > max_line)
 			max_line = high;
 		if (low < min_line)
 			min_line = low;
 	}
-	if ((max_line - min_line) >= TEXT_ROWS)
-		return NULL;
-	for (cur_line = max_line, screen_line = 0; cur_line >= min_line; cur_line--, screen_line++) {
-		pos = cur_pos = 0;
-		pos += flist_sub(lhs[n], n_lhs[n], true, vscreen[screen_line], current_columns, pos, &high, &low);
-		if (n_rhs[n]) {
-			if (cur_line == 0) {
-				cur_pos += strlen(EQUATE_STRING);
-				cur_len = strlen(vscreen[screen_line]);
-				if ((current_columns - cur_len) > 0)
-					my_strlcpy(&vscreen[screen_line][cur_len], EQUATE_STRING, current_columns - cur_len);
-			}
-			pos += strlen(EQUATE_STRING);
-			pos += flist_sub(rhs[n], n_rhs[n], true, vscreen[screen_line], current_columns, pos, &high, &low);
-		}
-	}
-	if (screen_line <= 0)
+	columns = (screen_columns > 1) ? (screen_columns - 1) : len;
+	if (!flist_open(max_line, min_line, false))
 		return NULL;
-	for (i = 0, buf_len = 1; i < screen_line; i++) {
-		buf_len += strlen(vscreen[i]);
-		buf_len++;	/* For newlines */
+	pos = flist_sub(lhs[n], n_lhs[n], true, 0, &high, &low);
+	if (n_rhs[n]) {
+		flist_text(EQUATE_STRING);
+		pos += strlen(EQUATE_STRING);
+		flist_sub(rhs[n], n_rhs[n], true, pos, &high, &low);
 	}
-	cp = (char *) malloc(buf_len);
-	if (cp == NULL) {
-		error(_("Out of memory (can't malloc(3))."));
-		return NULL;
+	for (i = 0; i < flist_n_rows; i++) {
+		if (flist_rows[i].str == NULL) {
+			flist_close();
+			return NULL;
+		}
+		if (flist_rows[i].len > len)
+			len = flist_rows[i].len;
 	}
-	cp[0] = '\0';
-	for (i = 0; i < screen_line; i++) {
-		strcat(cp, vscreen[i]);
-		strcat(cp, "\n");
+	sb_init(&sb);
+	for (start = 0; start < len; start = end) {
+		end = start + columns;
+		if (end < len) {
+/* Break before the last column that is blank on every line, if there is one: */
+			for (pos = end; pos > start; pos--) {
+				for (i = 0; i < flist_n_rows; i++) {
+					if (pos < flist_rows[i].len && flist_rows[i].str[pos] != ' ')
+						break;
+				}
+				if (i >= flist_n_rows)
+					break;
+			}
+			if (pos > start)
+				end = pos;
+		} else {
+			end = len;
+		}
+		if (start > 0) {
+			sb_append_len(&sb, "\n", 1);
+		}
+		for (i = 0; i < flist_n_rows; i++) {
+			j = min(end, flist_rows[i].len) - start;
+			if (j > 0)
+				sb_append_len(&sb, &flist_rows[i].str[start], j);
+			sb_append_len(&sb, "\n", 1);
+		}
+		while (end < len) {	/* skip the blank column at the break */
+			for (i = 0; i < flist_n_rows; i++) {
+				if (end < flist_rows[i].len && flist_rows[i].str[end] != ' ')
+					break;
+			}
+			if (i < flist_n_rows)
+				break;
+			end++;
+		}
 	}
-	return(cp);
+	flist_close();
+	return sb_finish(&sb);
 }
 
 /*
@@ -1116,14 +1649,12 @@ int	n;	/* equation space number */
 	use_screen_columns = (gfp == stdout);
 #endif
 	len = snprintf(buf, sizeof(buf), "#%d: ", n + 1);
-	cur_line = 0;
-	cur_pos = 0;
 	sind = n_rhs[n];
-	len += flist_sub(lhs[n], n_lhs[n], false, NULL, screen_columns, 0, &max_line, &min_line);
+	len += flist_sub(lhs[n], n_lhs[n], false, 0, &max_line, &min_line);
 	if (n_rhs[n]) {
 		len += strlen(EQUATE_STRING);
 make_smaller:
-		len2 = flist_sub(rhs[n], sind, false, NULL, screen_columns, 0, &high, &low);
+		len2 = flist_sub(rhs[n], sind, false, 0, &high, &low);
 		if (screen_columns && use_screen_columns && (len + len2) >= screen_columns && sind > 0) {
 			for (sind--; sind > 0; sind--) {
 				if (rhs[n][sind].level == 1 && rhs[n][sind].kind == OPERATOR) {
@@ -1141,7 +1672,7 @@ make_smaller:
 			max_line = high;
 		if (low < min_line)
 			min_line = low;
-		len3 = flist_sub(&rhs[n][sind], n_rhs[n] - sind, false, NULL, screen_columns, 0, &max2_line, &min2_line);
+		len3 = flist_sub(&rhs[n][sind], n_rhs[n] - sind, false, 0, &max2_line, &min2_line);
 	} else {
 		len2 = 0;
 		len3 = 0;
@@ -1158,40 +1689,36 @@ make_smaller:
 		return width;
 	}
 	fprintf(gfp, "\n");
-	for (cur_line = max_line; cur_line >= min_line; cur_line--) {
-		pos = cur_pos = 0;
-		if (cur_line == 0) {
-			cur_pos += fprintf(gfp, "%s", buf);
-		}
-		pos += strlen(buf);
-		pos += flist_sub(lhs[n], n_lhs[n], true, NULL, screen_columns, pos, &high, &low);
-		if (n_rhs[n]) {
-			if (cur_line == 0) {
-				cur_pos += fprintf(gfp, "%s", EQUATE_STRING);
-			}
-			pos += strlen(EQUATE_STRING);
-			pos += flist_sub(rhs[n], sind, true, NULL, screen_columns, pos, &high, &low);
-		}
-		fprintf(gfp, "\n");
+	if (!flist_open(max_line, min_line, true))
+		return 0;
+	flist_text(buf);
+	pos = strlen(buf);
+	pos += flist_sub(lhs[n], n_lhs[n], true, pos, &high, &low);
+	if (n_rhs[n]) {
+		flist_text(EQUATE_STRING);
+		pos += strlen(EQUATE_STRING);
+		flist_sub(rhs[n], sind, true, pos, &high, &low);
 	}
+	if (!flist_print())
+		return 0;
 	if (sind < n_rhs[n]) {
 /* output second half of split equation that was too wide to display on the screen without splitting */
 		fprintf(gfp, "\n");
-		for (cur_line = max2_line; cur_line >= min2_line; cur_line--) {
-			cur_pos = 0;
-			flist_sub(&rhs[n][sind], n_rhs[n] - sind, true, NULL, screen_columns, 0, &high, &low);
-			fprintf(gfp, "\n");
-		}
+		if (!flist_open(max2_line, min2_line, true))
+			return 0;
+		flist_sub(&rhs[n][sind], n_rhs[n] - sind, true, 0, &high, &low);
+		if (!flist_print())
+			return 0;
 	}
 	fprintf(gfp, "\n");
 	return width;
 }
 
 /*
- * Display a line of an expression in 2D fraction format if "out_flag" is true.
- * The number of the line to output is stored in the global variable cur_line.
+ * Lay out an expression in 2D fraction format, outputting it into all of the lines
+ * allocated by flist_open() if "out_flag" is true.
  * 0 is the middle line, lines above are positive, lines below are negative.
- * Use color if available.
+ * Record color changes if color mode is set.
  *
  * The following functions are for internal use only, and not to be called,
  * except by flist_equation() and flist_equation_string().
@@ -1199,31 +1726,159 @@ make_smaller:
  * Return the width of the expression (that is, the required number of screen columns).
  */
 static int
-flist_sub(p1, n, out_flag, string, sbuffer_size, pos, highp, lowp)
+flist_sub(p1, n, out_flag, pos, highp, lowp)
 token_type	*p1;		/* expression pointer */
 int		n;		/* length of expression */
-int		out_flag;	/* if true, output to gfp or string */
-char		*string;	/* if not NULL, put output to here instead of gfp */
-int		sbuffer_size;	/* string buffer size */
-int		pos;
+int		out_flag;	/* if true, output into flist_rows[] */
+int		pos;		/* screen column to start at */
 int		*highp, *lowp;
 {
 	int	rv;
 
-	rv = flist_recurse(p1, n, out_flag, string, sbuffer_size, 0, pos, 1, highp, lowp);
-	if (out_flag && (string == NULL)) {
-		default_color(false);
+	size_base = p1;
+	size_n = n;
+	size_cache = (flist_size_type *) mem_calloc(max(n, 1), sizeof(flist_size_type), MEM_DISPLAY);	/* if NULL, sizes are not cached */
+	rv = flist_recurse(p1, n, out_flag, 0, pos, 1, highp, lowp);
+	mem_free(size_cache, max(n, 1) * sizeof(flist_size_type), MEM_DISPLAY);
+	size_cache = NULL;
+	if (out_flag) {
+		flist_default_color();
 	}
 	return rv;
 }
 
+/*
+ * Return the size of a numerator or denominator, without outputting it,
+ * using the size_cache[] entry for it at "tp" if there is one.
+ */
 static int
-flist_recurse(p1, n, out_flag, string, sbuffer_size, line, pos, cur_level, highp, lowp)
+flist_size(p1, n, line, cur_level, highp, lowp, tp)
 token_type	*p1;
 int		n;
-int		out_flag;	/* if true, output to gfp or string */
-char		*string;	/* if not NULL, put output to here instead of gfp */
-int		sbuffer_size;	/* string buffer size */
+int		line;
+int		cur_level;
+int		*highp, *lowp;
+token_type	*tp;	/* where in the expression the size_cache[] entry is */
+{
+	flist_size_type	*sp = NULL;
+	int		len;
+
+	if (size_cache && tp >= size_base && tp < &size_base[size_n]) {
+		sp = &size_cache[tp - size_base];
+		if (sp->p1 == p1 && sp->n == n) {
+			*highp = line + sp->high;
+			*lowp = line + sp->low;
+			return sp->len;
+		}
+	}
+	len = flist_recurse(p1, n, false, line, 0, cur_level, highp, lowp);
+	if (sp) {
+		sp->p1 = p1;
+		sp->n = n;
+		sp->len = len;
+		sp->high = *highp - line;
+		sp->low = *lowp - line;
+	}
+	return len;
+}
+
+/*
+ * Return the start of the numerator of the division operator at p1[i].
+ */
+static int
+flist_div_start(p1, i)
+token_type	*p1;
+int		i;
+{
+	int	j;
+
+	for (j = i - 2; j > 0; j -= 2) {
+		if (p1[j].level < p1[i].level)
+			break;
+	}
+	return(j + 1);
+}
+
+/*
+ * Find the next fraction to display at or after p1[ii].
+ * That is the division operator whose numerator starts first,
+ * or if there is a tie, the one with the lowest level of parentheses.
+ *
+ * Return its location, or -1 if none.
+ * The start of its numerator is returned in "*stop_atp", which is n if none.
+ */
+static int
+flist_next_div(p1, n, ii, stop_atp)
+token_type	*p1;
+int		n;
+int		ii;
+int		*stop_atp;
+{
+	int	i, j;
+	int	div_loc = -1;
+
+	*stop_atp = n;
+	for (i = ii; i < n; i++) {
+		if (p1[i].kind == OPERATOR && p1[i].token.operatr == DIVIDE) {
+			j = flist_div_start(p1, i);
+			if (div_loc < 0 || j < *stop_atp || (j == *stop_atp && p1[i].level < p1[div_loc].level)) {
+				div_loc = i;
+				*stop_atp = j;
+			}
+		}
+	}
+	return div_loc;
+}
+
+/*
+ * Make a table of all division operators at or after p1[ii],
+ * so flist_recurse() can find each next fraction without searching the rest of the expression again.
+ * For each division operator there are 3 ints: its location, the start of its numerator,
+ * and the table index of the next fraction at or after it, as flist_next_div() would find it.
+ *
+ * Return the allocated table, which should be freed with mem_free() when done,
+ * or NULL if there is nothing to put in it or not enough memory.
+ */
+static int *
+flist_div_table(p1, n, ii, countp)
+token_type	*p1;
+int		n;
+int		ii;
+int		*countp;
+{
+	int	i, k, best;
+	int	count = 0;
+	int	*table;
+
+	for (i = ii; i < n; i++) {
+		if (p1[i].kind == OPERATOR && p1[i].token.operatr == DIVIDE)
+			count++;
+	}
+	*countp = count;
+	if (count == 0 || (table = (int *) mem_alloc(3 * count * sizeof(int), MEM_DISPLAY)) == NULL)
+		return NULL;
+	for (i = ii, k = 0; i < n; i++) {
+		if (p1[i].kind == OPERATOR && p1[i].token.operatr == DIVIDE) {
+			table[3*k] = i;
+			table[3*k+1] = flist_div_start(p1, i);
+			k++;
+		}
+	}
+	for (k = count - 1, best = k; k >= 0; k--) {
+		if (table[3*k+1] < table[3*best+1]
+		    || (table[3*k+1] == table[3*best+1] && p1[table[3*k]].level <= p1[table[3*best]].level)) {
+			best = k;
+		}
+		table[3*k+2] = best;
+	}
+	return table;
+}
+
+static int
+flist_recurse(p1, n, out_flag, line, pos, cur_level, highp, lowp)
+token_type	*p1;
+int		n;
+int		out_flag;	/* if true, output into flist_rows[] */
 int		line;
 int		pos;
 int		cur_level;
@@ -1237,57 +1892,51 @@ int		*highp, *lowp;
 	int	len_div;
 	int	level;
 	int	start_level;
-	int	oflag, cflag, html_out, power_flag;
+	int	oflag, cflag, html_out, power_flag, call_flag;
 	int	len = 0, len1, len2;
-	int	current_len = 0;
+	int	done = 0;	/* part of "len" already added to flist_cols[] */
 	int	high, low;
+	int	*div_table = NULL;	/* the division operators after the first fraction */
+	int	n_div = 0, next_div = 0;
 	char	buf[500];
 	char	*cp;
 
-	if (string)
-		current_len = strlen(string);
 	start_level = cur_level;
 	*highp = line;
 	*lowp = line;
 	if (n <= 0) {
 		return 0;
 	}
-	oflag = (out_flag && line == cur_line);
-	cflag = (oflag && string == NULL);
+	oflag = out_flag;
+	cflag = (oflag && flist_color);
 	html_out = ((html_flag == 2) || (html_flag && gfp == stdout));
 	if (oflag) {
-		for (; cur_pos < pos; cur_pos++) {
+		for (i = flist_max_line - line; flist_cols[i] < pos; flist_cols[i]++) {
 			APPEND2(" ");
 		}
 	}
 	ii = 0;
 check_again:
-	stop_at = n;
-	div_loc = -1;
-	for (i = ii; i < n; i++) {
-		if (p1[i].kind == OPERATOR && p1[i].token.operatr == DIVIDE) {
-			level = p1[i].level;
-			for (j = i - 2; j > 0; j -= 2) {
-				if (p1[j].level < level)
-					break;
-			}
-			j++;
-			if (div_loc < 0) {
-				div_loc = i;
-				stop_at = j;
-			} else {
-				if (j < stop_at) {
-					div_loc = i;
-					stop_at = j;
-				} else if (j == stop_at) {
-					if (level < p1[div_loc].level)
-						div_loc = i;
-				}
-			}
+	if (ii > 0 && ii < n && div_table == NULL) {
+		div_table = flist_div_table(p1, n, ii, &n_div);
+	}
+	if (div_table) {
+		while (next_div < n_div && div_table[3*next_div] < ii)
+			next_div++;
+		if (next_div < n_div) {
+			k = div_table[3*next_div+2];
+			div_loc = div_table[3*k];
+			stop_at = div_table[3*k+1];
+		} else {
+			div_loc = -1;
+			stop_at = n;
 		}
+	} else {
+		div_loc = flist_next_div(p1, n, ii, &stop_at);
 	}
 	for (i = ii; i < n; i++) {
 		power_flag = false;
+		call_flag = (i != stop_at && is_call(p1, n, i));
 		if (i == stop_at) {
 #if	DEBUG
 			if (div_loc < 0) {
@@ -1296,6 +1945,9 @@ check_again:
 #endif
 			j = cur_level - p1[div_loc].level;
 			k = abs(j) - 1;
+		} else if (call_flag) {
+			j = cur_level - max(p1[i].level - 1, start_level);
+			k = abs(j);
 		} else {
 			for (j = i - 1; j <= (i + 1); j++) {
 				if ((j - 1) >= ii && (j + 1) < n
@@ -1316,7 +1968,7 @@ check_again:
 		}
 		if (k < 1) {
 			if (cflag)
-				set_color(cur_level-1);
+				flist_set_color(line, cur_level-1);
 		}
 		for (i1 = 1; i1 <= k; i1++) {
 			if (j > 0) {
@@ -1325,27 +1977,27 @@ check_again:
 				if (oflag) {
 					APPEND2(")");
 					if (cflag)
-						set_color(cur_level-1);
+						flist_set_color(line, cur_level-1);
 				}
 			} else {
 				cur_level++;
 				len++;
 				if (oflag) {
 					if (cflag)
-						set_color(cur_level-1);
+						flist_set_color(line, cur_level-1);
 					APPEND2("(");
 				}
 			}
 		}
 		if (i == stop_at) {
 			level = p1[div_loc].level;
-			len1 = flist_recurse(&p1[stop_at], div_loc - stop_at, false, string, sbuffer_size, line + 1, pos + len, level, &high, &low);
+			len1 = flist_size(&p1[stop_at], div_loc - stop_at, line + 1, level, &high, &low, &p1[div_loc]);
 			l1 = (2 * (line + 1)) - low;
 			for (j = div_loc + 2; j < n; j += 2) {
 				if (p1[j].level <= level)
 					break;
 			}
-			len2 = flist_recurse(&p1[div_loc+1], j - (div_loc + 1), false, string, sbuffer_size, line - 1, pos + len, level, &high, &low);
+			len2 = flist_size(&p1[div_loc+1], j - (div_loc + 1), line - 1, level, &high, &low, &p1[div_loc+1]);
 			l2 = (2 * (line - 1)) - high;
 			ii = j;
 			len_div = max(len1, len2);
@@ -1353,7 +2005,11 @@ check_again:
 			if (len1 < len_div) {
 				j = (len_div - len1) / 2;
 			}
-			flist_recurse(&p1[stop_at], div_loc - stop_at, out_flag, string, sbuffer_size, l1, pos + len + j, level, &high, &low);
+			if (out_flag) {
+				flist_recurse(&p1[stop_at], div_loc - stop_at, out_flag, l1, pos + len + j, level, &high, &low);
+			} else {
+				flist_size(&p1[stop_at], div_loc - stop_at, l1, level, &high, &low, &p1[div_loc]);
+			}
 			if (high > *highp)
 				*highp = high;
 			if (low < *lowp)
@@ -1361,7 +2017,7 @@ check_again:
 			if (oflag) {
 				/* display fraction bar */
 				if (cflag)
-					set_color(level-1);
+					flist_set_color(line, level-1);
 				for (j = 0; j < len_div; j++) {
 					if (html_out) {
 						APPEND2("&ndash;");
@@ -1370,13 +2026,17 @@ check_again:
 					}
 				}
 				if (cflag)
-					set_color(cur_level-1);
+					flist_set_color(line, cur_level-1);
 			}
 			j = 0;
 			if (len2 < len_div) {
 				j = (len_div - len2) / 2;
 			}
-			flist_recurse(&p1[div_loc+1], ii - (div_loc + 1), out_flag, string, sbuffer_size, l2, pos + len + j, level, &high, &low);
+			if (out_flag) {
+				flist_recurse(&p1[div_loc+1], ii - (div_loc + 1), out_flag, l2, pos + len + j, level, &high, &low);
+			} else {
+				flist_size(&p1[div_loc+1], ii - (div_loc + 1), l2, level, &high, &low, &p1[div_loc+1]);
+			}
 			if (high > *highp)
 				*highp = high;
 			if (low < *lowp)
@@ -1384,6 +2044,43 @@ check_again:
 			len += len_div;
 			goto check_again;
 		}
+		if (call_flag) {
+/* display the function name and each argument, which may contain fractions */
+			cp = func_name(p1[i+1].token.operatr);
+			len += strlen(cp) + 1;
+			if (oflag) {
+				APPEND2(cp);
+				APPEND2("(");
+			}
+			for (ii = call_end(p1, n, i), i++; i < ii; i = k) {
+				for (k = i + 2; k < ii && p1[k].level > p1[i].level; k += 2)
+					;
+				if (oflag) {
+					flist_cols[flist_max_line - line] += len - done;
+					done = len;
+				}
+				len1 = flist_recurse(&p1[i+1], k - (i + 1), out_flag, line, pos + len,
+				    min_level(&p1[i+1], k - (i + 1)), &high, &low);
+				len += len1;
+				done += len1;
+				if (high > *highp)
+					*highp = high;
+				if (low < *lowp)
+					*lowp = low;
+				if (k < ii) {
+					len += 2;
+					if (oflag)
+						APPEND2(", ");
+				}
+			}
+			len++;
+			if (oflag) {
+				APPEND2(")");
+				if (cflag)
+					flist_set_color(line, cur_level-1);
+			}
+			goto check_again;
+		}
 		switch (p1[i].kind) {
 		case CONSTANT:
 			if (p1[i].token.constant == 0.0) {
@@ -1418,9 +2115,11 @@ check_again:
 			} else {
 				if (p1[i].token.constant < 0.0 && (i + 1) < n && p1[i+1].level == p1[i].level
 				    && (p1[i+1].token.operatr >= POWER)) {
-					len += snprintf(buf, sizeof(buf), "(%.*g)", precision, p1[i].token.constant);
+					buf[0] = '(';
+					len += format_constant(&buf[1], sizeof(buf) - 2, precision, p1[i].token.constant) + 2;
+					strcat(buf, ")");
 				} else {
-					len += snprintf(buf, sizeof(buf), "%.*g", precision, p1[i].token.constant);
+					len += format_constant(buf, sizeof(buf), precision, p1[i].token.constant);
 				}
 			}
 			if (oflag)
@@ -1521,10 +2220,11 @@ check_again:
 		if (oflag) {
 			APPEND2(")");
 			if (j > 0 && cflag)
-				set_color(cur_level-1);
+				flist_set_color(line, cur_level-1);
 		}
 	}
 	if (oflag)
-		cur_pos += len;
+		flist_cols[flist_max_line - line] += len - done;
+	mem_free(div_table, 3 * n_div * sizeof(int), MEM_DISPLAY);
 	return len;
 }
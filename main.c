@@ -106,6 +106,10 @@ FILE	*fp;
 	fprintf(fp, _("  -v             Display version number, then exit successfully.\n"));
 	fprintf(fp, _("  -w             Wide output mode, sets unlimited width.\n"));
 	fprintf(fp, _("  -x             Enable HTML/XHTML output mode.\n"));
+#if	UNIX && !SECURE
+	fprintf(fp, _("  -z socket      Fork a copy of the initialized program for each connection.\n"));
+	fprintf(fp, _("  -S socket:n:t  Serve requests with n workers and a t seconds time limit.\n"));
+#endif
 	fprintf(fp, _("\nPlease refer to the man page for details (type \"man mathomatic\" in shell).\n"));
 }
 
@@ -126,6 +130,8 @@ char	**argv;
 	int		aoption = false, coption = false, boption = false, wide_flag = false;
 	int		exit_value = 0;
 	unsigned int	time_out_seconds = 0;
+	char		*zygote_path = NULL, *server_path = NULL;
+	int		server_workers = 4, server_timeout = 10;
 
 #if	WIN32_CONSOLE_COLORS
 	hOut = GetStdHandle(STD_OUTPUT_HANDLE);
@@ -148,7 +154,7 @@ char	**argv;
 	get_screen_size();
 
 	/* process command line options */
-	while ((i = getopt(argc, argv, "s:abqrtdchuvwxm:e")) >= 0) {
+	while ((i = getopt(argc, argv, "s:abqrtdchuvwxm:ez:S:")) >= 0) {
 		switch (i) {
 		case 's':
 			if (optarg) {
@@ -231,11 +237,44 @@ char	**argv;
 			eoption = true;
 			autoselect = false;
 			break;
+		case 'z':
+#if	UNIX && !SECURE
+			zygote_path = optarg;
+#else
+			fprintf(stderr, _("%s: Zygote mode is not available in this version.\n"), prog_name);
+			exit(2);
+#endif
+			break;
+		case 'S':
+#if	UNIX && !SECURE
+			if (optarg == NULL)
+				break;
+			server_path = optarg;
+			if ((cp = strchr(optarg, ':')) != NULL) {
+				*cp++ = '\0';
+				server_workers = strtol(cp, &cp, 10);
+				if (*cp == ':') {
+					server_timeout = strtol(cp + 1, &cp, 10);
+				}
+				if (*cp || server_workers <= 0 || server_timeout < 0) {
+					fprintf(stderr, _("%s: Error in setting server workers or time out seconds.\n"), prog_name);
+					exit(2);
+				}
+			}
+			break;
+#else
+			fprintf(stderr, _("%s: Server mode is not available in this version.\n"), prog_name);
+			exit(2);
+#endif
 		default:
 			usage(stdout);
 			exit(2);
 		}
 	}
+	if (zygote_path && server_path) {
+		fprintf(stderr, _("%s: The -z and -S options can't be used together.\n"), prog_name);
+		exit(2);
+	}
 	if (n_tokens < 100 || n_tokens >= (INT_MAX / sizeof(token_type))) {
 		fprintf(stderr, _("%s: Standard expression array size %d out of range!\n"), prog_name, n_tokens);
 	}
@@ -321,6 +360,8 @@ char	**argv;
 	if ((i = setjmp(jmp_save)) != 0) {
 		/* for error handling */
 		clean_up();
+		trace_unwind();
+		end_command_stats(0);
 		switch (i) {
 		case 14:
 			error(_("Expression too large."));
@@ -387,6 +428,14 @@ char	**argv;
 					exit_program(1);
 				}
 			}
+#if	UNIX
+			if (zygote_path) {
+				zygote_server(zygote_path);	/* only returns in forked children */
+			}
+			if (server_path) {
+				request_server(server_path, server_workers, server_timeout);	/* doesn't return */
+			}
+#endif
 #endif
 		}
 	}
@@ -540,6 +589,10 @@ exit_program(exit_value)
 int	exit_value;	/* zero if OK, non-zero indicates error return */
 {
 	reset_attr();
+	trace_close();
+	if (command_stats_flag) {
+		command_stats_report(stderr);
+	}
 	if (html_flag) {
 		printf("</pre>\n");
 	}
@@ -24,6 +24,25 @@ George Gesslein II, P.O. Box 224, Lansing, NY  14882-0224  USA.
 
 #include "includes.h"
 
+#define	MAX_FUNC_NESTING	20	/* maximum nesting depth of function calls */
+
+static char	*func_params[MAX_FUNC_ARGS];	/* parameter names of the function body being parsed */
+static int	func_param_len[MAX_FUNC_ARGS];	/* lengths of the parameter names */
+static int	n_func_params;			/* number of parameters, 0 if not parsing a function body */
+
+static char	*defining_name;		/* name of the function whose body is being parsed, so it can't call itself */
+static int	defining_len;		/* length of defining_name */
+
+/*
+ * Work space for each nesting level of function calls being parsed.
+ * Allocated when first needed and kept, so nothing is lost if parsing is aborted.
+ */
+static struct {
+	token_type	*tokens;	/* parsed argument or built-in function expansion, n_tokens long */
+	token_type	*args;		/* all the parsed arguments, one after another, n_tokens long */
+} func_space[MAX_FUNC_NESTING];
+static int	func_nesting;		/* current nesting level of function calls being parsed */
+
 /*
  * Convert all alphabetic characters in a string to lower case.
  */
@@ -157,6 +176,165 @@ finish:
 	}
 }
 
+/*
+ * Return the priority class of operator "op".
+ * Operators in the same class on the same level are grouped together by give_priority().
+ */
+static int
+priority_class(op)
+int	op;
+{
+	switch (op) {
+	case TIMES:
+	case DIVIDE:
+	case MODULUS:
+	case IDIVIDE:
+		return TIMES;
+	}
+	return op;
+}
+
+/*
+ * Return the location of the start of the left operand of operator p1[i],
+ * as binary_parenthesize() would find it.
+ */
+static int
+operand_start(p1, i)
+token_type	*p1;	/* pointer to expression */
+int		i;	/* location of operator in expression */
+{
+	int	j;
+	int	level;
+
+	level = p1[i].level;
+	j = i - 1;
+	if (p1[j].level > level) {
+		while (j > 0 && p1[j-1].level > level)
+			j--;
+	}
+	return j;
+}
+
+/*
+ * Return the location just past the end of the right operand of operator p1[i],
+ * as binary_parenthesize() would find it.
+ */
+static int
+operand_end(p1, n, i)
+token_type	*p1;	/* pointer to expression */
+int		n;	/* length of expression */
+int		i;	/* location of operator in expression */
+{
+	int	j;
+	int	level;
+	int	skip_negate;
+
+	skip_negate = (p1[i].token.operatr != NEGATE);
+	level = p1[i].level;
+	for (;;) {
+		if (p1[i+1].level > level) {
+			for (j = i + 2; j < n && p1[j].level > level; j++)
+				;
+			return j;
+		}
+		if (skip_negate && p1[i+1].level == level && i + 3 < n && p1[i+2].level == level
+		    && p1[i+2].token.operatr == NEGATE) {
+			i += 2;
+			continue;
+		}
+		return i + 2;
+	}
+}
+
+/*
+ * Parenthesize the chain of operators that starts with operator p1[i].
+ * A chain is a run of operators of the same priority class on the same level,
+ * each being an operand of the next.
+ * The result is the same as calling binary_parenthesize() on each operator of the chain in turn,
+ * but each token is visited only a few times, instead of once for every operator to its right,
+ * so long products and power towers are parenthesized in linear time.
+ * A chain of only times and divide operators is put on a single new level instead,
+ * which means the same thing and is what organize() would reduce it to anyway,
+ * saving organize() from flattening a deeply nested product.
+ *
+ * The operators of the chain after the first are marked by negating their operator code.
+ * The caller must restore them when it reaches them.
+ */
+static void
+parenthesize_chain(p1, n, i, right_to_left)
+token_type	*p1;		/* pointer to expression */
+int		n;		/* length of expression */
+int		i;		/* location of the first operator of the chain */
+int		right_to_left;	/* true if the chain groups right to left, starting with the rightmost operator */
+{
+	int	j, k, m;
+	int	e;
+	int	level;
+	int	class;
+	int	flat;
+
+	level = p1[i].level;
+	class = priority_class(p1[i].token.operatr);
+	if (right_to_left) {
+		for (j = i, k = 1; (e = operand_start(p1, j)) > 0 && p1[e-1].level == level
+		    && priority_class(p1[e-1].token.operatr) == class; j = e - 1)
+			k++;
+		for (j = i + 1, e = operand_end(p1, n, i); j < e; j++) {
+			p1[j].level += k;
+		}
+		for (m = k, j = i; m > 0; m--) {
+			e = operand_start(p1, j);
+			if (j != i)
+				p1[j].token.operatr = -p1[j].token.operatr;
+			for (; j >= e; j--) {
+				p1[j].level += m;
+			}
+		}
+	} else {
+		for (j = i, k = 1, flat = true;; j = e, k++) {
+			if (p1[j].token.operatr != TIMES && p1[j].token.operatr != DIVIDE)
+				flat = false;
+			e = operand_end(p1, n, j);
+			if (e >= n || p1[e].level != level || priority_class(p1[e].token.operatr) != class)
+				break;
+		}
+		for (j = operand_start(p1, i); j < i; j++) {
+			p1[j].level += (flat ? 1 : k);
+		}
+		for (m = k; m > 0; m--) {
+			e = operand_end(p1, n, j);
+			if (j != i)
+				p1[j].token.operatr = -p1[j].token.operatr;
+			for (; j < e; j++) {
+				p1[j].level += (flat ? 1 : m);
+			}
+		}
+	}
+}
+
+/*
+ * Parenthesize all operators in priority class "class",
+ * grouping each chain of them left to right, or right to left.
+ */
+static void
+parenthesize_class(equation, n, class, right_to_left)
+token_type	*equation;	/* pointer to expression */
+int		n;		/* length of expression */
+int		class;		/* priority class of the operators to parenthesize */
+int		right_to_left;	/* evaluation order of the operators */
+{
+	int	i;
+
+	for (i = (right_to_left ? (n - 2) : 1); i >= 1 && i < n; i += (right_to_left ? -2 : 2)) {
+		if (equation[i].token.operatr < 0) {
+			/* already parenthesized as part of a chain */
+			equation[i].token.operatr = -equation[i].token.operatr;
+		} else if (priority_class(equation[i].token.operatr) == class) {
+			parenthesize_chain(equation, n, i, right_to_left);
+		}
+	}
+}
+
 /*
  * Handle and remove the special NEGATE operator.
  */
@@ -167,10 +345,10 @@ int		*np;
 {
 	int	i;
 
+	/* parenthesize it first: */
+	parenthesize_class(equation, *np, NEGATE, false);
 	for (i = 1; i < *np; i += 2) {
 		if (equation[i].token.operatr == NEGATE) {
-			/* parenthesize it first: */
-			binary_parenthesize(equation, *np, i);
 			/* finish changing negate operator to -1.0 times the operand: */
 			equation[i].token.operatr = TIMES;
 		}
@@ -182,6 +360,8 @@ int		*np;
  * Gives different operators on the same level in an expression the correct priority.
  * Similar operators on the same level are always evaluated or grouped left to right,
  * except for the power operator.
+ * Takes time proportional to the expression length times its parentheses depth,
+ * so very long expressions without deep parentheses parse quickly.
  *
  * organize() should be called after this to remove unneeded parentheses.
  */
@@ -190,40 +370,493 @@ give_priority(equation, np)
 token_type	*equation;	/* pointer to expression */
 int		*np;		/* pointer to expression length */
 {
-	int	i;
-
 /* Higher priority (precedence) operators need to be parenthesized first: */
-	for (i = 1; i < *np; i += 2) {
-		if (equation[i].token.operatr >= FACTORIAL) {
-			binary_parenthesize(equation, *np, i);
+	parenthesize_class(equation, *np, FACTORIAL, false);
+	parenthesize_class(equation, *np, POWER, right_associative_power);	/* right to left evaluation, if set */
+	parenthesize_class(equation, *np, TIMES, false);
+	handle_negate(equation, np);	/* Make this the first called function here to make negate highest priority. */
+}
+
+/*
+ * Calculate expression "p1" if it is a real number, without changing it.
+ *
+ * Return true with the value in "*dp" if successful.
+ */
+static int
+numeric_value(p1, n, dp)
+token_type	*p1;	/* expression pointer */
+int		n;	/* expression length */
+double		*dp;	/* where to store the value */
+{
+	code_type	*code;
+	double		*stack;
+	int		ncode;
+	int		rv = false;
+
+	code = (code_type *) mem_alloc(n * sizeof(code_type), MEM_TEMP);
+	stack = (double *) mem_alloc(n * sizeof(double), MEM_TEMP);
+	if (code && stack && (ncode = compile_numeric(p1, n, NULL, 0, code)) > 0) {
+		rv = eval_numeric(code, ncode, NULL, stack, dp);
+	}
+	mem_free(code, n * sizeof(code_type), MEM_TEMP);
+	mem_free(stack, n * sizeof(double), MEM_TEMP);
+	return(rv && isfinite(*dp));
+}
+
+/*
+ * If "cp" starts with the name of a parameter of the function body being parsed,
+ * return the parameter number (origin 0), otherwise return -1.
+ */
+static int
+func_param(cp)
+char	*cp;
+{
+	int	k, len;
+
+	for (len = 0; isvarchar(cp[len]) || isdigit(cp[len]); len++)
+		;
+	for (k = 0; k < n_func_params; k++) {
+		if (len == func_param_len[k] && strncmp(cp, func_params[k], len) == 0)
+			return k;
+	}
+	return -1;
+}
+
+/*
+ * Parse the function body string "cp" into "buf", which is n_tokens long,
+ * with the "nargs" parameter names in "params" parsed as PARAM_VAR(0) to PARAM_VAR(nargs-1).
+ *
+ * Return the length of the parsed body if successful, otherwise display an error and return 0.
+ */
+static int
+parse_body(buf, cp, params, param_len, nargs)
+token_type	*buf;
+char		*cp;
+char		**params;
+int		*param_len;
+int		nargs;
+{
+	char	*save_params[MAX_FUNC_ARGS];
+	int	save_param_len[MAX_FUNC_ARGS];
+	int	save_n_params;
+	int	n = 0;
+
+	save_n_params = n_func_params;
+	blt(save_params, func_params, sizeof(func_params));
+	blt(save_param_len, func_param_len, sizeof(func_param_len));
+	blt(func_params, params, nargs * sizeof(char *));
+	blt(func_param_len, param_len, nargs * sizeof(int));
+	n_func_params = nargs;
+	cp = parse_section(buf, &n, cp, true);
+	n_func_params = save_n_params;
+	blt(func_params, save_params, sizeof(func_params));
+	blt(func_param_len, save_param_len, sizeof(func_param_len));
+	if (cp == NULL)
+		return 0;
+	if (n <= 0 || *cp) {
+		error(_("Syntax error in function body."));
+		return 0;
+	}
+	return n;
+}
+
+/*
+ * Parse the template string "cp", a Mathomatic expression of the "nparams" parameter names in "params",
+ * with the parameters parsed as PARAM_VAR(0) to PARAM_VAR(nparams-1).
+ * Used for the templates of the built-in functions in "function.c".
+ *
+ * Return the parsed template in newly allocated memory, with its length in "*np",
+ * or NULL on error.
+ */
+token_type *
+parse_template(cp, params, param_len, nparams, np)
+char	*cp;
+char	**params;
+int	*param_len;
+int	nparams;
+int	*np;
+{
+	token_type	*buf, *tokens;
+	int		n, save_input_column;
+	char		str[100];	/* writable copy of "cp", because parsing function calls temporarily modifies it */
+
+	if (my_strlcpy(str, cp, sizeof(str)) >= sizeof(str)) {
+		error_bug("Template too long in parse_template().");
+	}
+	if (func_nesting >= MAX_FUNC_NESTING) {
+		error(_("Functions nested too deeply."));
+		return NULL;
+	}
+	if (func_space[func_nesting].tokens == NULL) {
+		func_space[func_nesting].tokens = (token_type *) mem_alloc(n_tokens * sizeof(token_type), MEM_FUNCTIONS);
+		if (func_space[func_nesting].tokens == NULL) {
+			error(_("Out of memory (can't malloc(3))."));
+			return NULL;
 		}
 	}
+	buf = func_space[func_nesting].tokens;
+	save_input_column = input_column;
+	func_nesting++;
+	n = parse_body(buf, str, params, param_len, nparams);
+	func_nesting--;
+	input_column = save_input_column;
+	if (n <= 0)
+		return NULL;
+	if ((tokens = (token_type *) mem_alloc(n * sizeof(token_type), MEM_FUNCTIONS)) == NULL) {
+		error(_("Out of memory (can't malloc(3))."));
+		return NULL;
+	}
+	blt(tokens, buf, n * sizeof(token_type));
+	*np = n;
+	return tokens;
+}
+
+/*
+ * Parse a function call like "sin(x)" at "cp", which is at position "column" in the input.
+ * The function may be built-in or user-defined.
+ * The result is appended to "equation" at level "level" as a constant, the function's expansion,
+ * or a function call, as described in "am.h".
+ *
+ * Return the string position after the function call,
+ * "cp" if it is not a function call, or NULL on error.
+ */
+static char *
+parse_function(equation, np, cp, level, column)
+token_type	*equation;	/* where the parsed expression is being stored */
+int		*np;		/* pointer to the current expression length */
+char		*cp;		/* string to parse */
+int		level;		/* current level of parentheses */
+int		column;		/* position of cp relative to input_column */
+{
+	int		i, k, n, len;
+	int		fn;
+	int		nargs, max_args;
+	int		paren_level;
+	int		numeric;
+	int		save_input_column;
+	char		*args[MAX_FUNC_ARGS+1], *end, *cp1;
+	token_type	*tokens, *body;
+	int		arg_start[MAX_FUNC_ARGS], arg_len[MAX_FUNC_ARGS], arg_total = 0;
+	double		values[MAX_FUNC_ARGS];
+	double		d;
 
-	if (right_associative_power) {
-		for (i = *np - 2; i >= 1; i -= 2) {	/* count down (for right to left evaluation) */
-			if (equation[i].token.operatr == POWER) {
-				binary_parenthesize(equation, *np, i);
+	for (len = 0; isvarchar(cp[len]) || isdigit(cp[len]); len++)
+		;
+	if (cp[len] != '(')
+		return cp;
+	if (defining_name && len == defining_len && strncmp(cp, defining_name, len) == 0) {
+		put_up_arrow(column, _("A function can't call itself."));
+		return NULL;
+	}
+	fn = lookup_function(cp, len);
+	if (fn < 0) {
+/* Reported here, so the unknown name doesn't become a variable, which couldn't be defined as a function later. */
+#if	LIBRARY
+		put_up_arrow(column, _("Unknown function."));
+#else
+		put_up_arrow(column, _("Unknown function; try using rmath, which allows more functions."));
+#endif
+		return NULL;
+	}
+	max_args = func_nargs(fn);
+/* find the end of each argument */
+	nargs = 0;
+	args[nargs++] = &cp[len+1];
+	for (paren_level = 1, end = args[0]; *end; end++) {
+		paren_level += paren_increment(*end);
+		if (paren_level <= 0)
+			break;
+		if (paren_level == 1 && *end == ',') {
+			if (nargs >= max_args) {
+				put_up_arrow(column + (end - cp), _("Too many function arguments."));
+				return NULL;
 			}
+			args[nargs++] = end + 1;
 		}
-	} else {
-		for (i = 1; i < *np; i += 2) {		/* count up (for left to right evaluation) */
-			if (equation[i].token.operatr == POWER) {
-				binary_parenthesize(equation, *np, i);
+	}
+	if (*end == '\0') {
+		put_up_arrow(column + len, _("Unmatched parenthesis: missing )"));
+		return NULL;
+	}
+	args[nargs] = end + 1;
+	if (nargs < max_args) {
+		put_up_arrow(column + (end - cp), _("Not enough function arguments."));
+		return NULL;
+	}
+	if (func_nesting >= MAX_FUNC_NESTING) {
+		put_up_arrow(column, _("Functions nested too deeply."));
+		return NULL;
+	}
+	if (func_space[func_nesting].tokens == NULL) {
+		func_space[func_nesting].tokens = (token_type *) mem_alloc(n_tokens * sizeof(token_type), MEM_FUNCTIONS);
+		if (func_space[func_nesting].tokens == NULL) {
+			error(_("Out of memory (can't malloc(3))."));
+			return NULL;
+		}
+	}
+	if (func_space[func_nesting].args == NULL) {
+		func_space[func_nesting].args = (token_type *) mem_alloc(n_tokens * sizeof(token_type), MEM_FUNCTIONS);
+		if (func_space[func_nesting].args == NULL) {
+			error(_("Out of memory (can't malloc(3))."));
+			return NULL;
+		}
+	}
+	tokens = func_space[func_nesting].tokens;
+	save_input_column = input_column;
+	numeric = (fn < FIRST_USER_FUNC && !func_native(fn));	/* only built-in function calls are calculated here */
+/* parse each argument once, saving it in func_space[].args, and get its value, if it has one */
+	for (i = 0; i < nargs; i++) {
+		*end = '\0';
+		input_column = save_input_column + column + (args[i] - cp);
+		func_nesting++;
+		cp1 = parse_section(tokens, &n, args[i], true);
+		func_nesting--;
+		input_column = save_input_column;
+		*end = ')';
+		if (cp1 == NULL)
+			return NULL;
+		if (cp1 != args[i+1] - 1 || n <= 0) {
+			put_up_arrow(column + (cp1 - cp), (n <= 0) ? _("Missing function argument.") : _("Syntax error."));
+			return NULL;
+		}
+		if (arg_total + n > n_tokens) {
+			error_huge();
+		}
+		blt(&func_space[func_nesting].args[arg_total], tokens, n * sizeof(token_type));
+		arg_start[i] = arg_total;
+		arg_len[i] = n;
+		arg_total += n;
+		if (numeric && !numeric_value(tokens, n, &values[i])) {
+			numeric = false;
+		}
+	}
+	if (numeric && func_value(FUNC_OP(fn), values, 1, &d)) {
+		goto return_constant;
+	}
+	if (func_native(fn)) {
+		if ((body = func_expansion(fn, &n)) == NULL)
+			return NULL;
+		*np += subst_template(&equation[*np], n_tokens - *np, body, n, func_space[func_nesting].args, arg_start, arg_len, level);
+		return end + 1;
+	}
+/* append the function call, as described in "am.h" */
+	if (*np + 1 + nargs + arg_total > n_tokens) {
+		error_huge();
+	}
+	equation[*np].level = level + 1;
+	equation[*np].kind = CONSTANT;
+	equation[*np].token.constant = 1.0;
+	(*np)++;
+	for (i = 0; i < nargs; i++) {
+		equation[*np].level = level + 1;
+		equation[*np].kind = OPERATOR;
+		equation[*np].token.operatr = FUNC_OP(fn);
+		(*np)++;
+		for (k = arg_start[i]; k < arg_start[i] + arg_len[i]; k++) {
+			equation[*np] = func_space[func_nesting].args[k];
+			equation[*np].level += level + ((arg_len[i] == 1) ? 0 : 1);
+			(*np)++;
+		}
+	}
+	return end + 1;
+
+return_constant:
+	if (*np + 1 > n_tokens) {
+		error_huge();
+	}
+	equation[*np].level = level;
+	equation[*np].kind = CONSTANT;
+	equation[*np].token.constant = d;
+	(*np)++;
+	return end + 1;
+}
+
+/*
+ * If "cp" is a function definition like "f(x, y) = x^2 + y", define or redefine the function.
+ * There must be no space between the function name and the opening parenthesis,
+ * and the name must not already be a variable name,
+ * so equations like "x (y) = 3", meaning x*y = 3, are not taken as function definitions.
+ * The body is parsed once and stored with the parameters as placeholders,
+ * see define_user_function() in "function.c".
+ *
+ * Return -1 if "cp" is not a function definition,
+ * otherwise return true if successful.
+ */
+int
+define_function(cp)
+char	*cp;
+{
+	static const char	*predefined_names[] = { "e", "i", "pi", "sign", "inf" };
+
+	char		*params[MAX_FUNC_ARGS];
+	int		param_len[MAX_FUNC_ARGS];
+	char		*name, *body;
+	int		name_len, nargs = 0;
+	int		i, k, len, fn;
+	int		n, save_input_column;
+
+	if (!case_sensitive_flag) {
+		str_tolower(cp);
+	}
+	cp = skip_space(cp);
+	name = cp;
+	if (!isvarchar(*cp))
+		return -1;
+	for (name_len = 0; isvarchar(cp[name_len]) || isdigit(cp[name_len]); name_len++)
+		;
+	cp = &cp[name_len];
+	if (*cp != '(')
+		return -1;
+	do {
+		cp = skip_space(cp + 1);
+		if (!isvarchar(*cp) || nargs >= MAX_FUNC_ARGS)
+			return -1;
+		params[nargs] = cp;
+		for (len = 0; isvarchar(cp[len]) || isdigit(cp[len]); len++)
+			;
+		if (len > MAX_VAR_LEN) {
+			error(_("Function parameter name too long."));
+			return false;
+		}
+		for (k = 0; k < nargs; k++) {
+			if (len == param_len[k] && strncmp(cp, params[k], len) == 0) {
+				error(_("Duplicate function parameter name."));
+				return false;
 			}
 		}
+		param_len[nargs++] = len;
+		cp = skip_space(&cp[len]);
+	} while (*cp == ',');
+	if (*cp != ')')
+		return -1;
+	cp = skip_space(cp + 1);
+	if (*cp != '=' || cp[1] == '=')
+		return -1;
+	body = skip_space(cp + 1);
+	if (*body == '\0') {
+		error(_("Function body missing."));
+		return false;
+	}
+	if (name_len > MAX_VAR_LEN) {
+		error(_("Function name too long."));
+		return false;
+	}
+	if ((fn = lookup_function(name, name_len)) >= 0 && fn < FIRST_USER_FUNC) {
+		error(_("Built-in functions may not be redefined."));
+		return false;
+	}
+	for (i = 0; i < ARR_CNT(predefined_names); i++) {
+		if (strncmp(name, predefined_names[i], name_len) == 0 && predefined_names[i][name_len] == '\0') {
+			error(_("A function name may not be an existing variable name."));
+			return false;
+		}
+	}
+	for (i = 0; var_names[i]; i++) {
+		if (strncmp(name, var_names[i], name_len) == 0 && var_names[i][name_len] == '\0') {
+			error(_("A function name may not be an existing variable name."));
+			return false;
+		}
 	}
+/* parse the body once, with the parameters parsed as placeholders */
+	save_input_column = input_column;
+	input_column += body - name;
+	func_nesting = 0;
+	defining_name = name;
+	defining_len = name_len;
+	n = parse_body(scratch, body, params, param_len, nargs);
+	defining_name = NULL;
+	input_column = save_input_column;
+	if (n <= 0)
+		return false;
+	if ((fn = define_user_function(name, name_len, params, param_len, nargs, scratch, n)) < 0)
+		return false;
+#if	!SILENT
+	if (!quiet_mode) {
+		fprintf(gfp, _("Function %s defined.\n"), func_name(FUNC_OP(fn)));
+	}
+#endif
+	return true;
+}
 
-	for (i = 1; i < *np; i += 2) {
-		switch (equation[i].token.operatr) {
-		case TIMES:
-		case DIVIDE:
-		case MODULUS:
-		case IDIVIDE:
-			binary_parenthesize(equation, *np, i);
-			break;
+/*
+ * Convert the decimal constant string "cp" to a double, exactly like strtod(3).
+ * Plain decimal constants with up to DBL_DIG significant digits and a small exponent,
+ * which is nearly every constant, are converted here with one exact floating point
+ * multiply or divide (Clinger's fast path), giving the same correctly rounded result.
+ * Anything else is passed on to strtod(3).
+ *
+ * The end of the constant is stored in "*cpp", if "cpp" is not NULL.
+ */
+double
+fast_strtod(cp, cpp)
+char	*cp, **cpp;
+{
+	static double	powers_of_ten[] = {	/* all exactly representable */
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+	char	*cp1, *cp2;
+	double	mantissa = 0.0;
+	int	digits = 0;	/* number of significant digits in mantissa */
+	int	any_digits = false;
+	int	exponent = 0, exp_sign = 1, exp_value = 0;
+
+	cp1 = cp;
+	if (*cp1 == '0' && (cp1[1] == 'x' || cp1[1] == 'X'))
+		goto use_strtod;	/* hexadecimal */
+	for (; *cp1 >= '0' && *cp1 <= '9'; cp1++) {
+		any_digits = true;
+		if (mantissa == 0.0 && *cp1 == '0')
+			continue;
+		if (++digits > DBL_DIG)
+			goto use_strtod;
+		mantissa = mantissa * 10.0 + (*cp1 - '0');
+	}
+	if (*cp1 == '.') {
+		for (cp1++; *cp1 >= '0' && *cp1 <= '9'; cp1++) {
+			any_digits = true;
+			exponent--;
+			if (mantissa == 0.0 && *cp1 == '0')
+				continue;
+			if (++digits > DBL_DIG)
+				goto use_strtod;
+			mantissa = mantissa * 10.0 + (*cp1 - '0');
 		}
 	}
-	handle_negate(equation, np);	/* Make this the first called function here to make negate highest priority. */
+	if (!any_digits)
+		goto use_strtod;
+	if (*cp1 == 'e' || *cp1 == 'E') {
+		cp2 = cp1 + 1;
+		if (*cp2 == '+' || *cp2 == '-') {
+			if (*cp2 == '-')
+				exp_sign = -1;
+			cp2++;
+		}
+		if (*cp2 >= '0' && *cp2 <= '9') {
+			for (; *cp2 >= '0' && *cp2 <= '9'; cp2++) {
+				if (exp_value > 1000)
+					goto use_strtod;
+				exp_value = exp_value * 10 + (*cp2 - '0');
+			}
+			exponent += exp_sign * exp_value;
+			cp1 = cp2;
+		}
+	}
+	if (mantissa != 0.0) {
+		if (exponent < 0 && exponent >= -22) {
+			mantissa /= powers_of_ten[-exponent];
+		} else if (exponent >= 0 && exponent <= 22) {
+			mantissa *= powers_of_ten[exponent];
+		} else {
+			goto use_strtod;
+		}
+	}
+	if (cpp)
+		*cpp = cp1;
+	return mantissa;
+
+use_strtod:
+	return strtod(cp, cpp);
 }
 
 /*
@@ -470,7 +1103,7 @@ parse_power:
 			}
 			cp1 = cp;
 			errno = 0;
-			d = strtod(cp1, &cp);
+			d = fast_strtod(cp1, &cp);
 			if (cp == cp1) {
 				goto syntax_error;
 			}
@@ -539,7 +1172,14 @@ parse_power:
 				equation[n].token.operatr = TIMES;
 				n++;
 			}
-			cp1 = cp;
+			cp1 = parse_function(equation, &n, cp, cur_level, cp - cp_start);
+			if (cp1 == NULL) {
+				return(NULL);
+			}
+			if (cp1 != cp) {
+				cp = cp1 - 1;
+				break;
+			}
 			if (strncasecmp(cp, "inf", strlen("inf")) == 0
 			    && !isvarchar(cp[strlen("inf")])) {
 				equation[n].kind = CONSTANT;
@@ -550,6 +1190,10 @@ parse_power:
 				equation[n].kind = CONSTANT;
 				equation[n].token.constant = INFINITY;	/* the infinity constant */
 				cp += strlen(INFINITY_NAME);
+			} else if ((i = func_param(cp)) >= 0) {
+				equation[n].kind = VARIABLE;
+				equation[n].token.variable = PARAM_VAR(i);
+				cp += func_param_len[i];
 			} else {
 				equation[n].kind = VARIABLE;
 				cp = parse_var(&equation[n].token.variable, cp);
@@ -558,11 +1202,11 @@ parse_power:
 				}
 			}
 			if (*cp == '(') {
-/* Named functions currently not implemented, except when using m4. */
+/* Only the built-in functions are implemented, except when using m4. */
 #if	LIBRARY
 				put_up_arrow(cp1 - cp_start, _("Unknown function."));
 #else
-				put_up_arrow(cp1 - cp_start, _("Unknown function; try using rmath, which allows basic functions."));
+				put_up_arrow(cp1 - cp_start, _("Unknown function; try using rmath, which allows more functions."));
 #endif
 				return(NULL);
 			}
@@ -608,14 +1252,18 @@ parse_equation(n, cp)
 int	n;	/* equation space number */
 char	*cp;	/* pointer to the beginning of the equation character string */
 {
+	trace_begin("parse", -1);
 	if ((cp = parse_expr(lhs[n], &n_lhs[n], cp, true)) != NULL) {
 		if ((cp = parse_expr(rhs[n], &n_rhs[n], cp, true)) != NULL) {
-			if (!extra_characters(cp))
+			if (!extra_characters(cp)) {
+				trace_end("parse", n_lhs[n] + n_rhs[n]);
 				return cp;
+			}
 		}
 	}
 	n_lhs[n] = 0;
 	n_rhs[n] = 0;
+	trace_end("parse", 0);
 	return NULL;
 }
 
@@ -637,6 +1285,9 @@ int		allow_space;	/* if true, allow and ignore space characters; if false, space
 	if (!case_sensitive_flag) {
 		str_tolower(cp);
 	}
+	func_nesting = 0;
+	n_func_params = 0;
+	defining_name = NULL;
 	cp = parse_section(equation, np, cp, allow_space);
 	return cp;
 }
@@ -772,7 +1423,7 @@ char	*cp;
 				return(NULL);
 			}
 			len = strlen(buf) + 1;
-			var_names[i] = (char *) malloc(len);
+			var_names[i] = (char *) mem_alloc(len, MEM_VARIABLES);
 			if (var_names[i] == NULL) {
 				error(_("Out of memory (can't malloc(3) variable name)."));
 				return(NULL);
@@ -187,7 +187,12 @@ token_type	*equation;	/* pointer to the beginning of equation side */
 int		*np;		/* pointer to length of equation side */
 int		do_repeat;	/* factor repeated factors flag */
 {
-	return pf_recurse(equation, np, 0, 1, do_repeat);
+	int	rv;
+
+	trace_begin("poly_factor", *np);
+	rv = pf_recurse(equation, np, 0, 1, do_repeat);
+	trace_end("poly_factor", *np);
+	return rv;
 }
 
 static int
@@ -212,7 +217,7 @@ int		do_repeat;
 	}
 	if (level_count && count > 1) {	/* so we don't factor expressions with only one additive operator */
 		/* try to factor the sub-expression */
-		modified = pf_sub(equation, np, loc, i - loc, level, do_repeat);
+		modified = count_rule(R_PF, pf_sub(equation, np, loc, i - loc, level, do_repeat));
 	}
 	for (i = loc; i < *np && equation[i].level >= level;) {
 		if (equation[i].level > level) {
@@ -276,6 +281,9 @@ int		do_repeat;	/* factor repeated factors flag */
 /* First factor polynomials with repeated factors */
 /* using poly_gcd(polynomial, v * differentiate(polynomial, v)) to discover the factors: */
 	for (count = 1; do_repeat; count++) {
+		if (aborted("factor", count)) {
+			longjmp(jmp_save, 13);
+		}
 		blt(trhs, &equation[loc1], len * sizeof(token_type));
 		n_trhs = len;
 		partial_flag = false;
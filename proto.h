@@ -10,8 +10,18 @@ void warning(const char *str);
 void error_huge(void);
 void error_bug(const char *str);
 void check_err(void);
+int aborted(const char *where, long count);
 int get_screen_size(void);
-int malloc_vscreen(void);
+double get_time(void);
+void trace_event(int ph, const char *name, const char *detail, int tokens);
+void trace_unwind(void);
+int trace_open(char *filename);
+void trace_close(void);
+void *mem_alloc(size_t size, int category);
+void *mem_calloc(size_t nmemb, size_t size, int category);
+void *mem_realloc(void *p, size_t old_size, size_t new_size, int category);
+void mem_free(void *p, size_t size, int category);
+void mem_disown(size_t size, int category);
 int init_mem(void);
 int check_gvars(void);
 void init_gvars(void);
@@ -63,6 +73,11 @@ int load_rc(int return_true_if_no_file, FILE *ofp);
 /* cmds.c */
 int plot_cmd(char *cp);
 int version_cmd(char *cp);
+void sample_peak_tokens(void);
+void note_tokens(int *np);
+void reset_counters(void);
+void counters_report(FILE *ofp);
+char *counters_json(void);
 long max_memory_usage(void);
 int show_status(FILE *ofp);
 int version_report(void);
@@ -131,6 +146,32 @@ int derivative_cmd(char *cp);
 int extrema_cmd(char *cp);
 int taylor_cmd(char *cp);
 int limit_cmd(char *cp);
+/* eval.c */
+int compile_numeric(token_type *p1, int n, long *vars, int nvars, code_type *code);
+int eval_numeric(code_type *code, int ncode, double *values, double *stack, double *dp);
+int eval_complex(code_type *code, int ncode, complexs *values, complexs *stack, complexs *cp);
+/* function.c */
+int lookup_function(char *cp, int len);
+char *func_name(int op);
+int func_native(int fn);
+int func_nargs(int fn);
+token_type *func_expansion(int fn, int *np);
+token_type *func_derivative(int op, int *np);
+token_type *func_inverse(int op, int *np);
+void clear_functions(void);
+int subst_template(token_type *dest, int room, token_type *tp, int n, token_type *args, int *arg_start, int *arg_len, int level);
+int is_call(token_type *p1, int n, int i);
+int call_end(token_type *p1, int n, int i);
+int call_args(token_type *p1, int n, int i, int *arg_start, int *arg_len);
+int check_calls(token_type *p1, int n);
+int func_value(int op, double *args, int nargs, double *dp);
+int expand_call(token_type *equation, int *np, int i);
+int expand_calls(token_type *equation, int *np, long v);
+int expand_user_calls(token_type *equation, int *np, long v);
+int expand_code_calls(token_type *equation, int *np, enum language_list language);
+int define_user_function(char *name, int name_len, char **params, int *param_len, int nargs, token_type *tp, int n);
+int list_functions(void);
+int simp_functions(token_type *equation, int *np);
 /* factor.c */
 int factor_divide(token_type *equation, int *np, long v, double d);
 int subtract_itself(token_type *equation, int *np);
@@ -160,6 +201,11 @@ int parse(int n, char *cp);
 int process_parse(int n, char *cp);
 int process(char *cp);
 int process_rv(char *cp);
+int begin_command_stats(int i);
+void end_command_stats(int level);
+void reset_command_stats(void);
+void command_stats_report(FILE *ofp);
+char *command_stats_json(void);
 int display_process(char *cp);
 int shell_out(char *cp);
 char *parse_var2(long *vp, char *cp);
@@ -187,6 +233,8 @@ char *var_name(long v);
 int list_var(long v, int lang_code);
 int list_proc(token_type *p1, int n, int export_flag);
 char *list_equation(int n, int export_flag);
+char *list_equation_reuse(int n, int export_flag);
+int reused_string(char *cp);
 char *list_expression(token_type *p1, int n, int export_flag);
 int list_string(token_type *p1, int n, char *string, int export_flag);
 int list_string_sub(token_type *p1, int n, int outflag, char *string, int export_flag);
@@ -215,6 +263,9 @@ int is_mathomatic_operator(int ch);
 void binary_parenthesize(token_type *p1, int n, int i);
 void handle_negate(token_type *equation, int *np);
 void give_priority(token_type *equation, int *np);
+token_type *parse_template(char *cp, char **params, int *param_len, int nparams, int *np);
+int define_function(char *cp);
+double fast_strtod(char *cp, char **cpp);
 char *parse_section(token_type *equation, int *np, char *cp, int allow_space);
 char *parse_equation(int n, char *cp);
 char *parse_expr(token_type *equation, int *np, char *cp, int allow_space);
@@ -242,6 +293,10 @@ int basic_size(token_type *p1, int len);
 int get_term(token_type *p1, int n1, int count, int *tp1, int *lentp1);
 void term_value(double *dp, token_type *p1, int n1, int loc);
 int find_greatest_power(token_type *p1, int n1, long *vp1, double *pp1, int *tp1, int *lentp1, int *dcodep);
+/* server.c */
+int open_server_socket(char *path);
+void zygote_server(char *path);
+void request_server(char *path, int workers, int timeout);
 /* simplify.c */
 void organize(token_type *equation, int *np);
 void elim_loop(token_type *equation, int *np);
@@ -261,6 +316,14 @@ void simp_divide(token_type *equation, int *np);
 void simp2_divide(token_type *equation, int *np, long v, int fc_level);
 void simpb_side(token_type *equation, int *np, int uf_power_flag, int power_flag, int fc_level);
 void simple_frac_side(token_type *equation, int *np);
+void pass_begin(token_type *equation, int n);
+int pass_end(int p, token_type *equation, int *np, int rv);
+void pass_unwind(void);
+void pass_profile_off(void);
+void reset_pass_profile(void);
+void pass_profile_report(FILE *ofp);
+char *pass_profile_json(void);
+int load_pass_schedule(char *filename);
 void simpa_side(token_type *equation, int *np, int quick_flag, int frac_flag);
 void simpa_repeat_side(token_type *equation, int *np, int quick_flag, int frac_flag);
 void simpa_repeat(int n, int quick_flag, int frac_flag);
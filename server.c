@@ -0,0 +1,491 @@
+/*
+ * Mathomatic server mode, for Unix only.
+ * Not used for the symbolic math library.
+ *
+ * Copyright (C) 1987-2012 George Gesslein II.
+ 
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+The chief copyright holder can be contacted at gesslein@mathomatic.org, or
+George Gesslein II, P.O. Box 224, Lansing, NY  14882-0224  USA.
+ 
+ */
+
+/*
+ * Starting Mathomatic allocates the expression arrays, reads the startup file,
+ * and reads in any files given on the command line.  For short jobs,
+ * that can take longer than the job itself.
+ *
+ * With the -z option, Mathomatic does all that once and then waits for connections
+ * on a Unix domain socket.  Each connection gets its own forked child process,
+ * which starts with a copy-on-write copy of the already initialized program and
+ * its equation spaces, and reads its input from the connection exactly like
+ * standard input, sending all output back the same way.
+ * When the client closes its end, the child exits.
+ *
+ * With the -S option, Mathomatic is instead a request server for programs.
+ * A fixed pool of forked worker processes, each a copy of the initialized program,
+ * take turns accepting connections.  Each line a client sends is one request,
+ * run by process() like a line typed at the main prompt, with a time limit.
+ * The reply is a header line with a status word ("OK", "ERROR", or "TIMEOUT")
+ * and the number of bytes of output that follow, then all output of the request.
+ * The request "@stats" replies with server statistics instead.
+ * A worker keeps its equation spaces until its client disconnects,
+ * then exits and is replaced with a fresh copy.
+ */
+
+#if	!LIBRARY && UNIX && !SECURE
+
+#include "includes.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#ifndef	MAP_ANONYMOUS
+#define	MAP_ANONYMOUS	MAP_ANON
+#endif
+
+#define	LATENCY_BUCKETS	128	/* number of request latency histogram buckets, 4 per doubling of microseconds */
+
+typedef struct {		/* request statistics of one worker slot, kept in memory shared by all workers */
+	long	connections;	/* number of connections served */
+	long	requests;	/* number of requests served */
+	long	errors;		/* number of requests that failed */
+	long	timeouts;	/* number of requests that took too long */
+	long	max_rss;	/* maximum resident set size of any worker in this slot, in kilobytes */
+	double	seconds;	/* total time spent running requests */
+	long	latency[LATENCY_BUCKETS];	/* request latency histogram */
+} server_stats_type;
+
+static server_stats_type	*server_stats;		/* one for each worker slot */
+static int			n_workers;		/* number of worker slots */
+static pid_t			*worker_pids;		/* process IDs of the workers, used by the parent */
+static volatile int		request_timed_out;	/* set by request_alarm() */
+
+/*
+ * Create a Unix domain socket named "path" and listen on it.
+ * Any existing socket file with that name is removed first.
+ *
+ * Return the socket file descriptor, or -1 on error.
+ */
+int
+open_server_socket(path)
+char	*path;	/* socket file name */
+{
+	struct sockaddr_un	addr;
+	int			fd;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, _("%s: Socket name \"%s\" is too long.\n"), prog_name, path);
+		return -1;
+	}
+	my_strlcpy(addr.sun_path, path, sizeof(addr.sun_path));
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+		perror("socket");
+		return -1;
+	}
+	unlink(path);
+	if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0) {
+		perror(path);
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/*
+ * Serve connections on the Unix domain socket named "path" by forking.
+ * The parent never returns from here; it accepts connections until killed.
+ * Each child returns with its standard input and output connected to its client,
+ * ready for main_io_loop().
+ */
+void
+zygote_server(path)
+char	*path;	/* socket file name */
+{
+	int	fd, conn;
+	pid_t	pid;
+
+	if ((fd = open_server_socket(path)) < 0) {
+		exit_program(2);
+	}
+	signal(SIGCHLD, SIG_IGN);	/* children are reaped automatically */
+	if (!quiet_mode) {
+		printf(_("Waiting for connections on \"%s\".\n"), path);
+	}
+	for (;;) {
+		fflush(NULL);	/* so nothing buffered is output twice */
+		if ((conn = accept(fd, NULL, NULL)) < 0) {
+			if (errno == EINTR || errno == ECONNABORTED)
+				continue;
+			perror("accept");
+			exit_program(2);
+		}
+		pid = fork();
+		if (pid == 0) {
+			close(fd);
+			signal(SIGCHLD, SIG_DFL);
+			if (dup2(conn, STDIN_FILENO) < 0 || dup2(conn, STDOUT_FILENO) < 0) {
+				perror("dup2");
+				_exit(2);
+			}
+			close(conn);
+			color_flag = 0;	/* the client is not a terminal */
+#if	READLINE || EDITLINE
+			readline_enabled = false;
+#endif
+			return;
+		}
+		if (pid < 0) {
+			perror("fork");
+		}
+		close(conn);
+	}
+}
+
+/*
+ * Per-request alarm signal handler.
+ * Interrupts the request through the abort polling mechanism,
+ * or exits the worker if it doesn't stop within a second.
+ */
+static void
+request_alarm(sig)
+int	sig;
+{
+	if (request_timed_out) {
+		_exit(3);
+	}
+	request_timed_out = true;
+	abort_flag++;
+	alarm(1);
+}
+
+/*
+ * Signal handler for the request server parent process,
+ * terminates all workers and exits.
+ */
+static void
+server_exithandler(sig)
+int	sig;
+{
+	int	i;
+
+	for (i = 0; i < n_workers; i++) {
+		if (worker_pids[i] > 0)
+			kill(worker_pids[i], SIGTERM);
+	}
+	_exit(0);
+}
+
+/*
+ * Return the latency histogram bucket for a request that took "seconds".
+ */
+static int
+latency_bucket(seconds)
+double	seconds;
+{
+	double	d;
+
+	d = 4.0 * log(seconds * 1.0e6 + 1.0) / log(2.0);
+	if (d >= LATENCY_BUCKETS - 1)
+		return LATENCY_BUCKETS - 1;
+	return (int) d;
+}
+
+/*
+ * Return the latency in milliseconds at or below which the fraction "p" of all requests in "hist" finished,
+ * to the resolution of the histogram.
+ */
+static double
+latency_percentile(hist, total, p)
+long	*hist;		/* latency histogram */
+long	total;		/* number of requests in hist */
+double	p;		/* fraction of requests, 0 to 1 */
+{
+	int	i;
+	long	count = 0;
+
+	if (total <= 0)
+		return 0.0;
+	for (i = 0; i < LATENCY_BUCKETS - 1; i++) {
+		count += hist[i];
+		if (count >= ceil(p * total))
+			break;
+	}
+	return (pow(2.0, (i + 1) / 4.0) - 1.0) / 1000.0;
+}
+
+/*
+ * Output the totals of all worker statistics to "fp", one "name value" pair per line.
+ */
+static void
+output_server_stats(fp)
+FILE	*fp;
+{
+	server_stats_type	total;
+	int			i, j;
+
+	memset(&total, 0, sizeof(total));
+	for (i = 0; i < n_workers; i++) {
+		total.connections += server_stats[i].connections;
+		total.requests += server_stats[i].requests;
+		total.errors += server_stats[i].errors;
+		total.timeouts += server_stats[i].timeouts;
+		total.seconds += server_stats[i].seconds;
+		total.max_rss = max(total.max_rss, server_stats[i].max_rss);
+		for (j = 0; j < LATENCY_BUCKETS; j++) {
+			total.latency[j] += server_stats[i].latency[j];
+		}
+	}
+	fprintf(fp, "workers %d\n", n_workers);
+	fprintf(fp, "connections %ld\n", total.connections);
+	fprintf(fp, "requests %ld\n", total.requests);
+	fprintf(fp, "errors %ld\n", total.errors);
+	fprintf(fp, "timeouts %ld\n", total.timeouts);
+	fprintf(fp, "latency_mean_ms %.3f\n", total.requests ? total.seconds * 1000.0 / total.requests : 0.0);
+	fprintf(fp, "latency_p50_ms %.3f\n", latency_percentile(total.latency, total.requests, 0.50));
+	fprintf(fp, "latency_p99_ms %.3f\n", latency_percentile(total.latency, total.requests, 0.99));
+	fprintf(fp, "max_rss_kb %ld\n", total.max_rss);
+}
+
+/*
+ * Send the reply header and the output collected in standard output (a temporary file) to "conn",
+ * then empty standard output for the next request.
+ *
+ * Return true if successful.
+ */
+static int
+send_reply(conn, status)
+int	conn;		/* client connection */
+char	*status;	/* status word */
+{
+	char	buf[BUFSIZ];
+	off_t	size, pos;
+	ssize_t	len;
+	int	rv = true;
+
+	fflush(stdout);
+	size = lseek(STDOUT_FILENO, 0, SEEK_END);
+	if (size < 0)
+		size = 0;
+	len = snprintf(buf, sizeof(buf), "%s %ld\n", status, (long) size);
+	if (write(conn, buf, len) != len)
+		rv = false;
+	for (pos = 0; rv && pos < size; pos += len) {
+		len = pread(STDOUT_FILENO, buf, min(sizeof(buf), (size_t) (size - pos)), pos);
+		if (len <= 0 || write(conn, buf, len) != len)
+			rv = false;
+	}
+	if (ftruncate(STDOUT_FILENO, 0) < 0 || lseek(STDOUT_FILENO, 0, SEEK_SET) < 0)
+		rv = false;
+	return rv;
+}
+
+/*
+ * Run one line of request input, with output to standard output.
+ *
+ * Return the reply status word.
+ */
+static char *
+run_request(cp, timeout)
+char	*cp;		/* request line */
+int	timeout;	/* maximum seconds per request, 0 for no limit */
+{
+	int	rv;
+
+	request_timed_out = false;
+	abort_flag = false;
+	if (timeout > 0) {
+		alarm(timeout);
+	}
+	if ((rv = setjmp(jmp_save)) != 0) {	/* trap errors */
+		clean_up();
+		trace_unwind();
+		end_command_stats(0);
+		if (rv == 14) {
+			error(_("Expression too large."));
+		}
+		previous_return_value = 0;
+	} else {
+		rv = !process(cp);
+	}
+	alarm(0);
+	abort_flag = false;
+	if (request_timed_out)
+		return "TIMEOUT";
+	return(rv ? "ERROR" : "OK");
+}
+
+/*
+ * Body of a request server worker process.
+ * Accept one connection on "fd" and serve requests until the client disconnects,
+ * then exit.
+ */
+static void
+request_worker(fd, slot, timeout)
+int	fd;		/* listening socket */
+int	slot;		/* worker slot number */
+int	timeout;	/* maximum seconds per request */
+{
+	server_stats_type	*sp = &server_stats[slot];
+	FILE			*in, *out;
+	char			*buf, *cp, *status;
+	int			conn, len, i;
+	double			start_time, elapsed;
+	struct rusage		usage;
+
+	signal(SIGCHLD, SIG_DFL);
+	signal(SIGTERM, SIG_DFL);
+	signal(SIGINT, SIG_DFL);
+	signal(SIGALRM, request_alarm);
+	color_flag = 0;
+	if (freopen("/dev/null", "r", stdin) == NULL) {	/* requests can't prompt for more input */
+		_exit(2);
+	}
+#if	READLINE || EDITLINE
+	readline_enabled = false;
+#endif
+	if ((out = tmpfile()) == NULL || dup2(fileno(out), STDOUT_FILENO) < 0) {
+		perror("tmpfile");
+		_exit(2);
+	}
+	fclose(out);
+	len = n_tokens * sizeof(token_type);
+	if ((buf = (char *) malloc(len)) == NULL) {
+		_exit(2);
+	}
+	do {
+		conn = accept(fd, NULL, NULL);
+	} while (conn < 0 && (errno == EINTR || errno == ECONNABORTED));
+	if (conn < 0) {
+		perror("accept");
+		_exit(2);
+	}
+	close(fd);
+	if ((in = fdopen(conn, "r")) == NULL) {
+		_exit(2);
+	}
+	sp->connections++;
+	while (fgets(buf, len, in)) {
+		i = strlen(buf);
+		if (i > 0 && buf[i-1] == '\n')
+			buf[--i] = '\0';
+		if (i > 0 && buf[i-1] == '\r')
+			buf[--i] = '\0';
+		cp = skip_space(buf);
+		if (strcmp(cp, "@stats") == 0) {
+			output_server_stats(stdout);
+			status = "OK";
+		} else {
+			start_time = get_time();
+			status = run_request(cp, timeout);
+			elapsed = get_time() - start_time;
+			sp->requests++;
+			if (status[0] == 'T') {
+				sp->timeouts++;
+			} else if (status[0] == 'E') {
+				sp->errors++;
+			}
+			sp->seconds += elapsed;
+			sp->latency[latency_bucket(elapsed)]++;
+			if (getrusage(RUSAGE_SELF, &usage) == 0) {
+				sp->max_rss = max(sp->max_rss, usage.ru_maxrss);
+			}
+		}
+		if (!send_reply(conn, status))
+			break;
+	}
+	exit(0);
+}
+
+/*
+ * Start a worker process in slot number "slot".
+ */
+static void
+start_worker(fd, slot, timeout)
+int	fd, slot, timeout;
+{
+	pid_t	pid;
+
+	fflush(NULL);	/* so nothing buffered is output twice */
+	pid = fork();
+	if (pid == 0) {
+		request_worker(fd, slot, timeout);
+		_exit(0);
+	}
+	if (pid < 0) {
+		perror("fork");
+	}
+	worker_pids[slot] = pid;
+}
+
+/*
+ * Run the request server on the Unix domain socket named "path",
+ * with a pool of "workers" worker processes.
+ * Never returns; the parent process restarts workers as they exit, until killed.
+ */
+void
+request_server(path, workers, timeout)
+char	*path;		/* socket file name */
+int	workers;	/* number of worker processes */
+int	timeout;	/* maximum seconds per request, 0 for no limit */
+{
+	int	fd, i, status;
+	pid_t	pid;
+
+	n_workers = workers;
+	server_stats = (server_stats_type *) mmap(NULL, workers * sizeof(server_stats_type), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	worker_pids = (pid_t *) calloc(workers, sizeof(pid_t));
+	if (server_stats == MAP_FAILED || worker_pids == NULL) {
+		fprintf(stderr, _("%s: Not enough memory.\n"), prog_name);
+		exit_program(2);
+	}
+	if ((fd = open_server_socket(path)) < 0) {
+		exit_program(2);
+	}
+	if (!quiet_mode) {
+		printf(_("Serving requests on \"%s\" with %d workers.\n"), path, workers);
+	}
+	alarm(0);
+	signal(SIGTERM, server_exithandler);
+	signal(SIGINT, server_exithandler);
+	for (i = 0; i < workers; i++) {
+		start_worker(fd, i, timeout);
+	}
+	for (;;) {
+		pid = wait(&status);
+		if (pid < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("wait");
+			server_exithandler(0);
+		}
+		for (i = 0; i < workers; i++) {
+			if (worker_pids[i] == pid) {
+				if (WIFEXITED(status) && WEXITSTATUS(status) == 2) {
+					sleep(1);	/* don't spin if workers can't start */
+				}
+				start_worker(fd, i, timeout);
+				break;
+			}
+		}
+	}
+}
+#endif
@@ -61,6 +61,7 @@ int		*np;		/* pointer to length of equation side */
 	if (*np > n_tokens) {
 		error_bug("Internal error: expression array overflow detected in organize().");
 	}
+	note_tokens(np);
 	org_recurse(equation, np, 0, 1, NULL);
 }
 
@@ -177,8 +178,8 @@ elim_loop(equation, np)
 token_type	*equation;	/* pointer to the beginning of equation side to simplify */
 int		*np;		/* pointer to length of equation side */
 {
-	if (abort_flag) {
-		/* Control-C pressed, gracefully return to main prompt and leave unsimplified */
+	if (abort_requested()) {
+		/* Control-C pressed or canceled, gracefully return to main prompt and leave unsimplified */
 		abort_flag = false;
 #if	DEBUG && !SILENT
 		char	*cp, buf[100];
@@ -201,7 +202,7 @@ int		*np;		/* pointer to length of equation side */
 				organize(equation, np);
 			} while (combine_constants(equation, np, true));
 		} while (elim_k(equation, np));
-	} while (simp_pp(equation, np));
+	} while (simp_pp(equation, np) || simp_functions(equation, np));
 	if (reorder(equation, np)) {
 		do {
 			organize(equation, np);
@@ -672,6 +673,238 @@ int		*np;		/* pointer to length of equation side */
 	fractions_and_group(equation, np);
 }
 
+/*
+ * Profiling and scheduling of the passes of simpa_side(), see run_pass() in "am.h".
+ */
+#define	PASS_MIN_CALLS	10	/* a pass must have been profiled this many times without a change to be skipped */
+
+static const char *pass_names[N_PASSES] = {	/* function names of the passes, in enum pass_list order */
+	"simp_loop",
+	"simp_ssub",
+	"simpb_side",
+	"elim_loop",
+	"uf_power",
+	"uf_tsimp",
+	"uf_pplus",
+	"uf_repeat",
+	"uf_times",
+	"uf_neg_help",
+	"unsimp_power",
+	"factor_power",
+	"rationalize",
+	"mod_simp",
+	"simp_i",
+	"super_factor",
+	"poly_gcd_simp",
+	"factorv",
+	"factor_imaginary",
+	"poly_factor",
+	"div_remainder",
+	"simp_constant_power",
+	"make_simple_fractions",
+	"integer_root_simp"
+};
+
+static int		pass_depth;	/* nesting level of passes being run */
+static token_type	*pass_copy;	/* copy of the expression before the outermost pass, or NULL */
+static int		pass_copy_n;	/* length of pass_copy[] */
+static double		pass_start_time;	/* get_time() at the start of the outermost pass */
+
+/*
+ * Called before a profiled pass is run on expression "equation" of length "n".
+ * Only the outermost pass is profiled; passes run by nested simpa_side() calls are part of it.
+ */
+void
+pass_begin(equation, n)
+token_type	*equation;
+int		n;
+{
+	if (pass_depth++ > 0)
+		return;
+	if (pass_copy == NULL) {
+		pass_copy = (token_type *) mem_alloc(n_tokens * sizeof(token_type), MEM_TEMP);
+	}
+	if (pass_copy) {
+		memmove(pass_copy, equation, n * sizeof(token_type));	/* not blt(), so the counters aren't affected */
+	}
+	pass_copy_n = n;
+	pass_start_time = get_time();
+}
+
+/*
+ * Return true if the two expressions are exactly the same, token for token.
+ */
+static int
+same_tokens(p1, n1, p2, n2)
+token_type	*p1;
+int		n1;
+token_type	*p2;
+int		n2;
+{
+	int	i;
+
+	if (n1 != n2)
+		return false;
+	for (i = 0; i < n1; i++) {
+		if (p1[i].kind != p2[i].kind || p1[i].level != p2[i].level)
+			return false;
+		switch (p1[i].kind) {
+		case CONSTANT:
+			if (p1[i].token.constant != p2[i].token.constant)
+				return false;
+			break;
+		case VARIABLE:
+			if (p1[i].token.variable != p2[i].token.variable)
+				return false;
+			break;
+		case OPERATOR:
+			if (p1[i].token.operatr != p2[i].token.operatr)
+				return false;
+			break;
+		}
+	}
+	return true;
+}
+
+/*
+ * Called after profiled pass "p" is run, with its return value "rv".
+ * Records the time it took and whether it changed the expression.
+ *
+ * Returns "rv".
+ */
+int
+pass_end(p, equation, np, rv)
+int		p;
+token_type	*equation;
+int		*np;
+int		rv;
+{
+	if (pass_depth <= 0 || --pass_depth > 0)
+		return rv;
+	pass_stats[p].calls++;
+	pass_stats[p].seconds += get_time() - pass_start_time;
+	if (pass_copy == NULL || !same_tokens(pass_copy, pass_copy_n, equation, *np)) {
+		pass_stats[p].changes++;
+	}
+	return rv;
+}
+
+/*
+ * Forget the passes being run, when processing is aborted.
+ */
+void
+pass_unwind(void)
+{
+	pass_depth = 0;
+}
+
+/*
+ * Stop profiling passes and free the memory used for it.
+ */
+void
+pass_profile_off(void)
+{
+	pass_profile_flag = false;
+	pass_depth = 0;
+	mem_free(pass_copy, n_tokens * sizeof(token_type), MEM_TEMP);
+	pass_copy = NULL;
+}
+
+/*
+ * Zero the pass profile.
+ */
+void
+reset_pass_profile(void)
+{
+	memset(pass_stats, 0, sizeof(pass_stats));
+}
+
+/*
+ * Display the pass profile to "ofp", one line per pass, in the format read by load_pass_schedule().
+ */
+void
+pass_profile_report(ofp)
+FILE	*ofp;
+{
+	int	i;
+
+	fprintf(ofp, _("Full simplify pass profile%s:\n"), (pass_profile_flag ? "" : _(" (not profiling now)")));
+	fprintf(ofp, _("pass                       runs    changes      seconds\n"));
+	for (i = 0; i < N_PASSES; i++) {
+		fprintf(ofp, "%-21s %9ld %10ld %12.6f%s\n", pass_names[i], pass_stats[i].calls,
+		    pass_stats[i].changes, pass_stats[i].seconds, (pass_skip[i] ? _(" skipped") : ""));
+	}
+}
+
+/*
+ * Return the pass profile as a JSON object string,
+ * in a static buffer that is overwritten by the next call.
+ */
+char *
+pass_profile_json(void)
+{
+	static char	buf[N_PASSES * 120 + 64];
+	int		i, len;
+
+	len = snprintf(buf, sizeof(buf), "{\"profiling\": %s, \"passes\": {", (pass_profile_flag ? "true" : "false"));
+	for (i = 0; i < N_PASSES; i++) {
+		len += snprintf(&buf[len], sizeof(buf) - len,
+		    "%s\"%s\": {\"calls\": %ld, \"changes\": %ld, \"seconds\": %.6f, \"skipped\": %s}",
+		    (i ? ", " : ""), pass_names[i], pass_stats[i].calls, pass_stats[i].changes,
+		    pass_stats[i].seconds, (pass_skip[i] ? "true" : "false"));
+	}
+	snprintf(&buf[len], sizeof(buf) - len, "}}");
+	return buf;
+}
+
+/*
+ * Load a pass schedule from a pass profile saved with "version passes >filename".
+ * Passes that ran at least PASS_MIN_CALLS times in the profile without ever changing
+ * the expression are skipped from now on; all others are run.
+ *
+ * Return the number of passes skipped, or -1 with an error message if the file is not a pass profile.
+ */
+int
+load_pass_schedule(filename)
+char	*filename;
+{
+	FILE	*fp;
+	char	line[200], name[100];
+	long	calls, changes;
+	double	seconds;
+	char	skip[N_PASSES];
+	int	i, found = 0, count = 0;
+
+	if ((fp = fopen(filename, "r")) == NULL) {
+		perror(filename);
+		error(_("Can't open pass profile file."));
+		return -1;
+	}
+	memset(skip, 0, sizeof(skip));
+	while (fgets(line, sizeof(line), fp)) {
+		if (sscanf(line, "%99s %ld %ld %lf", name, &calls, &changes, &seconds) != 4)
+			continue;
+		for (i = 0; i < N_PASSES; i++) {
+			if (strcmp(name, pass_names[i]) == 0) {
+				skip[i] = (calls >= PASS_MIN_CALLS && changes == 0);
+				found++;
+				break;
+			}
+		}
+	}
+	fclose(fp);
+	if (found == 0) {
+		error(_("No pass profile found in file."));
+		return -1;
+	}
+	for (i = 0; i < N_PASSES; i++) {
+		pass_skip[i] = skip[i];
+		if (skip[i])
+			count++;
+	}
+	return count;
+}
+
 /*
  * This is the slow and thorough simplify of the simplify command.
  * Applies many equivalent algebraic transformations and their inverses (like unfactor and factor),
@@ -688,6 +921,7 @@ int		frac_flag;	/* "simplify fraction" option, simplify to the ratio of two poly
 {
 	int		i;
 	int		flag, poly_flag = true;
+	int		depth;
 	jmp_buf		save_save;
 
 	if (*np == 1) {	/* no need to full simplify a single constant or variable */
@@ -695,76 +929,80 @@ int		frac_flag;	/* "simplify fraction" option, simplify to the ratio of two poly
 		simpb_side(equation, np, true, !frac_flag, 2);
 		return;
 	}
+	trace_begin("simpa_side", *np);
 	debug_string(2, "Simplify input:");
 	side_debug(2, equation, *np);
-	simp_loop(equation, np);
+	run_pass(P_SIMP_LOOP, equation, np, (simp_loop(equation, np), false));
 #if	1
 	do {
-		simp_ssub(equation, np, 0L, 1.0, false, true, 5);
-	} while (uf_power(equation, np));
-	while (factor_power(equation, np)) {
-		simp_loop(equation, np);
+		run_pass(P_SIMP_SSUB, equation, np, (simp_ssub(equation, np, 0L, 1.0, false, true, 5), false));
+	} while (run_pass(P_UF_POWER, equation, np, uf_power(equation, np)));
+	while (run_pass(P_FACTOR_POWER, equation, np, factor_power(equation, np))) {
+		run_pass(P_SIMP_LOOP, equation, np, (simp_loop(equation, np), false));
 	}
 #else
 	simpb_side(equation, np, false, true, 5);
 #endif
 	if (rationalize_denominators) {
-		rationalize(equation, np);
+		run_pass(P_RATIONALIZE, equation, np, rationalize(equation, np));
 	}
-	unsimp_power(equation, np);
-	uf_tsimp(equation, np);
+	run_pass(P_UNSIMP_POWER, equation, np, unsimp_power(equation, np));
+	run_pass(P_UF_TSIMP, equation, np, uf_tsimp(equation, np));
 
 /* Here is the only place in Mathomatic that we do complete modulus (%) simplification: */
-	uf_pplus(equation, np);
-	uf_repeat(equation, np);
+	run_pass(P_UF_PPLUS, equation, np, uf_pplus(equation, np));
+	run_pass(P_UF_REPEAT, equation, np, (uf_repeat(equation, np), false));
 	do {
-		elim_loop(equation, np);
-	} while (mod_simp(equation, np));
+		run_pass(P_ELIM_LOOP, equation, np, (elim_loop(equation, np), false));
+	} while (run_pass(P_MOD_SIMP, equation, np, mod_simp(equation, np)));
 
 /* Here we try to simplify out unnecessary negative constants and imaginary numbers: */
-	simp_i(equation, np);
-	unsimp_power(equation, np);
-	uf_times(equation, np);
-	simp_ssub(equation, np, 0L, 1.0, true, true, 5);
-	unsimp_power(equation, np);
-	uf_neg_help(equation, np);
-	uf_tsimp(equation, np);
+	run_pass(P_SIMP_I, equation, np, simp_i(equation, np));
+	run_pass(P_UNSIMP_POWER, equation, np, unsimp_power(equation, np));
+	run_pass(P_UF_TIMES, equation, np, uf_times(equation, np));
+	run_pass(P_SIMP_SSUB, equation, np, (simp_ssub(equation, np, 0L, 1.0, true, true, 5), false));
+	run_pass(P_UNSIMP_POWER, equation, np, unsimp_power(equation, np));
+	run_pass(P_UF_NEG_HELP, equation, np, (uf_neg_help(equation, np), false));
+	run_pass(P_UF_TSIMP, equation, np, uf_tsimp(equation, np));
 	do {
 		do {
-			simp_ssub(equation, np, 0L, 1.0, false, true, 6);
-		} while (uf_power(equation, np));
-	} while (!quick_flag && super_factor(equation, np, 2));
-	if (poly_gcd_simp(equation, np)) {
-		simp_ssub(equation, np, 0L, 1.0, false, true, 6);
+			run_pass(P_SIMP_SSUB, equation, np, (simp_ssub(equation, np, 0L, 1.0, false, true, 6), false));
+		} while (run_pass(P_UF_POWER, equation, np, uf_power(equation, np)));
+	} while (!quick_flag && run_pass(P_SUPER_FACTOR, equation, np, super_factor(equation, np, 2)));
+	if (run_pass(P_POLY_GCD_SIMP, equation, np, poly_gcd_simp(equation, np))) {
+		run_pass(P_SIMP_SSUB, equation, np, (simp_ssub(equation, np, 0L, 1.0, false, true, 6), false));
 	}
 	side_debug(2, equation, *np);
-	unsimp_power(equation, np);
-	uf_times(equation, np);
-	factorv(equation, np, IMAGINARY);
-	uf_pplus(equation, np);
-	simp_ssub(equation, np, 0L, 1.0, true, false, 5);
-	if (poly_gcd_simp(equation, np)) {
-		factorv(equation, np, IMAGINARY);
-		uf_pplus(equation, np);
-		simp_ssub(equation, np, 0L, 1.0, true, false, 5);
-	}
-	uf_times(equation, np);
-	uf_pplus(equation, np);
-	factor_imaginary(equation, np);
-	uf_power(equation, np);
+	run_pass(P_UNSIMP_POWER, equation, np, unsimp_power(equation, np));
+	run_pass(P_UF_TIMES, equation, np, uf_times(equation, np));
+	run_pass(P_FACTORV, equation, np, (factorv(equation, np, IMAGINARY), false));
+	run_pass(P_UF_PPLUS, equation, np, uf_pplus(equation, np));
+	run_pass(P_SIMP_SSUB, equation, np, (simp_ssub(equation, np, 0L, 1.0, true, false, 5), false));
+	if (run_pass(P_POLY_GCD_SIMP, equation, np, poly_gcd_simp(equation, np))) {
+		run_pass(P_FACTORV, equation, np, (factorv(equation, np, IMAGINARY), false));
+		run_pass(P_UF_PPLUS, equation, np, uf_pplus(equation, np));
+		run_pass(P_SIMP_SSUB, equation, np, (simp_ssub(equation, np, 0L, 1.0, true, false, 5), false));
+	}
+	run_pass(P_UF_TIMES, equation, np, uf_times(equation, np));
+	run_pass(P_UF_PPLUS, equation, np, uf_pplus(equation, np));
+	run_pass(P_FACTOR_IMAGINARY, equation, np, factor_imaginary(equation, np));
+	run_pass(P_UF_POWER, equation, np, uf_power(equation, np));
 	do {
 		do {
-			simp_ssub(equation, np, 0L, 1.0, false, true, 6);
-		} while (uf_power(equation, np));
-	} while (!quick_flag && super_factor(equation, np, 2));
+			run_pass(P_SIMP_SSUB, equation, np, (simp_ssub(equation, np, 0L, 1.0, false, true, 6), false));
+		} while (run_pass(P_UF_POWER, equation, np, uf_power(equation, np)));
+	} while (!quick_flag && run_pass(P_SUPER_FACTOR, equation, np, super_factor(equation, np, 2)));
 
 /* Here we do the greatest expansion; if it fails, do less expansion. */
+	trace_begin("expand", *np);
 	partial_flag = frac_flag;
 	n_tlhs = *np;
 	blt(tlhs, equation, n_tlhs * sizeof(token_type));
 	blt(save_save, jmp_save, sizeof(jmp_save));
+	depth = pass_depth;
 	if ((i = setjmp(jmp_save)) != 0) {	/* trap errors */
 		blt(jmp_save, save_save, sizeof(jmp_save));
+		pass_depth = depth;	/* forget the aborted passes */
 		if (i == 13) {	/* critical error code */
 			longjmp(jmp_save, i);
 		}
@@ -777,58 +1015,101 @@ int		frac_flag;	/* "simplify fraction" option, simplify to the ratio of two poly
 			debug_string(0, "Simplify not expanding fully, due to some error.");
 		}
 		partial_flag = true;	/* expand less */
-		uf_tsimp(equation, np);
+		run_pass(P_UF_TSIMP, equation, np, uf_tsimp(equation, np));
 	} else {
 		if (quick_flag) {
-			uf_tsimp(equation, np);
+			run_pass(P_UF_TSIMP, equation, np, uf_tsimp(equation, np));
 		} else {
 			/* expand powers of 2 and higher, might result in error_huge() trap */
 			do {
-				uf_power(equation, np);
-				uf_repeat(equation, np);
-			} while (uf_tsimp(equation, np));
+				run_pass(P_UF_POWER, equation, np, uf_power(equation, np));
+				run_pass(P_UF_REPEAT, equation, np, (uf_repeat(equation, np), false));
+			} while (run_pass(P_UF_TSIMP, equation, np, uf_tsimp(equation, np)));
 		}
 		blt(jmp_save, save_save, sizeof(jmp_save));
 	}
 	partial_flag = true;
+	trace_end("expand", *np);
 
-	simpb_side(equation, np, true, true, 2);
+	run_pass(P_SIMPB_SIDE, equation, np, (simpb_side(equation, np, true, true, 2), false));
 	debug_string(1, "Simplify result before applying polynomial operations:");
 	side_debug(1, equation, *np);
 	for (flag = false;;) {
 		/* divide top and bottom of fractions by any polynomial GCD found */
-		if (poly_gcd_simp(equation, np)) {
+		if (run_pass(P_POLY_GCD_SIMP, equation, np, poly_gcd_simp(equation, np))) {
 			flag = false;
-			simpb_side(equation, np, false, true, 3);
+			run_pass(P_SIMPB_SIDE, equation, np, (simpb_side(equation, np, false, true, 3), false));
 		}
 		/* factor polynomials */
-		if (!flag && poly_factor(equation, np, true)) {
+		if (!flag && run_pass(P_POLY_FACTOR, equation, np, poly_factor(equation, np, true))) {
 			flag = true;
-			simpb_side(equation, np, false, true, 3);
+			run_pass(P_SIMPB_SIDE, equation, np, (simpb_side(equation, np, false, true, 3), false));
 			continue;
 		}
 		/* simplify algebraic fractions with polynomial and smart division */
-		if (!frac_flag && div_remainder(equation, np, poly_flag, quick_flag)) {
+		if (!frac_flag && run_pass(P_DIV_REMAINDER, equation, np, div_remainder(equation, np, poly_flag, quick_flag))) {
 			flag = false;
-			simpb_side(equation, np, false, true, 3);
+			run_pass(P_SIMPB_SIDE, equation, np, (simpb_side(equation, np, false, true, 3), false));
 			continue;
 		}
 		break;
 	}
 	debug_string(2, "Raw simplify result after applying polynomial operations:");
 	side_debug(2, equation, *np);
-	simp_constant_power(equation, np);
-	simp_ssub(equation, np, 0L, 1.0, true, true, 5);
-	unsimp_power(equation, np);
-	make_simple_fractions(equation, np);
-	factor_power(equation, np);
-	uf_tsimp(equation, np);
-	make_simple_fractions(equation, np);
-	uf_power(equation, np);
-	integer_root_simp(equation, np);
-	simpb_side(equation, np, true, true, 3);
-	poly_factor(equation, np, true);
+	run_pass(P_SIMP_CONSTANT_POWER, equation, np, simp_constant_power(equation, np));
+	run_pass(P_SIMP_SSUB, equation, np, (simp_ssub(equation, np, 0L, 1.0, true, true, 5), false));
+	run_pass(P_UNSIMP_POWER, equation, np, unsimp_power(equation, np));
+	run_pass(P_MAKE_SIMPLE_FRACTIONS, equation, np, make_simple_fractions(equation, np));
+	run_pass(P_FACTOR_POWER, equation, np, factor_power(equation, np));
+	run_pass(P_UF_TSIMP, equation, np, uf_tsimp(equation, np));
+	run_pass(P_MAKE_SIMPLE_FRACTIONS, equation, np, make_simple_fractions(equation, np));
+	run_pass(P_UF_POWER, equation, np, uf_power(equation, np));
+	run_pass(P_INTEGER_ROOT_SIMP, equation, np, integer_root_simp(equation, np));
+	run_pass(P_SIMPB_SIDE, equation, np, (simpb_side(equation, np, true, true, 3), false));
+	run_pass(P_POLY_FACTOR, equation, np, poly_factor(equation, np, true));
+	/* the final cleanup is always run, so the result is in the normal form */
 	simpb_side(equation, np, true, !frac_flag, 2);
+	trace_end("simpa_side", *np);
+}
+
+/*
+ * Simplify the equation side with its function calls replaced by their expansions,
+ * keeping the result if it is smaller and has no more imaginary numbers,
+ * like when sinh(x) + cosh(x) simplifies to e^x.
+ *
+ * Global tes[] is wiped out.
+ */
+static void
+simpa_expanded(equation, np, quick_flag, frac_flag)
+token_type	*equation;	/* pointer to the beginning of equation side to simplify */
+int		*np;		/* pointer to length of the equation side */
+int		quick_flag;
+int		frac_flag;
+{
+	int	i;
+	int	depth;
+	jmp_buf	save_save;
+
+	n_tes = *np;
+	blt(tes, equation, n_tes * sizeof(token_type));
+	if (!expand_calls(tes, &n_tes, 0L))
+		return;
+	blt(save_save, jmp_save, sizeof(jmp_save));
+	depth = pass_depth;
+	if ((i = setjmp(jmp_save)) != 0) {	/* trap errors, leaving the equation side unchanged */
+		blt(jmp_save, save_save, sizeof(jmp_save));
+		pass_depth = depth;
+		if (i == 13) {	/* critical error code */
+			longjmp(jmp_save, i);
+		}
+		return;
+	}
+	simpa_side(tes, &n_tes, quick_flag, frac_flag);
+	blt(jmp_save, save_save, sizeof(jmp_save));
+	if (n_tes < *np && found_var(tes, n_tes, IMAGINARY) <= found_var(equation, *np, IMAGINARY)) {
+		*np = n_tes;
+		blt(equation, tes, n_tes * sizeof(token_type));
+	}
 }
 
 /*
@@ -846,11 +1127,19 @@ int		*np;		/* pointer to length of the equation side */
 int		quick_flag;	/* "simplify quick" option, simpler fractions with no (x+1)^2 expansion */
 int		frac_flag;	/* "simplify fraction" option, simplify to the ratio of two polynomials */
 {
+	long	count = 0;
+
 	if (*np <= 0)
 		return;
+	if (aborted("simplify", count)) {
+		longjmp(jmp_save, 13);
+	}
 	simpa_side(equation, np, quick_flag, frac_flag);
 	if (repeat_flag && *np > 1) {
 		do {
+			if (aborted("simplify", ++count)) {
+				longjmp(jmp_save, 13);
+			}
 			n_tes = *np;
 			blt(tes, equation, n_tes * sizeof(token_type));
 			simpa_side(equation, np, quick_flag, frac_flag);
@@ -860,6 +1149,7 @@ int		frac_flag;	/* "simplify fraction" option, simplify to the ratio of two poly
 			blt(equation, tes, n_tes * sizeof(token_type));
 		}
 	}
+	simpa_expanded(equation, np, quick_flag, frac_flag);
 }
 
 /*
@@ -926,6 +1216,7 @@ int		*np;		/* pointer to length of equation side */
 		do {
 			do {
 				do {
+					counters.simp_loop_iterations++;
 					elim_loop(equation, np);
 				} while (simp2_power(equation, np));
 				i = factor_times(equation, np);
@@ -1404,6 +1695,11 @@ double	k2;	/* Operand 2; ignored for unary operators. */
 		*k1p = d;
 		break;
 	default:
+		if (IS_FUNC_OP(op2) && op1 == 0 && FUNC_NUMBER(op2) < FIRST_USER_FUNC && func_value(op2, &k2, 1, &d)) {
+			/* a built-in function call, operand 1 is the dummy constant; user-defined ones are done by simp_functions() */
+			*k1p = d;
+			break;
+		}
 		return false;
 	}
 	return true;
@@ -1869,8 +2165,10 @@ int		*diff_signp;	/* different sign flag pointer */
 		error_bug("Programming error in call to se_compare().");
 	}
 #endif
+	counters.se_compare_calls++;
 	if (((n1 > n2) ? ((n1 + 1) / (n2 + 1)) : ((n2 + 1) / (n1 + 1))) > 3) {
 		/* expressions are grossly different in size, no need to compare, they are different */
+		counters.se_compare_early_outs++;
 #if	DEBUG
 		rv_should_be_false = true;
 #else
@@ -1908,6 +2206,7 @@ int		n2, l2, *diff_signp;
 	int		i, j;
 	int		len;
 	int		first;
+	int		opn;				/* operand number 1 */
 	int		oc2;				/* operand count 2 */
 	token_type	*opa2[MAX_COMPARE_TERMS];	/* operand pointer array 2 */
 	char		used[MAX_COMPARE_TERMS];	/* operand used flag array 2 */
@@ -2038,7 +2337,8 @@ no_op2:
 	opa2[oc2] = pv1 + 1;
 	last_op1 = 0;
 	first = true;
-	for (pv1 = p1;;) {
+	opn = 0;
+	for (pv1 = p1;; opn++) {
 		for (len = 1; &pv1[len] < ep1; len += 2)
 			if (pv1[len].level <= l1)
 				break;
@@ -2069,8 +2369,8 @@ no_op2:
 					continue;
 				break;
 			default:
-				if ((last_op1 == 0) != (i == 0))
-					return false;
+				if (i != opn)	/* the operands of other operators, including function arguments, must be in the same order */
+					continue;
 				break;
 			}
 			if (compare_recurse(pv1, len, (pv1->level <= l1) ? l1 : (l1 + 1),
@@ -2486,7 +2786,10 @@ int		*np, loc, level;
 					case DIVIDE:
 						if (op == TIMES || op == DIVIDE)
 							break;
+						goto corrupt;
 					default:
+						if (equation[i].token.operatr == op && IS_FUNC_OP(op))
+							break;	/* the next argument of a function call */
 						goto corrupt;
 					}
 				} else {
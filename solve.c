@@ -29,7 +29,9 @@ George Gesslein II, P.O. Box 224, Lansing, NY  14882-0224  USA.
 static int increase(double d, long v);
 static int poly_solve(long v);
 static int g_of_f(int op, token_type *operandp, token_type *side1p, int *side1np, token_type *side2p, int *side2np);
+static int g_of_call(token_type *side1p, int *side1np, token_type *side2p, int *side2np);
 static int flip(token_type *side1p, int *side1np, token_type *side2p, int *side2np);
+static int solve_attempt(token_type *wantp, int wantn, token_type *leftp, int *leftnp, token_type *rightp, int *rightnp);
 
 static int	repeat_count;
 static int	prev_n1, prev_n2;
@@ -116,6 +118,32 @@ token_type	*leftp;		/* LHS of equation */
 int		*leftnp;	/* pointer to length of LHS */
 token_type	*rightp;	/* RHS of equation */
 int		*rightnp;	/* pointer to length of RHS */
+{
+	int	rv;
+	int	expanded;
+
+	trace_begin("solve_sub", *leftnp + *rightnp);
+	rv = solve_attempt(wantp, wantn, leftp, leftnp, rightp, rightnp);
+	if (rv == 0 && wantn == 1 && wantp->kind == VARIABLE) {
+/* Try again with the function calls containing the solve variable expanded, which are left expanded if that fails too. */
+		expanded = expand_calls(leftp, leftnp, wantp->token.variable);
+		if (expand_calls(rightp, rightnp, wantp->token.variable) || expanded) {
+			debug_string(1, _("Expanding the function calls containing the solve variable and trying again..."));
+			rv = solve_attempt(wantp, wantn, leftp, leftnp, rightp, rightnp);
+		}
+	}
+	trace_end("solve_sub", *leftnp + *rightnp);
+	return rv;
+}
+
+static int
+solve_attempt(wantp, wantn, leftp, leftnp, rightp, rightnp)
+token_type	*wantp;
+int		wantn;
+token_type	*leftp;
+int		*leftnp;
+token_type	*rightp;
+int		*rightnp;
 {
 	int		i, j;
 	int		found, found_count;
@@ -1168,6 +1196,8 @@ int		*side2np;	/* pointer to the length of "side2p" */
 	case MODULUS:
 		break;
 	default:
+		if (IS_FUNC_OP(op))
+			return g_of_call(side1p, side1np, side2p, side2np);
 		return false;
 	}
 	for (p1 = operandp + 1; p1 < ep; p1 += 2) {
@@ -1382,6 +1412,86 @@ int		*side2np;	/* pointer to the length of "side2p" */
 	return true;
 }
 
+/*
+ * Apply the inverse of the function called by "side1p", which must be a single function call of one argument,
+ * to both sides of an equation, which is "side1p" and "side2p".
+ * This leaves the function argument in "side1p".
+ * For periodic functions, all solutions are given by an arbitrary integer variable
+ * and an arbitrary sign variable.
+ *
+ * Return true if successful.
+ */
+static int
+g_of_call(side1p, side1np, side2p, side2np)
+token_type	*side1p;	/* equation side pointer */
+int		*side1np;	/* pointer to the length of "side1p" */
+token_type	*side2p;	/* equation side pointer */
+int		*side2np;	/* pointer to the length of "side2p" */
+{
+	token_type	*tp;
+	int		i, n, op;
+	int		level, len;
+	int		arg_start[MAX_FUNC_ARGS], arg_len[MAX_FUNC_ARGS];
+	int		int_var = false, sign_var = false;
+	char		var_name_buf[MAX_VAR_LEN];
+
+	if (!is_call(side1p, *side1np, 0) || call_end(side1p, *side1np, 0) != *side1np)
+		return false;
+	op = side1p[1].token.operatr;
+	if (call_args(side1p, *side1np, 0, arg_start, arg_len) != 1)
+		return false;
+	if ((tp = func_inverse(op, &n)) == NULL)
+		return false;
+	for (i = 0; i < n; i++) {
+		if (tp[i].kind == VARIABLE) {
+			if (tp[i].token.variable == PARAM_VAR(1))
+				int_var = true;
+			else if (tp[i].token.variable == PARAM_VAR(2))
+				sign_var = true;
+		}
+	}
+#if	!SILENT
+	if (debug_level > 0) {
+		fprintf(gfp, _("Applying the inverse of function %s to both sides of the equation:\n"), func_name(op));
+	}
+#endif
+/* the arguments of the inverse are the other side of the equation, an arbitrary integer, and an arbitrary sign */
+	blt(scratch, side2p, *side2np * sizeof(token_type));
+	len = *side2np;
+	for (i = 1; i <= 2; i++) {
+		arg_start[i] = len;
+		arg_len[i] = 1;
+		scratch[len].level = 1;
+		scratch[len].kind = VARIABLE;
+		scratch[len].token.variable = 0;
+		len++;
+	}
+	arg_start[0] = 0;
+	arg_len[0] = *side2np;
+	if (int_var) {
+		snprintf(var_name_buf, sizeof(var_name_buf), "%s_any%.0d", V_INTEGER_PREFIX, last_int_var);
+		if (parse_var(&scratch[arg_start[1]].token.variable, var_name_buf) == NULL)
+			return false;
+		last_int_var++;
+		if (last_int_var < 0) {
+			last_int_var = 0;
+		}
+	}
+	if (sign_var) {
+		next_sign(&scratch[arg_start[2]].token.variable);
+	}
+	*side2np = subst_template(side2p, n_tokens, tp, n, scratch, arg_start, arg_len, 0);
+/* the function argument becomes the whole side */
+	call_args(side1p, *side1np, 0, arg_start, arg_len);
+	level = min_level(&side1p[arg_start[0]], arg_len[0]);
+	blt(side1p, &side1p[arg_start[0]], arg_len[0] * sizeof(token_type));
+	*side1np = arg_len[0];
+	for (i = 0; i < *side1np; i++) {
+		side1p[i].level -= level - 1;
+	}
+	return true;
+}
+
 /*
  * Take the reciprocal of both equation sides.
  *
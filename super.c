@@ -250,7 +250,7 @@ sf_again:
 		side_debug(0, &equation[i], len1);
 		side_debug(0, &equation[j], len2);
 #endif
-		if (sf_sub(equation, np, loc, i, len1, j, len2, level + 1, start_flag)) {
+		if (count_rule(R_SF, sf_sub(equation, np, loc, i, len1, j, len2, level + 1, start_flag))) {
 #if	0
 			int junk;
 			printf("start_flag = %d\n", start_flag);
@@ -153,10 +153,12 @@ uf_simp(equation, np)
 token_type	*equation;	/* pointer to beginning of equation side */
 int		*np;		/* pointer to length of equation side */
 {
+	trace_begin("uf_simp", *np);
 	uf_tsimp(equation, np);
 	uf_power(equation, np);
 	uf_repeat(equation, np);
 	uf_tsimp(equation, np);
+	trace_end("uf_simp", *np);
 }
 
 /*
@@ -283,7 +285,7 @@ int		ii;
 			if (equation[e1].level < level)
 				break;
 		}
-		if (unf_sub(equation, np, b1, i, e1, level, ii)) {
+		if (count_rule(R_UNF, unf_sub(equation, np, b1, i, e1, level, ii))) {
 			modified = true;
 			i = b1 - 1;
 			continue;
@@ -585,7 +587,7 @@ int		*np;
 			if (equation[i].level == equation[i+1].level
 			    && equation[i+1].kind == CONSTANT)
 				continue;
-			modified |= usp_sub(equation, np, i);
+			modified |= count_rule(R_USP, usp_sub(equation, np, i));
 		}
 	}
 	return modified;